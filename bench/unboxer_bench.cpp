@@ -0,0 +1,294 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "boxreader.h"
+#include "inputbuffer_impl.h"
+#include "inputstreamer.h"
+#include "status.h"
+#include "unboxer.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QtEndian>
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <new>
+
+using namespace unboxer;
+using MemUnboxer = unboxer::Unboxer<InputBufferImpl, NullCache>;
+
+// Count every heap allocation made by the process. With glibc we can interpose malloc itself, so allocations done
+// by Qt containers are counted too. Elsewhere only C++ operator new is visible.
+static std::atomic<std::uint64_t> allocationCount { 0 };
+
+#if defined(__GLIBC__)
+extern "C" {
+void *__libc_malloc(std::size_t size);
+void *__libc_calloc(std::size_t n, std::size_t size);
+void *__libc_realloc(void *ptr, std::size_t size);
+
+void *malloc(std::size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *calloc(std::size_t n, std::size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, std::size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+}
+#else
+void *operator new(std::size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (auto ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+#endif
+
+struct Scenario {
+    const char *name;
+    std::size_t chunkSize;   // how much data is fed to the parser at once
+    int         density;     // leaf boxes per container
+    int         depth;       // nesting level of containers in one fragment
+    int         payloadSize; // payload size of every leaf box
+};
+
+struct Result {
+    std::uint64_t bytes       = 0;
+    std::uint64_t boxes       = 0;
+    std::uint64_t allocations = 0;
+    qint64        nsecs       = 0;
+    int           iterations  = 0;
+};
+
+static QByteArray containerType(int level) { return QByteArray("c") + QByteArray::number(level).rightJustified(3, '0'); }
+
+static void appendHeader(QByteArray &out, const char *type, std::uint32_t size)
+{
+    char header[8];
+    qToBigEndian<quint32>(size, header);
+    std::memcpy(header + 4, type, 4);
+    out.append(header, sizeof(header));
+}
+
+// one fragment is a chain of `depth` containers where every container has `density` leaves
+static QByteArray makeFragment(const Scenario &s, int level = 0)
+{
+    QByteArray payload;
+    for (int i = 0; i < s.density; i++) {
+        appendHeader(payload, "leaf", 8 + s.payloadSize);
+        payload.append(QByteArray(s.payloadSize, char(i)));
+    }
+    if (level + 1 < s.depth) {
+        payload += makeFragment(s, level + 1);
+    }
+    QByteArray container;
+    appendHeader(container, containerType(level).constData(), 8 + payload.size());
+    return container + payload;
+}
+
+static QByteArray makeStream(const Scenario &s, std::size_t targetSize)
+{
+    auto       fragment = makeFragment(s);
+    QByteArray stream;
+    stream.reserve(int(targetSize + fragment.size()));
+    while (std::size_t(stream.size()) < targetSize) {
+        stream += fragment;
+    }
+    return stream;
+}
+
+static std::vector<QByteArray> containerTypes(const Scenario &s)
+{
+    std::vector<QByteArray> types;
+    for (int level = 0; level < s.depth; level++) {
+        types.push_back(containerType(level));
+    }
+    return types;
+}
+
+static void runReader(const Scenario &s, const QByteArray &stream, Result &result)
+{
+    auto          types = containerTypes(s);
+    std::uint64_t boxes = 0;
+
+    auto allocationsBefore = allocationCount.load(std::memory_order_relaxed);
+    QElapsedTimer timer;
+    timer.start();
+
+    BoxReader reader(
+        [&](const QByteArray &type, std::uint64_t, std::uint64_t) {
+            boxes++;
+            return std::find(types.begin(), types.end(), type) != types.end() ? BoxAction::Recurse : BoxAction::Blob;
+        },
+        []() {},
+        [](const QByteArray &) { return Status::Ok; });
+    for (int offset = 0; offset < stream.size(); offset += int(s.chunkSize)) {
+        auto size = qMin(int(s.chunkSize), stream.size() - offset);
+        if (reader.feed(QByteArray::fromRawData(stream.constData() + offset, size)) != Status::Ok) {
+            qFatal("BoxReader failed to parse generated stream");
+        }
+    }
+    reader.close(Status::Eof);
+
+    result.nsecs += timer.nsecsElapsed();
+    result.allocations += allocationCount.load(std::memory_order_relaxed) - allocationsBefore;
+    result.bytes += stream.size();
+    result.boxes += boxes;
+    result.iterations++;
+}
+
+static void runUnboxer(const Scenario &s, const QByteArray &stream, Result &result)
+{
+    std::uint64_t boxes  = 0;
+    bool          closed = false;
+    Status        status = Status::Ok;
+
+    MemUnboxer unboxer(stream, containerTypes(s)); // the source shares the stream, nothing is copied
+
+    std::function<void(Box::Ptr)> setupBox = [&](Box::Ptr box) {
+        boxes++;
+        box->onSubBoxOpen = std::ref(setupBox);
+        box->onDataRead   = [](const QByteArray &) { return Status::Ok; };
+    };
+    unboxer.setStreamOpenedCallback([&](Box::Ptr root) {
+        boxes--; // artificial root
+        setupBox(root);
+    });
+    unboxer.setStreamClosedCallback([&](Status reason) {
+        closed = true;
+        status = reason;
+    });
+
+    auto allocationsBefore = allocationCount.load(std::memory_order_relaxed);
+    QElapsedTimer timer;
+    timer.start();
+
+    unboxer.open();
+    while (!closed) {
+        unboxer.read(s.chunkSize);
+    }
+
+    result.nsecs += timer.nsecsElapsed();
+    result.allocations += allocationCount.load(std::memory_order_relaxed) - allocationsBefore;
+    if (status != Status::Eof) {
+        qFatal("Unboxer failed to parse generated stream");
+    }
+    result.bytes += stream.size();
+    result.boxes += boxes;
+    result.iterations++;
+}
+
+static void printHeader()
+{
+    std::cout << std::left << std::setw(10) << "bench" << std::setw(16) << "scenario" << std::right << std::setw(9)
+              << "chunk" << std::setw(9) << "density" << std::setw(7) << "depth" << std::setw(9) << "payload"
+              << std::setw(12) << "MB/s" << std::setw(12) << "Mboxes/s" << std::setw(12) << "allocs/box" << '\n';
+}
+
+static void printResult(const char *bench, const Scenario &s, const Result &r)
+{
+    double seconds = r.nsecs / 1e9;
+    std::cout << std::left << std::setw(10) << bench << std::setw(16) << s.name << std::right << std::setw(9)
+              << s.chunkSize << std::setw(9) << s.density << std::setw(7) << s.depth << std::setw(9) << s.payloadSize
+              << std::fixed << std::setprecision(1) << std::setw(12) << r.bytes / seconds / (1024 * 1024)
+              << std::setprecision(3) << std::setw(12) << r.boxes / seconds / 1e6 << std::setprecision(2)
+              << std::setw(12) << double(r.allocations) / r.boxes << '\n';
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("unboxer_bench");
+    QCoreApplication::setApplicationVersion("1.0");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("BoxReader and Unboxer throughput benchmark");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    QCommandLineOption sizeOption("size", "Size of generated stream in MiB", "size", "16");
+    QCommandLineOption minTimeOption("min-time", "Minimal time in ms to spend on each scenario", "ms", "500");
+    QCommandLineOption filterOption("filter", "Run only scenarios containing this string", "filter");
+    parser.addOption(sizeOption);
+    parser.addOption(minTimeOption);
+    parser.addOption(filterOption);
+    parser.process(app);
+
+    std::size_t streamSize = parser.value(sizeOption).toULongLong() * 1024 * 1024;
+    qint64      minTime    = parser.value(minTimeOption).toLongLong() * 1000 * 1000;
+    QString     filter     = parser.value(filterOption);
+
+    // vary one dimension at a time around the baseline
+    const Scenario scenarios[] = {
+        { "baseline", 16384, 8, 2, 256 },       { "chunk-64", 64, 8, 2, 256 },
+        { "chunk-1k", 1024, 8, 2, 256 },        { "chunk-64k", 65536, 8, 2, 256 },
+        { "chunk-1m", 1024 * 1024, 8, 2, 256 }, { "density-1", 16384, 1, 2, 256 },
+        { "density-64", 16384, 64, 2, 256 },    { "depth-1", 16384, 8, 1, 256 },
+        { "depth-8", 16384, 8, 8, 256 },        { "depth-32", 16384, 8, 32, 256 },
+        { "payload-0", 16384, 8, 2, 0 },        { "payload-16", 16384, 8, 2, 16 },
+        { "payload-4k", 16384, 8, 2, 4096 },    { "payload-256k", 16384, 8, 2, 256 * 1024 },
+    };
+
+    printHeader();
+    for (const auto &s : scenarios) {
+        if (!filter.isEmpty() && !QString(s.name).contains(filter)) {
+            continue;
+        }
+        auto stream = makeStream(s, streamSize);
+
+        Result reader;
+        do {
+            runReader(s, stream, reader);
+        } while (reader.nsecs < minTime);
+        printResult("reader", s, reader);
+
+        Result unboxer;
+        do {
+            runUnboxer(s, stream, unboxer);
+        } while (unboxer.nsecs < minTime);
+        printResult("unboxer", s, unboxer);
+    }
+    std::cout.flush();
+
+    return 0;
+}
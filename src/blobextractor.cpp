@@ -25,9 +25,13 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "blobextractor.h"
 
 #include "status.h"
+#include "trace.h"
 
 #include <QDebug>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QPointer>
+#include <QSaveFile>
 #include <QUuid>
 
 namespace unboxer {
@@ -43,58 +47,213 @@ BlobExtractor::BlobExtractor(const QString &fnameTemplate, const QList<QByteArra
 
 BlobExtractor::~BlobExtractor()
 {
-    for (auto const &[_, file] : files) {
-        if (file->isOpen()) {
-            file->close();
+    worker.reset(); // finishes the posted files
+    // unfinished files are left as is, but temporary ones of the content addressed mode are useless
+    for (auto const &[_, output] : outputs) {
+        if (contentAddressed && output.file) {
+            output.file->remove();
         }
-        delete file;
     }
 }
 
+void BlobExtractor::setContentAddressed(bool enabled, qint64 memoryThreshold)
+{
+    Q_ASSERT(outputs.empty());
+    contentAddressed      = enabled;
+    this->memoryThreshold = memoryThreshold;
+}
+
+void BlobExtractor::setCompression(const QByteArray &type, std::shared_ptr<const Codec> codec)
+{
+    Q_ASSERT(outputs.empty());
+    if (codec) {
+        codecs.insert(type, std::move(codec));
+    } else {
+        codecs.remove(type);
+    }
+}
+
+void BlobExtractor::waitForDone()
+{
+    if (worker) {
+        worker->waitForDone();
+    }
+}
+
+bool BlobExtractor::saveManifest(const QString &filename) const
+{
+    QSaveFile file(filename);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(QJsonDocument(manifest_).toJson());
+    return file.commit();
+}
+
 void BlobExtractor::add(Box::Ptr box)
 {
     if (!boxTypes.contains(box->type) || box->type.isEmpty()) {
         return;
     }
+    UNBOXER_TRACE_SPAN("extractor open");
 
-    auto it = files.find(box);
-    Q_ASSERT(it == files.end());
+    Q_ASSERT(outputs.find(box) == outputs.end());
 
-    auto file = new QFile(outputDirectory.filePath(fnameTemplate.arg(box->stringType(), QString::number(fileIndex++))));
-    bool inserted;
-    std::tie(it, inserted) = files.insert(std::make_pair(box, file));
-    if (!file->open(QIODevice::WriteOnly)) {
-        qWarning() << "Failed to open " << file->fileName() << " for writing";
-        delete file;
-        files.erase(it);
+    Output output;
+    if (contentAddressed) {
+        output.hasher = std::make_unique<BoxHasher>(hashAlgorithms | Sha256Hash);
+        outputs.emplace(box, std::move(output)); // in memory till it's large enough
+        return;
+    }
+    output.file = std::make_unique<QFile>(
+        outputDirectory.filePath(fnameTemplate.arg(box->stringType(), QString::number(fileIndex++))));
+    if (!output.file->open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to open " << output.file->fileName() << " for writing";
+        return;
     }
+    if (hashAlgorithms) {
+        output.hasher = std::make_unique<BoxHasher>(hashAlgorithms);
+    }
+    if (auto codec = codecs.value(box->type)) {
+        if (!worker) {
+            worker = std::make_unique<CompressionWorker>();
+        }
+        output.compressed = std::make_shared<CompressedFile>(std::move(output.file), std::move(codec));
+    }
+    outputs.emplace(box, std::move(output));
 }
 
 void BlobExtractor::addBoxData(unboxer::Box::Ptr box, const QByteArray &data)
 {
-    auto it = files.find(box);
-    if (it == files.end()) {
+    auto it = outputs.find(box);
+    if (it == outputs.end()) {
+        return;
+    }
+    UNBOXER_TRACE_SPAN("extractor write");
+    auto &output = it->second;
+    output.size += data.size();
+    if (output.hasher) {
+        output.hasher->update(data);
+    }
+    if (output.compressed) {
+        output.pending += data;
+        if (output.pending.size() >= COMPRESSION_BLOCK_SIZE) {
+            auto size = output.pending.size();
+            worker->post([file = output.compressed, block = std::move(output.pending)]() { file->write(block); }, size);
+            output.pending = QByteArray();
+        }
+        return;
+    }
+    if (contentAddressed && !output.file) {
+        output.pending += data;
+        if (output.pending.size() <= memoryThreshold) {
+            return;
+        }
+        if (!spill(output)) {
+            outputs.erase(it);
+        }
         return;
     }
-    auto file = it->second;
-    if (file->write(data) != data.size()) {
-        qWarning() << "Failed to write to " << file->fileName();
-        file->close();
-        delete file;
-        files.erase(it);
+    if (output.file->write(data) != data.size()) {
+        qWarning() << "Failed to write to " << output.file->fileName();
+        if (contentAddressed) {
+            output.file->remove();
+        }
+        outputs.erase(it);
     }
 }
 
 void BlobExtractor::closeBox(unboxer::Box::Ptr box)
 {
-    auto it = files.find(box);
-    if (it == files.end()) {
+    auto it = outputs.find(box);
+    if (it == outputs.end()) {
         return;
     }
-    it->second->close();
+    UNBOXER_TRACE_SPAN("extractor close");
+    auto output = std::move(it->second);
+    outputs.erase(it);
+    if (output.hasher) {
+        box->digest = output.hasher->result();
+    }
+    if (output.compressed) {
+        auto size = output.pending.size();
+        worker->post(
+            [this, box, file = std::move(output.compressed), block = std::move(output.pending)]() {
+                file->write(block);
+                auto filename = file->finish();
+                if (!filename.isEmpty() && boxClosedCallback) {
+                    QMetaObject::invokeMethod(
+                        this, [this, box, filename]() { boxClosedCallback(box, filename); }, Qt::QueuedConnection);
+                }
+            },
+            size);
+        return;
+    }
+    QString filename;
+    if (contentAddressed) {
+        filename = storeObject(output, box->digest.sha256);
+        if (filename.isEmpty()) {
+            return;
+        }
+        manifest_.append(QJsonObject { { "type", box->stringType() },
+                                       { "offset", qint64(box->fileOffset) },
+                                       { "size", output.size },
+                                       { "sha256", QString::fromLatin1(box->digest.sha256.toHex()) },
+                                       { "file", outputDirectory.relativeFilePath(filename) } });
+    } else {
+        output.file->close();
+        filename = output.file->fileName();
+    }
     if (boxClosedCallback) {
-        boxClosedCallback(box, it->second->fileName());
+        boxClosedCallback(box, filename);
+    }
+}
+
+bool BlobExtractor::spill(Output &output)
+{
+    // the name is known only when all the data is hashed
+    auto objects = outputDirectory.filePath("objects");
+    outputDirectory.mkpath("objects");
+    output.file = std::make_unique<QFile>(
+        QDir(objects).filePath(QUuid::createUuid().toString(QUuid::WithoutBraces) + ".part"));
+    if (!output.file->open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to open " << output.file->fileName() << " for writing";
+        return false;
+    }
+    if (output.file->write(output.pending) != output.pending.size()) {
+        qWarning() << "Failed to write to " << output.file->fileName();
+        output.file->remove();
+        return false;
+    }
+    output.pending.clear();
+    return true;
+}
+
+QString BlobExtractor::storeObject(Output &output, const QByteArray &sha256)
+{
+    UNBOXER_TRACE_SPAN("extractor store");
+    outputDirectory.mkpath("objects");
+    auto filename = QDir(outputDirectory.filePath("objects")).filePath(QString::fromLatin1(sha256.toHex()));
+    if (QFile::exists(filename)) {
+        if (output.file) {
+            output.file->remove(); // stored already. the data was written for nothing
+        }
+        return filename;
+    }
+    if (output.file) {
+        output.file->close();
+        // may fail only if the same content was stored concurrently
+        if (!output.file->rename(filename)) {
+            output.file->remove();
+        }
+        return filename;
+    }
+    QSaveFile file(filename);
+    if (!file.open(QIODevice::WriteOnly) || file.write(output.pending) != output.pending.size() || !file.commit()) {
+        qWarning() << "Failed to write to " << filename;
+        return QString();
     }
+    return filename;
 }
 
 }
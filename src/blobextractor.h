@@ -25,15 +25,20 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #pragma once
 
 #include "box.h"
+#include "boxhasher.h"
+#include "compressor.h"
 #include "unboxer_export.h"
 
 #include <QByteArray>
 #include <QDir>
 #include <QFile>
 #include <QHash>
+#include <QJsonArray>
 #include <QList>
 #include <QObject>
 
+#include <memory>
+
 namespace unboxer {
 
 class UNBOXER_EXPORT BlobExtractor : public QObject {
@@ -41,6 +46,9 @@ class UNBOXER_EXPORT BlobExtractor : public QObject {
 public:
     using BoxClosedCallback = std::function<void(unboxer::Box::Ptr, const QString &filename)>;
 
+    static constexpr qint64 DEFAULT_MEMORY_THRESHOLD = 1024 * 1024;
+    static constexpr qint64 COMPRESSION_BLOCK_SIZE   = 256 * 1024;
+
     BlobExtractor(const QString &fnameTemplate, const QList<QByteArray> &boxTypes = {});
     ~BlobExtractor();
 
@@ -50,14 +58,54 @@ public:
 
     inline void setOnBoxClosedCallback(BoxClosedCallback callback) { boxClosedCallback = callback; }
     inline void setOutputDirectory(const QDir &directory) { outputDirectory = directory; }
+    // Hash written data (HashAlgorithm flags) and set Box::digest before the closed callback. Not needed if the
+    // unboxer hashes already, see Unboxer::setHashing()
+    inline void setHashing(int algorithms) { hashAlgorithms = algorithms; }
+
+    // Content addressed mode. Every payload is stored once as objects/<sha256 in hex> in the output directory, no
+    // matter how many boxes and streams it comes with, and boxes are listed in manifest() instead of having own files.
+    // Payloads up to memoryThreshold bytes are kept in memory and not written at all if the object exists already.
+    // Larger ones are written to a temporary file which is renamed or removed on close. Has to be set before add()
+    void setContentAddressed(bool enabled, qint64 memoryThreshold = DEFAULT_MEMORY_THRESHOLD);
+
+    // Compress payloads of boxes of the type with the codec, e.g. ZlibCodec for TTML mdat or moov. Compression and
+    // writing happen on a worker thread, so the closed callback comes later, from the event loop, with the name of
+    // the final file which has the codec's suffix. Payloads which don't compress, like media, are written as is.
+    // Not applied to the content addressed mode. Has to be set before add()
+    void setCompression(const QByteArray &type, std::shared_ptr<const Codec> codec);
+    // blocks until all the compressed files are written. their closed callbacks are queued by then
+    void waitForDone();
+
+    // closed boxes of the content addressed mode: type, offset, size, sha256 and file relative to the output directory
+    inline QJsonArray manifest() const { return manifest_; }
+    bool              saveManifest(const QString &filename) const;
 
 private:
-    QString                                        fnameTemplate;
-    QList<QByteArray>                              boxTypes;
-    std::unordered_map<unboxer::Box::Ptr, QFile *> files;
-    int                                            fileIndex = 1;
-    BoxClosedCallback                              boxClosedCallback;
-    QDir                                           outputDirectory;
+    struct Output {
+        std::unique_ptr<QFile>     file;    // content addressed: temporary, null while the payload is in memory
+        std::unique_ptr<BoxHasher> hasher;  // if hashing is on. always if content addressed
+        QByteArray                 pending; // content addressed payload or compression block not written yet
+        qint64                     size = 0;
+
+        std::shared_ptr<CompressedFile> compressed; // written on the worker. file is moved there
+    };
+
+    bool    spill(Output &output);
+    QString storeObject(Output &output, const QByteArray &sha256);
+
+    QString                                       fnameTemplate;
+    QList<QByteArray>                             boxTypes;
+    std::unordered_map<unboxer::Box::Ptr, Output> outputs;
+    int                                           fileIndex = 1;
+    BoxClosedCallback                             boxClosedCallback;
+    QDir                                          outputDirectory;
+    int                                           hashAlgorithms   = NoHash;
+    bool                                          contentAddressed = false;
+    qint64                                        memoryThreshold  = DEFAULT_MEMORY_THRESHOLD;
+    QJsonArray                                    manifest_;
+
+    QHash<QByteArray, std::shared_ptr<const Codec>> codecs;
+    std::unique_ptr<CompressionWorker>              worker; // created with the first compressed file
 };
 
 }
@@ -37,6 +37,14 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 namespace unboxer {
 
+// digests of a payload computed while it's delivered. see Unboxer::setHashing()
+struct BoxDigest {
+    std::optional<std::uint64_t> xxh64;
+    QByteArray                   sha256; // raw 32 bytes. empty if not computed
+
+    bool isEmpty() const { return !xxh64 && sha256.isEmpty(); }
+};
+
 class Box {
 public:
     using Ptr = std::shared_ptr<Box>;
@@ -62,6 +70,9 @@ public:
     QByteArray    type;
     std::uint64_t size; // full size. 0 - all remaining
     std::uint64_t fileOffset;
+    std::uint32_t headerSize   = 0; // size, type, optional largesize and extended type
+    std::uint32_t preambleSize = 0; // containers only. first bytes of data delivered before sub-boxes
+    BoxDigest     digest;           // of the payload given to onDataRead. set before onClose if hashing is on
 
     // callbacks to be set by a library user
     std::function<void(Box::Ptr)>             onSubBoxOpen;
@@ -70,6 +81,7 @@ public:
 
 private:
     friend class UnboxerImpl;
+    template <class, class> friend class ThreadedUnboxer;
     bool          isClosed_ = false;
     std::uint64_t dataFed_  = 0;
 };
@@ -0,0 +1,156 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "boxhasher.h"
+
+#include <QtEndian>
+
+#include <cstring>
+
+namespace unboxer {
+
+namespace {
+    constexpr std::uint64_t PRIME1 = 11400714785074694791ULL;
+    constexpr std::uint64_t PRIME2 = 14029467366897019727ULL;
+    constexpr std::uint64_t PRIME3 = 1609587929392839161ULL;
+    constexpr std::uint64_t PRIME4 = 9650029242287828579ULL;
+    constexpr std::uint64_t PRIME5 = 2870177450012600261ULL;
+
+    inline std::uint64_t rotl(std::uint64_t value, int bits) { return (value << bits) | (value >> (64 - bits)); }
+
+    inline std::uint64_t round(std::uint64_t acc, std::uint64_t input)
+    {
+        acc += input * PRIME2;
+        return rotl(acc, 31) * PRIME1;
+    }
+
+    inline std::uint64_t mergeRound(std::uint64_t acc, std::uint64_t value)
+    {
+        acc ^= round(0, value);
+        return acc * PRIME1 + PRIME4;
+    }
+
+    inline std::uint64_t read64(const char *data) { return qFromLittleEndian<quint64>(data); }
+    inline std::uint64_t read32(const char *data) { return qFromLittleEndian<quint32>(data); }
+}
+
+Xxh64::Xxh64(std::uint64_t seed) : seed(seed), acc { seed + PRIME1 + PRIME2, seed + PRIME2, seed, seed - PRIME1 } { }
+
+void Xxh64::update(const char *data, std::size_t size)
+{
+    totalSize += size;
+    if (stripeSize) {
+        auto part = qMin(size, STRIPE_SIZE - stripeSize);
+        std::memcpy(stripe + stripeSize, data, part);
+        stripeSize += part;
+        data += part;
+        size -= part;
+        if (stripeSize < STRIPE_SIZE) {
+            return;
+        }
+        for (int i = 0; i < 4; i++) {
+            acc[i] = round(acc[i], read64(stripe + i * 8));
+        }
+        stripeSize = 0;
+    }
+    for (; size >= STRIPE_SIZE; data += STRIPE_SIZE, size -= STRIPE_SIZE) {
+        for (int i = 0; i < 4; i++) {
+            acc[i] = round(acc[i], read64(data + i * 8));
+        }
+    }
+    std::memcpy(stripe, data, size);
+    stripeSize = size;
+}
+
+std::uint64_t Xxh64::digest() const
+{
+    std::uint64_t hash;
+    if (totalSize >= STRIPE_SIZE) {
+        hash = rotl(acc[0], 1) + rotl(acc[1], 7) + rotl(acc[2], 12) + rotl(acc[3], 18);
+        for (auto value : acc) {
+            hash = mergeRound(hash, value);
+        }
+    } else {
+        hash = seed + PRIME5;
+    }
+    hash += totalSize;
+
+    const char *tail = stripe;
+    std::size_t left = stripeSize;
+    for (; left >= 8; tail += 8, left -= 8) {
+        hash ^= round(0, read64(tail));
+        hash = rotl(hash, 27) * PRIME1 + PRIME4;
+    }
+    if (left >= 4) {
+        hash ^= read32(tail) * PRIME1;
+        hash = rotl(hash, 23) * PRIME2 + PRIME3;
+        tail += 4;
+        left -= 4;
+    }
+    for (; left; tail++, left--) {
+        hash ^= std::uint8_t(*tail) * PRIME5;
+        hash = rotl(hash, 11) * PRIME1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= PRIME2;
+    hash ^= hash >> 29;
+    hash *= PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+BoxHasher::BoxHasher(int algorithms)
+{
+    if (algorithms & Xxh64Hash) {
+        xxh64.emplace();
+    }
+    if (algorithms & Sha256Hash) {
+        sha256 = std::make_unique<QCryptographicHash>(QCryptographicHash::Sha256);
+    }
+}
+
+void BoxHasher::update(const QByteArray &data)
+{
+    if (xxh64) {
+        xxh64->update(data.constData(), std::size_t(data.size()));
+    }
+    if (sha256) {
+        sha256->addData(data);
+    }
+}
+
+BoxDigest BoxHasher::result() const
+{
+    BoxDigest digest;
+    if (xxh64) {
+        digest.xxh64 = xxh64->digest();
+    }
+    if (sha256) {
+        digest.sha256 = sha256->result();
+    }
+    return digest;
+}
+
+} // namespace unboxer
@@ -0,0 +1,78 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "box.h"
+#include "unboxer_export.h"
+
+#include <QCryptographicHash>
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+namespace unboxer {
+
+// see Unboxer::setHashing(). may be combined
+enum HashAlgorithm { NoHash = 0, Xxh64Hash = 1, Sha256Hash = 2 };
+
+/**
+ * @brief Streaming XXH64 with the reference algorithm's output.
+ *
+ * Fast and good enough to tell payloads apart, but not a cryptographic hash.
+ */
+class UNBOXER_EXPORT Xxh64 {
+public:
+    explicit Xxh64(std::uint64_t seed = 0);
+
+    void          update(const char *data, std::size_t size);
+    std::uint64_t digest() const;
+
+private:
+    static constexpr std::size_t STRIPE_SIZE = 32;
+
+    std::uint64_t seed;
+    std::uint64_t acc[4];
+    std::uint64_t totalSize = 0;
+    char          stripe[STRIPE_SIZE]; // bytes which don't make a whole stripe yet
+    std::size_t   stripeSize = 0;
+};
+
+/**
+ * @brief Computes digests of a payload from the slices it's delivered with.
+ */
+class UNBOXER_EXPORT BoxHasher {
+public:
+    explicit BoxHasher(int algorithms);
+
+    void      update(const QByteArray &data);
+    BoxDigest result() const;
+
+private:
+    std::optional<Xxh64>                xxh64;
+    std::unique_ptr<QCryptographicHash> sha256;
+};
+
+} // namespace unboxer
@@ -24,16 +24,43 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "boxreader.h"
 
+#include "trace.h"
+
 #include <QtEndian>
 
+#include <algorithm>
 #include <cassert>
 #include <optional>
 
+#include <time.h>
+#include <unistd.h>
+
 namespace unboxer {
 
 constexpr std::uint64_t MAX_BOX_SIZE      = 50ull * 1024 * 1024 * 1024;
 constexpr std::uint8_t  MINIMAL_HEADER_SZ = 8;
 constexpr std::uint8_t  EXTENDED_TYPE_SZ  = 16;
+constexpr std::uint8_t  TERMINATOR_SZ     = 4; // zero after the last sub-box of some QuickTime containers
+constexpr std::uint8_t  META_PEEK_SZ      = 8; // FullBox header or size and type of hdlr in QuickTime `meta`
+constexpr std::uint64_t MEGABYTE          = 1024 * 1024;
+
+static std::chrono::nanoseconds threadCpuTime()
+{
+#if defined(_POSIX_THREAD_CPUTIME) && _POSIX_THREAD_CPUTIME >= 0
+    timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0) {
+        return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+    }
+#endif
+    // wall clock is the best we can get here
+    return std::chrono::steady_clock::now().time_since_epoch();
+}
+
+// four character codes are printable, with the exception of '©' used by some QuickTime types
+static bool isPlausibleType(const char *type)
+{
+    return std::all_of(type, type + 4, [](char c) { return (c >= 0x20 && c < 0x7f) || std::uint8_t(c) == 0xa9; });
+}
 
 /* // from standard (mp4 4.2 Object Structure)
 aligned(8) class Box (unsigned int(32) boxtype,
@@ -58,6 +85,11 @@ public:
     struct Payload {
         std::uint64_t size       = 0; // 0 - till the end
         std::uint64_t fileOffset = 0; // parent box start offset from the beginning of the file/stream
+        // the box itself, for checkpoints
+        QByteArray    type;
+        std::uint64_t boxSize    = 0; // 0 - till the end of its parent
+        std::uint64_t boxOffset  = 0;
+        std::uint32_t headerSize = 0;
     };
 
     BoxReaderImpl()
@@ -66,35 +98,123 @@ public:
     }
 
     Status feed(const QByteArray &data);
+    Status parse(const QByteArray &data);
     Status close(Status reason);
 
     Status sendData();
+    void   enterContainer();       // the current box's children follow
+    Status closeFinishedParents(); // the containers which end at the current offset
+
+    std::optional<Checkpoint> checkpoint() const;
+    void                      resume(const Checkpoint &checkpoint);
+
+    // recovery mode
+    Status corrupted(bool atHeader);
+    bool   resync();
+    void   dropDamaged(std::size_t size);
+    void   reportDamaged();
 
     std::list<Payload>           parents;
     std::optional<std::uint64_t> fullBoxSize; // if not set -> not enough data to parse size. if 0 - till the end
     std::uint64_t                boxPayloadBytesLeft = 0;
+    bool                         skipping            = false; // payload of the current box is dropped
+    bool                         inPreamble          = false; // delivering fixed fields before sub-boxes
+    std::uint64_t                childrenSize        = 0;     // of the container which preamble is delivered
+    QByteArray                   currentType;                 // of the box being read
+    std::uint64_t                currentOffset       = 0;     // of its header
+    std::uint32_t                currentHeaderSize   = 0;
+    std::uint64_t                toDiscard           = 0;     // up to the checkpoint if it wasn't skipped
 
     QByteArray    buffer; // a part of payload. could be somewhere in the middle of a box
-    int           bufferOffset = 0;
-    std::uint64_t fileOffset   = 0;
+    int           bufferOffset     = 0;
+    std::uint64_t bufferGeneration = 0; // bumped on every feed
+    QByteArray    payloadStart;         // of the box being opened
+    std::uint64_t fileOffset       = 0;
+
+    ParseBudget              budget;
+    std::uint64_t            boxCount = 0;
+    std::chrono::nanoseconds cpuTimeSpent { 0 };
+    ParseStats              *stats = nullptr;
 
     BoxReader::BoxOpenedCallback boxOpenedCallback;
     BoxReader::BoxClosedCallback boxClosedCallback;
     BoxReader::DataReadCallback  dataReadCallback;
+    BoxReader::SkipCallback      skipCallback;
+    BoxReader::HeaderCallback    headerCallback;
+    BoxReader::ResyncCallback    resyncCallback; // recovery mode if set
+
+    SyncScanner   scanner;
+    bool          resyncing   = false;
+    std::uint64_t resyncStart = 0; // file offset of the damaged data
 };
 
 Status BoxReaderImpl::feed(const QByteArray &data)
 {
-    buffer += data;
+    UNBOXER_TRACE_SPAN("feed");
+    if (!budget.maxCpuTime.count()) {
+        return parse(data);
+    }
+    auto start  = threadCpuTime();
+    auto status = parse(data);
+    cpuTimeSpent += threadCpuTime() - start;
+    if (status == Status::Ok && cpuTimeSpent > budget.maxCpuTime) {
+        return Status::BudgetExceeded;
+    }
+    return status;
+}
+
+Status BoxReaderImpl::parse(const QByteArray &data)
+{
+    bufferGeneration++;
+    if (buffer.isEmpty()) {
+        buffer = data; // no copy. if it's raw data it's still valid till the end of feed
+    } else {
+        buffer += data;
+        UNBOXER_STAT(if (stats) stats->bufferCopies++);
+    }
+    UNBOXER_STAT(if (stats) stats->peakBufferSize = qMax(stats->peakBufferSize, std::size_t(buffer.size())));
+    UNBOXER_TRACE_COUNTER("reader buffer", buffer.size());
     while (buffer.size() - bufferOffset > 0) { // iterate over boxes
+        if (toDiscard) {
+            auto size = qMin<std::uint64_t>(toDiscard, buffer.size() - bufferOffset);
+            bufferOffset += int(size);
+            fileOffset += size;
+            toDiscard -= size;
+            continue;
+        }
+        if (resyncing) {
+            if (!resync()) {
+                break; // will wait for more data
+            }
+            continue;
+        }
         if (parents.empty()) {
             return Corrupted; // got data after all boxes were closed including artifical root. broken file likely
         }
         if (!fullBoxSize) { // either very beginning of a box or not enough data to parse
             // C++20 span would work better here
-            char       *parseStart = buffer.data() + bufferOffset;
+            const char *parseStart = buffer.constData() + bufferOffset;
             std::size_t bytesLeft  = buffer.size() - bufferOffset;
 
+            if (auto const &parent = parents.back();
+                parent.size && parent.fileOffset + parent.size - fileOffset == TERMINATOR_SZ) {
+                // QuickTime ends e.g. udta with a 32-bit zero instead of a box. it's delivered as the container's data
+                if (bytesLeft < TERMINATOR_SZ) {
+                    break;
+                }
+                if (!qFromBigEndian<quint32>(parseStart)) {
+                    if (dataReadCallback(QByteArray::fromRawData(parseStart, TERMINATOR_SZ)) != Status::Ok) {
+                        return Status::Corrupted;
+                    }
+                    bufferOffset += TERMINATOR_SZ;
+                    fileOffset += TERMINATOR_SZ;
+                    if (closeFinishedParents() != Status::Ok) {
+                        return Status::Corrupted;
+                    }
+                    continue;
+                }
+            }
+
             std::uint64_t payloadOffset = 0;
             if (bytesLeft < MINIMAL_HEADER_SZ) // size + type
                 break;                         // will wait for more data
@@ -122,20 +242,70 @@ Status BoxReaderImpl::feed(const QByteArray &data)
             if (boxSize > MAX_BOX_SIZE || (hasExtendedSize && boxSize < payloadOffset)
                 || (!hasExtendedSize && boxSize > 0 && boxSize < payloadOffset)) { // size 0 - is all remaining
                 // looks like something invalid
-                return Status::Corrupted;
+                if (corrupted(true) != Status::Ok) {
+                    return Status::Corrupted;
+                }
+                continue;
+            }
+            if (resyncCallback && parents.size() == 1 && !isPlausibleType(parseStart + 4)) {
+                // nothing limits a top level box, so in recovery mode its type is the only sanity check
+                if (corrupted(true) != Status::Ok) {
+                    return Status::Corrupted;
+                }
+                continue;
+            }
+            if (auto const &parent = parents.back(); parent.size
+                && (payloadOffset > parent.fileOffset + parent.size - fileOffset
+                    || boxSize > parent.fileOffset + parent.size - fileOffset)) { // doesn't fit into the parent
+                if (corrupted(true) != Status::Ok) {
+                    return Status::Corrupted;
+                }
+                continue;
+            }
+            if (boxType == "meta" && bytesLeft < payloadOffset + META_PEEK_SZ
+                && (!boxSize || boxSize >= payloadOffset + META_PEEK_SZ)) {
+                break; // wait for the beginning of the payload, see BoxReader::payloadStart()
+            }
+            boxCount++;
+            if ((budget.maxDepth && parents.size() > budget.maxDepth) || (budget.maxBoxes && boxCount > budget.maxBoxes)
+                || (budget.maxHeadersPerMB && boxCount > budget.maxHeadersPerMB * (fileOffset / MEGABYTE + 1))) {
+                return Status::BudgetExceeded;
             }
 
-            bool needRecurse = boxOpenedCallback(boxType, boxSize, fileOffset);
+            if (headerCallback) {
+                headerCallback(QByteArray::fromRawData(parseStart, int(payloadOffset)));
+            }
+            payloadStart  = QByteArray::fromRawData(parseStart + payloadOffset, int(bytesLeft - payloadOffset));
+            auto decision = boxOpenedCallback(boxType, boxSize, fileOffset);
+            payloadStart.clear();
+            currentType       = std::move(boxType);
+            currentOffset     = fileOffset;
+            currentHeaderSize = std::uint32_t(payloadOffset);
             bufferOffset += payloadOffset;
             fileOffset += payloadOffset;
-            fullBoxSize  = boxSize;
-            auto &parent = parents.back();
-            boxPayloadBytesLeft
-                = boxSize ? boxSize - payloadOffset : (parent.size ? parent.fileOffset + parent.size - fileOffset : 0);
-            if (needRecurse) {
-                parents.emplace_back(Payload { boxPayloadBytesLeft, fileOffset });
-                fullBoxSize = std::nullopt;
-                continue;
+            if (auto const &parent = parents.back(); !boxSize && parent.size) {
+                boxSize = parent.fileOffset + parent.size - currentOffset; // size 0 - till the end of the parent
+            }
+            fullBoxSize         = boxSize;
+            boxPayloadBytesLeft = boxSize ? boxSize - payloadOffset : 0;
+            skipping = decision.action == BoxAction::Skip;
+            if (decision.action == BoxAction::Recurse) {
+                auto preamble = decision.preambleSize;
+                if (boxPayloadBytesLeft && boxPayloadBytesLeft < preamble) {
+                    if (corrupted(false) != Status::Ok) {
+                        return Status::Corrupted;
+                    }
+                    continue;
+                }
+                childrenSize = boxPayloadBytesLeft ? boxPayloadBytesLeft - preamble : 0;
+                if (preamble) {
+                    boxPayloadBytesLeft = preamble; // sub-boxes are handled in sendData() when it's delivered
+                    inPreamble          = true;
+                } else if (!boxSize || childrenSize) {
+                    enterContainer();
+                    continue;
+                }
+                // else an empty container. closed right away as an empty blob
             }
         }
 
@@ -148,15 +318,29 @@ Status BoxReaderImpl::feed(const QByteArray &data)
         }
     }
     // we sent as much data as we could. drop beginning of the buffer
-    buffer.remove(0, bufferOffset);
+    if (bufferOffset == buffer.size()) {
+        buffer.clear();
+    } else {
+        // the rest has to survive the feed. detach it from input data
+        buffer = QByteArray(buffer.constData() + bufferOffset, buffer.size() - bufferOffset);
+        UNBOXER_STAT(if (stats) stats->bufferCopies++);
+    }
     bufferOffset = 0;
+    UNBOXER_TRACE_COUNTER("reader buffer", buffer.size());
+    if (budget.maxBufferedBytes && std::size_t(buffer.size()) > budget.maxBufferedBytes) {
+        return Status::BudgetExceeded;
+    }
     return Status::Ok;
 }
 
 Status BoxReaderImpl::close(Status reason)
 {
+    if (reason == Status::Eof && resyncing) {
+        dropDamaged(buffer.size() - bufferOffset); // no box after the damage
+        reportDamaged();
+    }
     if (reason == Status::Eof) {
-        if (fullBoxSize && *fullBoxSize) { // got unfinished box
+        if (toDiscard || (fullBoxSize && *fullBoxSize)) { // ended before the checkpoint or got unfinished box
             return Status::Corrupted;
         }
         while (!parents.empty()) {
@@ -177,13 +361,13 @@ Status BoxReaderImpl::close(Status reason)
 
 Status BoxReaderImpl::sendData()
 {
-    char       *parseStart = buffer.data() + bufferOffset;
+    const char *parseStart = buffer.constData() + bufferOffset;
     std::size_t bytesLeft  = buffer.size() - bufferOffset;
 
     // send data to callback (TODO we need the same on eof in case of zero size box)
-    auto sendSz = *fullBoxSize ? qMin(boxPayloadBytesLeft, std::uint64_t(bytesLeft)) : buffer.size();
+    auto sendSz = *fullBoxSize || inPreamble ? qMin(boxPayloadBytesLeft, std::uint64_t(bytesLeft)) : bytesLeft;
     if (sendSz) {
-        auto status = dataReadCallback(QByteArray::fromRawData(parseStart, sendSz));
+        auto status = skipping ? Status::Ok : dataReadCallback(QByteArray::fromRawData(parseStart, sendSz));
         if (status == Status::Ok) {
             bufferOffset += sendSz;
             fileOffset += sendSz;
@@ -192,31 +376,169 @@ Status BoxReaderImpl::sendData()
             return status;
         }
     }
+    // the buffer is exhausted here. the rest of skipped box could be skipped by the source without reading it
+    if (skipping && *fullBoxSize && boxPayloadBytesLeft && skipCallback && skipCallback(boxPayloadBytesLeft)) {
+        UNBOXER_STAT(if (stats) stats->bytesSkipped += boxPayloadBytesLeft);
+        fileOffset += boxPayloadBytesLeft;
+        boxPayloadBytesLeft = 0;
+    }
+    if (inPreamble && !boxPayloadBytesLeft) {
+        inPreamble = false;
+        if (!*fullBoxSize || childrenSize) {
+            enterContainer();
+            return Status::Ok;
+        }
+        // nothing after the preamble. close as usual
+    }
     // the data was consumed. check if we finished sending all the data of the box
     if (*fullBoxSize && !boxPayloadBytesLeft) {
         fullBoxSize = std::nullopt; // mark as the start of the next box
         boxClosedCallback();
-        while (!parents.empty()) {
-            const auto &parent = parents.back();
-            if (parent.size) {
-                auto expectedParentEnd = parent.fileOffset + parent.size;
-                if (expectedParentEnd < fileOffset) { // if children took more than expected
-                    return Status::Corrupted;
-                }
-                if (expectedParentEnd == fileOffset) {        // if read all the parent
-                    if (++parents.begin() != parents.end()) { // close all boxes but our artificial root
-                        boxClosedCallback();
-                    }
-                    parents.pop_back();
-                    continue;
+        return closeFinishedParents();
+    }
+    return Status::Ok;
+}
+
+Status BoxReaderImpl::closeFinishedParents()
+{
+    while (!parents.empty()) {
+        const auto &parent = parents.back();
+        if (parent.size) {
+            auto expectedParentEnd = parent.fileOffset + parent.size;
+            if (expectedParentEnd < fileOffset) { // if children took more than expected
+                return corrupted(false);
+            }
+            if (expectedParentEnd == fileOffset) {        // if read all the parent
+                if (++parents.begin() != parents.end()) { // close all boxes but our artificial root
+                    boxClosedCallback();
                 }
+                parents.pop_back();
+                continue;
             }
-            break;
         }
+        break;
+    }
+    return Status::Ok;
+}
+
+void BoxReaderImpl::enterContainer()
+{
+    parents.emplace_back(
+        Payload { childrenSize, fileOffset, currentType, *fullBoxSize, currentOffset, currentHeaderSize });
+    fullBoxSize = std::nullopt;
+}
+
+std::optional<Checkpoint> BoxReaderImpl::checkpoint() const
+{
+    if (resyncing || toDiscard || parents.empty()) {
+        return std::nullopt; // nowhere to resume at
+    }
+    Checkpoint checkpoint;
+    // right before the current box if it's being read. its parents are open either way
+    checkpoint.offset   = fullBoxSize ? currentOffset : fileOffset;
+    checkpoint.boxCount = boxCount;
+    for (auto it = ++parents.begin(); it != parents.end(); ++it) {
+        checkpoint.containers.push_back(
+            { it->type, it->boxSize, it->boxOffset, it->headerSize, it->fileOffset, it->size });
+    }
+    return checkpoint;
+}
+
+void BoxReaderImpl::resume(const Checkpoint &checkpoint)
+{
+    boxCount = checkpoint.boxCount;
+    for (auto const &container : checkpoint.containers) {
+        if (headerCallback) {
+            headerCallback(container.header());
+        }
+        boxOpenedCallback(container.type, container.size, container.offset); // it was recursed into before anyway
+        parents.emplace_back(Payload { container.childrenSize, container.childrenOffset, container.type,
+                                       container.size, container.offset, container.headerSize });
+    }
+    // taken when they were being closed. they are closed once more so the consumer doesn't miss it
+    while (parents.size() > 1 && parents.back().size
+           && parents.back().fileOffset + parents.back().size == checkpoint.offset) {
+        boxClosedCallback();
+        parents.pop_back();
+    }
+    if (skipCallback && skipCallback(checkpoint.offset)) {
+        UNBOXER_STAT(if (stats) stats->bytesSkipped += checkpoint.offset);
+        fileOffset = checkpoint.offset;
+    } else {
+        toDiscard = checkpoint.offset; // read through
+    }
+}
+
+Status BoxReaderImpl::corrupted(bool atHeader)
+{
+    if (!resyncCallback) {
+        return Status::Corrupted;
+    }
+    // the structure can't be trusted anymore. close everything and start over at the top level
+    if (fullBoxSize) {
+        fullBoxSize = std::nullopt;
+        boxClosedCallback();
+    }
+    while (parents.size() > 1) {
+        boxClosedCallback();
+        parents.pop_back();
+    }
+    skipping            = false;
+    inPreamble          = false;
+    boxPayloadBytesLeft = 0;
+    resyncing           = true;
+    resyncStart         = fileOffset;
+    if (atHeader) {
+        dropDamaged(1); // the broken header is not a place to resume at
     }
     return Status::Ok;
 }
 
+bool BoxReaderImpl::resync()
+{
+    const char *data = buffer.constData() + bufferOffset;
+    std::size_t size = buffer.size() - bufferOffset;
+    std::size_t from = 0; // the first header position to check
+    while (from + MINIMAL_HEADER_SZ <= size) {
+        auto type = scanner.findType(data + from + 4, size - from - 4);
+        if (type == SyncScanner::npos) {
+            break;
+        }
+        auto          start   = from + type;
+        std::uint64_t boxSize = qFromBigEndian<quint32>(data + start);
+        if (boxSize == 1) {
+            if (start + MINIMAL_HEADER_SZ + sizeof(std::uint64_t) > size) {
+                dropDamaged(start); // wait for the extended size
+                return false;
+            }
+            boxSize = qFromBigEndian<quint64>(data + start + MINIMAL_HEADER_SZ);
+        }
+        bool plausible = boxSize == 0 || (boxSize >= MINIMAL_HEADER_SZ && boxSize <= MAX_BOX_SIZE);
+        if (plausible) {
+            dropDamaged(start);
+            reportDamaged();
+            return true;
+        }
+        from = start + 1;
+    }
+    // the last bytes could be the beginning of a header
+    dropDamaged(size - qMin<std::size_t>(size, MINIMAL_HEADER_SZ - 1));
+    return false;
+}
+
+void BoxReaderImpl::dropDamaged(std::size_t size)
+{
+    bufferOffset += int(size);
+    fileOffset += size;
+}
+
+void BoxReaderImpl::reportDamaged()
+{
+    resyncing = false;
+    UNBOXER_STAT(if (stats) stats->bytesDamaged += fileOffset - resyncStart);
+    resyncCallback(resyncStart, fileOffset - resyncStart);
+}
+
 BoxReader::BoxReader(BoxOpenedCallback &&boxOpened, BoxClosedCallback &&boxClosed, DataReadCallback &&dataRead) :
     impl(std::make_unique<BoxReaderImpl>())
 
@@ -234,4 +556,28 @@ Status BoxReader::feed(const QByteArray &inputData) { return impl->feed(inputDat
 
 Status BoxReader::close(Status reason) { return impl->close(reason); }
 
+void BoxReader::setBudget(const ParseBudget &budget) { impl->budget = budget; }
+
+void BoxReader::setStats(ParseStats *stats) { impl->stats = stats; }
+
+void BoxReader::setSkipCallback(SkipCallback &&callback) { impl->skipCallback = std::move(callback); }
+
+void BoxReader::setHeaderCallback(HeaderCallback &&callback) { impl->headerCallback = std::move(callback); }
+
+void BoxReader::setResyncCallback(ResyncCallback &&callback, const std::vector<QByteArray> &types)
+{
+    impl->resyncCallback = std::move(callback);
+    impl->scanner        = SyncScanner(types);
+}
+
+std::optional<Checkpoint> BoxReader::checkpoint() const { return impl->checkpoint(); }
+
+void BoxReader::resume(const Checkpoint &checkpoint) { impl->resume(checkpoint); }
+
+QByteArray BoxReader::buffer() const { return impl->buffer; }
+
+std::uint64_t BoxReader::bufferGeneration() const { return impl->bufferGeneration; }
+
+QByteArray BoxReader::payloadStart() const { return impl->payloadStart; }
+
 } // namespace unboxer
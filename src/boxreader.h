@@ -24,24 +24,51 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #pragma once
 
+#include "budget.h"
+#include "checkpoint.h"
+#include "stats.h"
 #include "status.h"
+#include "syncscanner.h"
 #include "unboxer_export.h"
 
 #include <QByteArray>
 
 #include <functional>
 #include <memory>
+#include <optional>
 
 namespace unboxer {
 
 class BoxReaderImpl;
 
+// what to do with a just opened box
+enum class BoxAction {
+    Blob,    // deliver payload as is
+    Recurse, // parse payload as sub-boxes
+    Skip     // don't deliver payload at all. the box is still closed as usual
+};
+
+struct BoxDecision {
+    BoxDecision(BoxAction action = BoxAction::Blob, std::uint32_t preambleSize = 0) :
+        action(action), preambleSize(preambleSize)
+    {
+    }
+
+    BoxAction     action;
+    std::uint32_t preambleSize; // Recurse only. bytes delivered as the box data before its sub-boxes
+};
+
 class UNBOXER_EXPORT BoxReader {
 public:
-    // returns true if recursion is needed. otherwise payload will be treated as binary blob
-    using BoxOpenedCallback = std::function<bool(const QByteArray &, std::uint64_t, std::uint64_t)>;
+    using BoxOpenedCallback = std::function<BoxDecision(const QByteArray &, std::uint64_t, std::uint64_t)>;
     using BoxClosedCallback = std::function<void()>;
     using DataReadCallback  = std::function<Status(const QByteArray &)>;
+    // raw header of a box. called right before BoxOpenedCallback
+    using HeaderCallback = std::function<void(const QByteArray &)>;
+    // asked to skip the given amount of bytes right after the last fed data. returns false if it can't
+    using SkipCallback = std::function<bool(std::uint64_t)>;
+    // a damaged range which was skipped: file offset and size
+    using ResyncCallback = std::function<void(std::uint64_t, std::uint64_t)>;
 
     BoxReader(BoxOpenedCallback &&boxOpened, BoxClosedCallback &&boxClosed, DataReadCallback &&dataRead);
     ~BoxReader();
@@ -63,6 +90,71 @@ public:
      */
     Status close(Status reason);
 
+    /**
+     * @brief limit resources the reader may spend on the stream
+     * @param budget limits. When any of them is exceeded feed() returns Status::BudgetExceeded
+     */
+    void setBudget(const ParseBudget &budget);
+
+    /**
+     * @brief where to account buffer statistics. Has effect only if the library is built with ENABLE_STATS
+     * @param stats has to outlive the reader
+     */
+    void setStats(ParseStats *stats);
+
+    /**
+     * @brief let the reader skip payload of BoxAction::Skip boxes without it being fed
+     * @param callback to skip in the source. Without it skipped payload is still fed and dropped
+     */
+    void setSkipCallback(SkipCallback &&callback);
+
+    /**
+     * @brief tap raw box headers, e.g. to restore payload of a container for somebody who wants it as a blob
+     * @param callback gets a slice valid only till the callback returns
+     */
+    void setHeaderCallback(HeaderCallback &&callback);
+
+    /**
+     * @brief recover from corrupted data instead of failing with Status::Corrupted
+     * @param callback gets every damaged range. On damage all open boxes are closed and parsing resumes at the next
+     *        top level box of one of the types, see SyncScanner
+     * @param types where parsing may resume
+     */
+    void setResyncCallback(ResyncCallback &&callback, const std::vector<QByteArray> &types = SyncScanner::defaultTypes());
+
+    /**
+     * @brief state to resume the parse at with another reader
+     * @return state at the last box boundary. nullopt while recovering from damaged data
+     */
+    std::optional<Checkpoint> checkpoint() const;
+
+    /**
+     * @brief start at the checkpoint instead of the beginning of the stream. Has to be called before the first feed
+     * @param checkpoint containers of it are opened again. Then the source is asked to skip to its offset, and if it
+     *        can't the data before it is dropped as it's fed
+     */
+    void resume(const Checkpoint &checkpoint);
+
+    /**
+     * @brief the buffer slices passed to DataReadCallback point to. Could be kept to keep a slice alive
+     * @return either the fed data itself (so possibly raw) or the reader's own copy
+     */
+    QByteArray buffer() const;
+
+    /**
+     * @brief identifies the content of buffer(). A raw buffer of the next feed may reuse the address of the previous
+     *        one, so this is the only way to tell them apart
+     * @return a new value on every feed
+     */
+    std::uint64_t bufferGeneration() const;
+
+    /**
+     * @brief what's buffered of the payload of the box being opened. Valid only in BoxOpenedCallback
+     * @return for `meta` at least 8 bytes unless the box is shorter, enough to tell QuickTime's one without FullBox
+     *         header from ISO's one
+     */
+    QByteArray payloadStart() const;
+
 private:
     std::unique_ptr<BoxReaderImpl> impl;
 };
@@ -0,0 +1,274 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "boxrewriter.h"
+
+#include "trace.h"
+
+#include <QtEndian>
+
+#include <cstring>
+#include <limits>
+
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#endif
+
+namespace unboxer {
+
+namespace {
+    constexpr int OFFSETS_PREFIX_SIZE = 16; // version, flags, track_ID/sample_count and the offset
+
+    template <class T> QByteArray bigEndian(T value)
+    {
+        QByteArray data(sizeof(T), '\0');
+        qToBigEndian<T>(value, data.data());
+        return data;
+    }
+}
+
+BoxRewriter::BoxRewriter(QFile *output, Filter &&filter) : output(output), filter(std::move(filter)) { }
+
+BoxRewriter::Filter BoxRewriter::dropping(const QList<QByteArray> &types)
+{
+    return [types](const Box::Ptr &box, std::size_t) {
+        auto type = box->type.size() > 4 ? QByteArray("uuid") : box->type; // any extended type
+        return Edit { types.contains(type) ? Action::Drop : Action::Keep, QByteArray() };
+    };
+}
+
+bool BoxRewriter::setSourceFile(const QString &filename)
+{
+    source.setFileName(filename);
+    return source.open(QIODevice::ReadOnly);
+}
+
+void BoxRewriter::attach(Box::Ptr root)
+{
+    nodes.clear();
+    offsets.clear();
+    root->onSubBoxOpen = [this](Box::Ptr box) { setup(box, 0); };
+}
+
+void BoxRewriter::setup(const Box::Ptr &box, std::size_t depth)
+{
+    if (status_ != Status::Ok) {
+        return;
+    }
+    auto edit = filter ? filter(box, depth) : Edit();
+    if (edit.action != Action::Keep) {
+        box->isContainer = false; // neither recursed into nor read
+        if (edit.action == Action::Replace) {
+            write(edit.replacement);
+        }
+        return;
+    }
+
+    if (depth == 0 && box->type == "moof") {
+        moofShift = output->pos() - qint64(box->fileOffset);
+        offsets.clear();
+    } else if (box->type == "traf") {
+        trafHasBase = false;
+    }
+    Node node;
+    node.headerPos = output->pos();
+    node.size      = box->size;
+    node.largeSize = box->headerSize - (box->type.size() > 4 ? 16 : 0) > 8;
+    if (writeHeader(*box) != Status::Ok) {
+        return;
+    }
+    node.payloadPos = output->pos();
+    if (depth == 0 && box->type == "mdat" && !offsets.empty()) {
+        shiftOffsets(node.payloadPos - qint64(box->fileOffset + box->headerSize));
+    }
+    if (source.isOpen() && !box->isContainer && box->size && box->size - box->headerSize >= ZERO_COPY_THRESHOLD) {
+        node.copyFrom = box->fileOffset + box->headerSize;
+        node.copySize = box->size - box->headerSize;
+    }
+    nodes.push_back(node);
+
+    if (box->isContainer) {
+        box->onSubBoxOpen = [this, depth](Box::Ptr subBox) { setup(subBox, depth + 1); };
+    }
+    if (!node.copySize) { // otherwise nobody reads it and the parser skips it
+        box->onDataRead = [this, collect = box->type == "tfhd" || box->type == "trun"](const QByteArray &data) {
+            auto &prefix = nodes.back().prefix;
+            if (collect && prefix.size() < OFFSETS_PREFIX_SIZE) {
+                prefix += data.left(OFFSETS_PREFIX_SIZE - prefix.size());
+            }
+            return write(data);
+        };
+    }
+    box->onClose = [this, box = box.get()]() { return closeNode(*box); };
+}
+
+Status BoxRewriter::write(const QByteArray &data)
+{
+    if (status_ != Status::Ok) {
+        return status_;
+    }
+    UNBOXER_TRACE_SPAN("rewriter write");
+    if (output->write(data) != data.size()) {
+        return fail(Status::WriteFailed);
+    }
+    return Status::Ok;
+}
+
+Status BoxRewriter::writeHeader(const Box &box)
+{
+    // the same form as in the source, so the copy of an unchanged box is identical
+    bool       extendedType = box.type.size() > 4;
+    bool       largeSize    = box.headerSize - (extendedType ? 16 : 0) > 8;
+    QByteArray header       = bigEndian<quint32>(largeSize ? 1 : quint32(box.size));
+    header += extendedType ? QByteArray("uuid") : box.type;
+    if (largeSize) {
+        header += bigEndian<quint64>(box.size);
+    }
+    if (extendedType) {
+        header += box.type;
+    }
+    return write(header);
+}
+
+Status BoxRewriter::closeNode(const Box &box)
+{
+    if (status_ != Status::Ok || nodes.empty()) {
+        return status_;
+    }
+    auto node = std::move(nodes.back());
+    nodes.pop_back();
+    if (node.copySize && copyPayload(node) != Status::Ok) {
+        return status_;
+    }
+    if (box.type == "tfhd" || box.type == "trun") {
+        collectOffsets(box, node);
+    }
+    auto size = std::uint64_t(output->pos() - node.headerPos);
+    if (!node.size || size == node.size) {
+        return Status::Ok;
+    }
+    if (node.largeSize) {
+        return patch(node.headerPos + 8, bigEndian<quint64>(size));
+    }
+    if (size > std::numeric_limits<quint32>::max()) {
+        return fail(Status::WriteFailed); // grew out of the 32-bit size field
+    }
+    return patch(node.headerPos, bigEndian<quint32>(quint32(size)));
+}
+
+Status BoxRewriter::copyPayload(const Node &node)
+{
+    UNBOXER_TRACE_SPAN("rewriter copy");
+    if (!output->flush()) {
+        return fail(Status::WriteFailed);
+    }
+    qint64 from = qint64(node.copyFrom);
+    qint64 to   = output->pos();
+    qint64 left = qint64(node.copySize);
+#ifdef Q_OS_LINUX
+    loff_t in = from, out = to;
+    while (left > 0) {
+        auto copied = ::copy_file_range(source.handle(), &in, output->handle(), &out, std::size_t(left), 0);
+        if (copied <= 0) {
+            break; // e.g. not supported for these file systems. the rest is read and written below
+        }
+        left -= copied;
+        bytesCopied_ += copied;
+    }
+    from = in;
+    to   = out;
+#endif
+    if (!source.seek(from) || !output->seek(to)) {
+        return fail(Status::WriteFailed);
+    }
+    while (left > 0) {
+        auto chunk = source.read(qMin(left, COPY_CHUNK_SIZE));
+        if (chunk.isEmpty()) {
+            return fail(Status::Corrupted); // the source is shorter than it was parsed
+        }
+        if (write(chunk) != Status::Ok) {
+            return status_;
+        }
+        left -= chunk.size();
+    }
+    return Status::Ok;
+}
+
+Status BoxRewriter::patch(qint64 pos, const QByteArray &data)
+{
+    auto end = output->pos();
+    if (!output->seek(pos) || output->write(data) != data.size() || !output->seek(end)) {
+        return fail(Status::WriteFailed);
+    }
+    return Status::Ok;
+}
+
+void BoxRewriter::collectOffsets(const Box &box, const Node &node)
+{
+    auto const &prefix = node.prefix;
+    if (prefix.size() < 4) {
+        return;
+    }
+    auto flags = qFromBigEndian<quint32>(prefix.constData()) & 0xffffff;
+    if (box.type == "tfhd") {
+        // base_data_offset is absolute and then data_offset of trun is relative to it
+        trafHasBase = flags & 0x000001;
+        if (trafHasBase && prefix.size() >= 16) {
+            auto base = qint64(qFromBigEndian<quint64>(prefix.constData() + 8));
+            offsets.push_back({ node.payloadPos + 8, 8, base, false });
+        }
+    } else if ((flags & 0x000001) && !trafHasBase && prefix.size() >= 12) {
+        offsets.push_back({ node.payloadPos + 8, 4, qFromBigEndian<qint32>(prefix.constData() + 8), true });
+    }
+}
+
+Status BoxRewriter::shiftOffsets(std::int64_t shift)
+{
+    for (auto const &field : offsets) {
+        auto value = field.value + (field.relative ? shift - moofShift : shift);
+        if (value == field.value) {
+            continue;
+        }
+        if (field.size == 4 ? qint32(value) != value : value < 0) {
+            return fail(Status::WriteFailed); // doesn't fit the field anymore. wrapping would point at wrong data
+        }
+        auto status = patch(field.pos,
+                            field.size == 4 ? bigEndian<qint32>(qint32(value)) : bigEndian<quint64>(quint64(value)));
+        if (status != Status::Ok) {
+            return status;
+        }
+    }
+    offsets.clear();
+    return Status::Ok;
+}
+
+Status BoxRewriter::fail(Status status)
+{
+    if (status_ == Status::Ok) {
+        status_ = status;
+    }
+    return status_;
+}
+
+} // namespace unboxer
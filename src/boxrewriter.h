@@ -0,0 +1,124 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "box.h"
+#include "status.h"
+#include "unboxer_export.h"
+
+#include <QFile>
+#include <QList>
+
+#include <functional>
+#include <vector>
+
+namespace unboxer {
+
+/**
+ * @brief Writes a copy of the parsed stream with some boxes dropped or replaced.
+ *
+ * Attach it to the root box of an Unboxer and every box is decided by the filter when it's opened. Kept boxes are
+ * written as they are parsed, so the copy is made in the same single pass with constant memory. Afterwards:
+ * - sizes of the ancestors of changed boxes are patched in their headers;
+ * - data_offset of trun and base_data_offset of tfhd are shifted by the distance their mdat moved. Only the mdat
+ *   following the moof is considered, which is how fragmented files are laid out. A shifted offset which doesn't fit
+ *   its field fails the rewrite with WriteFailed;
+ * stco/co64 chunk offsets of progressive files aren't updated, so edits before mdat break them.
+ *
+ * The output has to be seekable. If the source file is given, kept blobs of ZERO_COPY_THRESHOLD bytes and more are
+ * not read by the parser at all but copied from file to file in the kernel (copy_file_range on Linux).
+ */
+class UNBOXER_EXPORT BoxRewriter {
+public:
+    enum class Action { Keep, Drop, Replace };
+    struct Edit {
+        Action     action = Action::Keep;
+        QByteArray replacement; // the whole new box including its header
+    };
+    // decides right after the box is opened. depth of top level boxes is 0
+    using Filter = std::function<Edit(const Box::Ptr &box, std::size_t depth)>;
+
+    static constexpr std::uint64_t ZERO_COPY_THRESHOLD = 64 * 1024;
+
+    // output has to be open for writing
+    BoxRewriter(QFile *output, Filter &&filter);
+
+    // drops boxes of the types at any depth
+    static Filter dropping(const QList<QByteArray> &types);
+
+    // the parsed file, for zero copy. has to be called before the stream is opened
+    bool setSourceFile(const QString &filename);
+
+    // from the stream opened callback
+    void attach(Box::Ptr root);
+
+    // Ok or the first error. the parse is stopped with it too if the error happens in onDataRead
+    Status        status() const { return status_; }
+    std::uint64_t bytesCopied() const { return bytesCopied_; } // in the kernel without being read
+
+private:
+    static constexpr qint64 COPY_CHUNK_SIZE = 1024 * 1024; // if the kernel can't copy
+
+    struct Node {
+        qint64        headerPos;  // in the output
+        std::uint64_t size;       // as in the source. 0 - till the end
+        bool          largeSize;  // 64-bit size field
+        qint64        payloadPos; // in the output
+        std::uint64_t copyFrom = 0; // zero copy payload offset in the source
+        std::uint64_t copySize = 0; // 0 - the payload is written as it's read
+        QByteArray    prefix;       // first bytes of tfhd or trun payload
+    };
+    // an offset field to shift once the mdat is reached
+    struct OffsetField {
+        qint64       pos;      // in the output
+        int          size;     // 4 or 8 bytes
+        std::int64_t value;    // as in the source
+        bool         relative; // to the moof start like in trun, or absolute like in tfhd
+    };
+
+    void   setup(const Box::Ptr &box, std::size_t depth);
+    Status write(const QByteArray &data);
+    Status writeHeader(const Box &box);
+    Status closeNode(const Box &box);
+    Status copyPayload(const Node &node);
+    Status patch(qint64 pos, const QByteArray &data);
+    void   collectOffsets(const Box &box, const Node &node);
+    Status shiftOffsets(std::int64_t shift);
+    Status fail(Status status);
+
+    QFile            *output;
+    Filter            filter;
+    QFile             source;
+    std::vector<Node> nodes; // kept open boxes
+    Status            status_      = Status::Ok;
+    std::uint64_t     bytesCopied_ = 0;
+
+    // fragment offsets
+    std::int64_t             moofShift   = 0; // output - source offset of the last moof
+    bool                     trafHasBase = false;
+    std::vector<OffsetField> offsets; // of the last moof
+};
+
+} // namespace unboxer
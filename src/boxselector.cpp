@@ -0,0 +1,136 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "boxselector.h"
+
+#include <algorithm>
+#include <tuple>
+
+namespace unboxer {
+
+// transitions on unknown types are cached up to this limit per state. protects from garbage with random types
+constexpr int MAX_CACHED_TRANSITIONS = 256;
+
+bool BoxSelector::setPatterns(const std::vector<QByteArray> &patterns)
+{
+    this->patterns.clear();
+    states.clear();
+    std::vector<std::vector<Element>> compiled;
+    for (auto const &pattern : patterns) {
+        std::vector<Element> elements;
+        for (auto const &part : pattern.split('/')) {
+            if (part == "**") {
+                elements.push_back({ Kind::AnyDepth, {} });
+            } else if (part == "*") {
+                elements.push_back({ Kind::Any, {} });
+            } else if (part.size() == 4) {
+                elements.push_back({ Kind::Exact, part });
+            } else {
+                return false;
+            }
+        }
+        compiled.push_back(std::move(elements));
+    }
+    this->patterns = std::move(compiled);
+
+    std::vector<Position> initial;
+    for (int i = 0; i < int(this->patterns.size()); i++) {
+        addClosed(initial, { i, 0, false });
+    }
+    intern(std::move(initial)); // becomes start()
+    return true;
+}
+
+// add the position and everything reachable from it without consuming a box ('**' matching zero levels)
+void BoxSelector::addClosed(std::vector<Position> &positions, Position position) const
+{
+    auto const &elements = patterns[position.pattern];
+    while (true) {
+        if (std::find(positions.begin(), positions.end(), position) == positions.end()) {
+            positions.push_back(position);
+        }
+        if (position.matched == int(elements.size()) || elements[position.matched].kind != Kind::AnyDepth) {
+            break;
+        }
+        position = { position.pattern, position.matched + 1, true };
+    }
+}
+
+BoxSelector::State BoxSelector::intern(std::vector<Position> &&positions)
+{
+    std::sort(positions.begin(), positions.end(), [](const Position &a, const Position &b) {
+        return std::tie(a.pattern, a.matched, a.viaWildcard) < std::tie(b.pattern, b.matched, b.viaWildcard);
+    });
+    for (std::size_t i = 0; i < states.size(); i++) {
+        if (states[i].positions == positions) {
+            return State(i);
+        }
+    }
+
+    DfaState state;
+    for (auto const &p : positions) {
+        if (p.matched == int(patterns[p.pattern].size())) {
+            state.selected = true;
+        } else if (p.viaWildcard) {
+            state.recurseIfContainer = true;
+        } else {
+            state.recurse = true;
+        }
+    }
+    state.positions = std::move(positions);
+    states.push_back(std::move(state));
+    return State(states.size() - 1);
+}
+
+BoxSelector::Match BoxSelector::next(State parent, const QByteArray &type)
+{
+    auto it = states[parent].transitions.constFind(type);
+    if (it == states[parent].transitions.constEnd()) {
+        std::vector<Position> positions;
+        for (auto const &p : states[parent].positions) {
+            auto const &elements = patterns[p.pattern];
+            if (p.matched == int(elements.size())) {
+                continue;
+            }
+            auto const &element = elements[p.matched];
+            if (element.kind == Kind::AnyDepth) {
+                addClosed(positions, { p.pattern, p.matched, true }); // one more level of '**'
+            } else if (element.kind == Kind::Any) {
+                addClosed(positions, { p.pattern, p.matched + 1, true });
+            } else if (element.type == type) {
+                addClosed(positions, { p.pattern, p.matched + 1, false });
+            }
+        }
+        auto state = intern(std::move(positions)); // may invalidate references to states
+        if (states[parent].transitions.size() < MAX_CACHED_TRANSITIONS) {
+            states[parent].transitions.insert(type, state);
+        }
+        auto const &s = states[state];
+        return { state, s.selected, s.recurse, s.recurseIfContainer };
+    }
+    auto const &s = states[*it];
+    return { *it, s.selected, s.recurse, s.recurseIfContainer };
+}
+
+}
@@ -0,0 +1,93 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "unboxer_export.h"
+
+#include <QByteArray>
+#include <QHash>
+
+#include <vector>
+
+namespace unboxer {
+
+// Set of box path patterns compiled into a lazily built DFA.
+//
+// A pattern is a list of box types separated by '/' starting from the top level, e.g. "moov/trak/mdia/mdhd".
+// '*' matches any single box and '**' matches any number (including zero) of nesting levels, so "moof/*/trun" and
+// "**/emsg" are valid patterns too. Every box gets a state derived from its parent's state and its own type, and
+// the state tells if the box is selected and if anything may be selected below it.
+class UNBOXER_EXPORT BoxSelector {
+public:
+    using State = int;
+
+    struct Match {
+        State state;
+        bool  selected;           // the box matches some pattern
+        bool  recurse;            // an explicitly named sub-box may be selected below
+        bool  recurseIfContainer; // only wildcards may match below. makes sense only for known containers
+    };
+
+    // replace the patterns. returns false and keeps the selector empty if any of them is malformed
+    bool setPatterns(const std::vector<QByteArray> &patterns);
+    bool isEmpty() const { return patterns.empty(); }
+
+    State start() const { return 0; }
+    Match next(State parent, const QByteArray &type);
+
+private:
+    enum class Kind { Exact, Any, AnyDepth };
+    struct Element {
+        Kind       kind;
+        QByteArray type;
+    };
+
+    // NFA position: pattern index, matched elements count and if the last step was done by a wildcard
+    struct Position {
+        int  pattern;
+        int  matched;
+        bool viaWildcard;
+        bool operator==(const Position &other) const
+        {
+            return pattern == other.pattern && matched == other.matched && viaWildcard == other.viaWildcard;
+        }
+    };
+
+    struct DfaState {
+        std::vector<Position>    positions; // sorted
+        bool                     selected           = false;
+        bool                     recurse            = false;
+        bool                     recurseIfContainer = false;
+        QHash<QByteArray, State> transitions;
+    };
+
+    State intern(std::vector<Position> &&positions);
+    void  addClosed(std::vector<Position> &positions, Position position) const;
+
+    std::vector<std::vector<Element>> patterns;
+    std::vector<DfaState>             states;
+};
+
+}
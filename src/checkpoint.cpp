@@ -0,0 +1,132 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "checkpoint.h"
+
+#include <QDataStream>
+#include <QtEndian>
+
+namespace unboxer {
+
+namespace {
+    constexpr quint32       MAGIC          = 0x55424350; // "UBCP"
+    constexpr quint8        VERSION        = 1;
+    constexpr std::uint32_t MINIMAL_HEADER = 8;
+    constexpr std::uint32_t LARGE_SIZE_SZ  = 8;
+    constexpr int           EXTENDED_TYPE  = 16;
+
+    // the container is inside the children of the previous one (from - end, 0 - unlimited) and open at offset
+    bool isConsistent(const Checkpoint::Container &container, std::uint64_t from, std::uint64_t end,
+                      std::uint64_t offset)
+    {
+        if (container.type.size() != 4 && container.type.size() != EXTENDED_TYPE) {
+            return false;
+        }
+        auto minimal = MINIMAL_HEADER + (container.type.size() == EXTENDED_TYPE ? EXTENDED_TYPE : 0);
+        if (container.headerSize != minimal && container.headerSize != minimal + LARGE_SIZE_SZ) {
+            return false;
+        }
+        if (container.offset < from || container.offset + container.headerSize > container.childrenOffset
+            || container.childrenOffset > offset) {
+            return false;
+        }
+        auto childrenEnd = container.childrenOffset + container.childrenSize;
+        if (container.childrenSize && offset > childrenEnd) {
+            return false;
+        }
+        return !end || (container.childrenSize && childrenEnd <= end);
+    }
+}
+
+QByteArray Checkpoint::Container::header() const
+{
+    bool       extended  = type.size() == EXTENDED_TYPE;
+    bool       largeSize = headerSize == MINIMAL_HEADER + LARGE_SIZE_SZ + (extended ? EXTENDED_TYPE : 0);
+    QByteArray header(int(headerSize), '\0');
+    qToBigEndian<quint32>(largeSize ? 1 : quint32(size), header.data());
+    header.replace(4, 4, extended ? QByteArray("uuid") : type);
+    if (largeSize) {
+        qToBigEndian<quint64>(size, header.data() + MINIMAL_HEADER);
+    }
+    if (extended) {
+        header.replace(int(headerSize) - EXTENDED_TYPE, EXTENDED_TYPE, type);
+    }
+    return header;
+}
+
+QByteArray Checkpoint::toByteArray() const
+{
+    QByteArray  data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << MAGIC << VERSION << quint64(offset) << quint64(boxCount) << quint32(containers.size());
+    for (auto const &container : containers) {
+        stream << container.type << quint64(container.size) << quint64(container.offset)
+               << quint32(container.headerSize) << quint64(container.childrenOffset)
+               << quint64(container.childrenSize);
+    }
+    return data;
+}
+
+std::optional<Checkpoint> Checkpoint::fromByteArray(const QByteArray &data)
+{
+    QDataStream stream(data);
+    quint32     magic   = 0;
+    quint8      version = 0;
+    quint64     offset, boxCount;
+    quint32     count;
+    stream >> magic >> version >> offset >> boxCount >> count;
+    if (stream.status() != QDataStream::Ok || magic != MAGIC || version != VERSION) {
+        return std::nullopt;
+    }
+    Checkpoint    checkpoint;
+    std::uint64_t from = 0, end = 0; // children of the last container
+    checkpoint.offset   = offset;
+    checkpoint.boxCount = boxCount;
+    for (quint32 i = 0; i < count; i++) {
+        Container container;
+        quint64   size, containerOffset, childrenOffset, childrenSize;
+        quint32   headerSize;
+        stream >> container.type >> size >> containerOffset >> headerSize >> childrenOffset >> childrenSize;
+        if (stream.status() != QDataStream::Ok) {
+            return std::nullopt; // a count beyond the data ends here too
+        }
+        container.size           = size;
+        container.offset         = containerOffset;
+        container.headerSize     = headerSize;
+        container.childrenOffset = childrenOffset;
+        container.childrenSize   = childrenSize;
+        if (!isConsistent(container, from, end, offset)) {
+            return std::nullopt;
+        }
+        from = container.childrenOffset;
+        end  = container.childrenSize ? container.childrenOffset + container.childrenSize : end;
+        checkpoint.containers.push_back(std::move(container));
+    }
+    if (!stream.atEnd()) {
+        return std::nullopt;
+    }
+    return checkpoint;
+}
+
+} // namespace unboxer
@@ -0,0 +1,69 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "unboxer_export.h"
+
+#include <QByteArray>
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace unboxer {
+
+/**
+ * @brief Parser state at a box boundary. Enough to resume the parse there instead of starting from the beginning.
+ *
+ * Taken with Unboxer::checkpoint() and passed to Unboxer::resumeFrom() of a new unboxer reading the same resource.
+ * The containers which were open at the boundary are opened again for the consumer and then parsing goes on at
+ * offset. Those which were being closed at the time are closed right away. Data delivered before the checkpoint,
+ * including preambles of the open containers, isn't delivered again.
+ */
+struct UNBOXER_EXPORT Checkpoint {
+    // an open container
+    struct Container {
+        QByteArray    type;           // 4 bytes, or 16 bytes of extended type for uuid
+        std::uint64_t size;           // 0 - till the end of the parent
+        std::uint64_t offset;         // of the header
+        std::uint32_t headerSize;     // with optional largesize and extended type
+        std::uint64_t childrenOffset; // after the preamble
+        std::uint64_t childrenSize;   // 0 - till the end
+
+        // the header as it was in the stream
+        QByteArray header() const;
+    };
+
+    std::uint64_t          offset   = 0; // of the next box header
+    std::uint64_t          boxCount = 0; // boxes opened before. counts against ParseBudget::maxBoxes
+    std::vector<Container> containers;   // outermost first
+
+    // compact binary form to be saved somewhere
+    QByteArray toByteArray() const;
+    // nullopt if the data is not a checkpoint or is damaged
+    static std::optional<Checkpoint> fromByteArray(const QByteArray &data);
+};
+
+} // namespace unboxer
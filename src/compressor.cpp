@@ -0,0 +1,164 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "compressor.h"
+
+#include <QDebug>
+#include <QtEndian>
+
+namespace unboxer {
+
+CompressedFile::CompressedFile(std::unique_ptr<QFile> file, std::shared_ptr<const Codec> codec) :
+    file(std::move(file)), codec(std::move(codec))
+{
+}
+
+void CompressedFile::write(const QByteArray &block)
+{
+    if (failed || block.isEmpty()) {
+        return;
+    }
+    if (mode == PassThrough) {
+        writeBytes(block);
+        return;
+    }
+    auto compressed = codec->compress(block);
+    if (mode == Sniffing) {
+        mode = compressed.size() < block.size() * INCOMPRESSIBLE_RATIO ? Compressing : PassThrough;
+        if (mode == PassThrough) {
+            writeBytes(block);
+            return;
+        }
+    }
+    writeFrame(compressed);
+}
+
+QString CompressedFile::finish()
+{
+    file->close();
+    if (failed) {
+        file->remove();
+        return QString();
+    }
+    if (mode == Compressing) {
+        auto name = file->fileName() + codec->suffix();
+        QFile::remove(name); // left from a previous run
+        if (!file->rename(name)) {
+            qWarning() << "Failed to rename " << file->fileName() << " to " << name;
+        }
+    }
+    return file->fileName();
+}
+
+std::optional<QByteArray> CompressedFile::decode(const QByteArray &data, const Codec &codec)
+{
+    QByteArray result;
+    for (int offset = 0; offset < data.size();) {
+        if (data.size() - offset < 4) {
+            return std::nullopt;
+        }
+        auto size = qFromBigEndian<quint32>(data.constData() + offset);
+        offset += 4;
+        if (size == 0 || size > quint32(data.size() - offset)) {
+            return std::nullopt;
+        }
+        auto block = codec.decompress(data.mid(offset, int(size)));
+        if (block.isEmpty()) {
+            return std::nullopt;
+        }
+        result += block;
+        offset += int(size);
+    }
+    return result;
+}
+
+void CompressedFile::writeBytes(const QByteArray &data)
+{
+    if (file->write(data) != data.size()) {
+        qWarning() << "Failed to write to " << file->fileName();
+        failed = true;
+    }
+}
+
+void CompressedFile::writeFrame(const QByteArray &compressed)
+{
+    char header[4];
+    qToBigEndian<quint32>(quint32(compressed.size()), header);
+    writeBytes(QByteArray::fromRawData(header, sizeof(header)));
+    writeBytes(compressed);
+}
+
+CompressionWorker::CompressionWorker(qint64 maxPendingBytes) :
+    maxPendingBytes(maxPendingBytes), thread([this]() { run(); })
+{
+}
+
+CompressionWorker::~CompressionWorker()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobAdded.notify_one();
+    thread.join();
+}
+
+void CompressionWorker::post(std::function<void()> &&job, qint64 bytes)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    // an oversized job still goes when nothing else waits
+    jobDone.wait(lock, [&]() { return pendingBytes == 0 || pendingBytes + bytes <= maxPendingBytes; });
+    jobs.push_back({ std::move(job), bytes });
+    pendingBytes += bytes;
+    lock.unlock();
+    jobAdded.notify_one();
+}
+
+void CompressionWorker::waitForDone()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    jobDone.wait(lock, [&]() { return jobs.empty() && !busy; });
+}
+
+void CompressionWorker::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        jobAdded.wait(lock, [&]() { return stopping || !jobs.empty(); });
+        if (jobs.empty()) {
+            return; // stopping and everything is done
+        }
+        auto job = std::move(jobs.front());
+        jobs.pop_front();
+        busy = true;
+        lock.unlock();
+        job.run();
+        lock.lock();
+        busy = false;
+        pendingBytes -= job.bytes;
+        jobDone.notify_all();
+    }
+}
+
+} // namespace unboxer
@@ -0,0 +1,135 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "unboxer_export.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+namespace unboxer {
+
+/**
+ * @brief Block compression algorithm for extracted payloads. See BlobExtractor::setCompression().
+ */
+class UNBOXER_EXPORT Codec {
+public:
+    virtual ~Codec() = default;
+
+    virtual QString    suffix() const                             = 0; // of compressed files, e.g. ".zz"
+    virtual QByteArray compress(const QByteArray &block) const   = 0;
+    virtual QByteArray decompress(const QByteArray &block) const = 0; // empty on error
+};
+
+// zlib from Qt. blocks are in qCompress() format
+class UNBOXER_EXPORT ZlibCodec : public Codec {
+public:
+    explicit ZlibCodec(int level = -1) : level(level) { }
+
+    QString    suffix() const override { return QStringLiteral(".zz"); }
+    QByteArray compress(const QByteArray &block) const override { return qCompress(block, level); }
+    QByteArray decompress(const QByteArray &block) const override { return qUncompress(block); }
+
+private:
+    int level;
+};
+
+/**
+ * @brief Writes a payload block by block, compressed if it's worth it.
+ *
+ * The first block decides: if it doesn't get smaller than INCOMPRESSIBLE_RATIO of its size, e.g. it's media data,
+ * the file is written as is. Otherwise every block is stored as 32-bit big endian size followed by the compressed data
+ * and the file gets the codec's suffix. Not thread safe; used by one job at a time of CompressionWorker.
+ */
+class UNBOXER_EXPORT CompressedFile {
+public:
+    static constexpr double INCOMPRESSIBLE_RATIO = 0.9;
+
+    CompressedFile(std::unique_ptr<QFile> file, std::shared_ptr<const Codec> codec);
+
+    void    write(const QByteArray &block);
+    QString finish(); // the final file name. empty if it failed
+    bool    isCompressed() const { return mode == Compressing; }
+
+    // content of a compressed file. nullopt if it's damaged
+    static std::optional<QByteArray> decode(const QByteArray &data, const Codec &codec);
+
+private:
+    enum Mode { Sniffing, Compressing, PassThrough };
+
+    void writeBytes(const QByteArray &data);
+    void writeFrame(const QByteArray &compressed);
+
+    std::unique_ptr<QFile>       file;
+    std::shared_ptr<const Codec> codec;
+    Mode                         mode   = Sniffing;
+    bool                         failed = false;
+};
+
+/**
+ * @brief Thread running jobs in order, so the parsing thread only hands over the data.
+ *
+ * post() blocks while more than maxPendingBytes of posted data waits, which bounds memory if the disk or the codec is
+ * slower than the parser.
+ */
+class UNBOXER_EXPORT CompressionWorker {
+public:
+    static constexpr qint64 DEFAULT_MAX_PENDING_BYTES = 16 * 1024 * 1024;
+
+    explicit CompressionWorker(qint64 maxPendingBytes = DEFAULT_MAX_PENDING_BYTES);
+    ~CompressionWorker(); // runs all the posted jobs first
+
+    void post(std::function<void()> &&job, qint64 bytes = 0);
+    void waitForDone();
+
+private:
+    struct Job {
+        std::function<void()> run;
+        qint64                bytes;
+    };
+
+    void run();
+
+    qint64                  maxPendingBytes;
+    std::mutex              mutex;
+    std::condition_variable jobAdded;
+    std::condition_variable jobDone;
+    std::deque<Job>         jobs;
+    qint64                  pendingBytes = 0;
+    bool                    busy         = false;
+    bool                    stopping     = false;
+    std::thread             thread;
+};
+
+} // namespace unboxer
@@ -0,0 +1,107 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "containerregistry.h"
+
+#include <QtEndian>
+
+namespace unboxer {
+
+static std::uint32_t fourCC(const QByteArray &type) { return qFromBigEndian<quint32>(type.constData()); }
+
+ContainerRegistry::ContainerRegistry(const std::vector<QByteArray> &types)
+{
+    for (auto const &type : types) {
+        add(type);
+    }
+}
+
+const ContainerRegistry &ContainerRegistry::isoBmff()
+{
+    static const ContainerRegistry registry = []() {
+        constexpr std::uint32_t FULL_BOX     = 4;                 // version + flags
+        constexpr std::uint32_t SAMPLE_ENTRY = 8;                 // reserved + data_reference_index
+        constexpr std::uint32_t VISUAL_ENTRY = SAMPLE_ENTRY + 70; // up to depth and pre_defined
+        constexpr std::uint32_t AUDIO_ENTRY  = SAMPLE_ENTRY + 20; // up to samplerate
+
+        ContainerRegistry r;
+        for (auto type : { "moov", "trak", "edts", "mdia", "minf", "dinf", "stbl", "mvex", "moof", "traf", "mfra",
+                           "udta", "tref", "trgr", "sinf", "schi", "rinf", "strk", "strd", "meco", "grpl", "iprp",
+                           "ipco", "ilst", "gmhd" }) {
+            r.add(type);
+        }
+        r.add("meta", FULL_BOX);
+        r.add("iref", FULL_BOX);
+        r.add("ipro", FULL_BOX + 2); // protection_count
+        r.add("fiin", FULL_BOX + 2); // entry_count
+        r.add("dref", FULL_BOX + 4); // entry_count
+        r.add("stsd", FULL_BOX + 4); // entry_count
+        r.add("trep", FULL_BOX + 4); // track_ID
+        for (auto type : { "avc1", "avc2", "avc3", "avc4", "hvc1", "hev1", "hvc2", "hev2", "vvc1", "vvi1", "dvh1",
+                           "dvhe", "dva1", "dvav", "av01", "vp08", "vp09", "mp4v", "s263", "encv" }) {
+            r.add(type, VISUAL_ENTRY);
+        }
+        for (auto type : { "mp4a", "ac-3", "ec-3", "ac-4", "Opus", "fLaC", "alac", "mha1", "mhm1", "dtsc", "dtsh",
+                           "dtsl", "dtse", "samr", "sawb", "enca" }) {
+            r.add(type, AUDIO_ENTRY);
+        }
+        r.add("wvtt", SAMPLE_ENTRY);
+        r.add("tx3g", SAMPLE_ENTRY + 30); // display flags, justification, background, default text box and style
+        return r;
+    }();
+    return registry;
+}
+
+void ContainerRegistry::add(const QByteArray &type, std::uint32_t preambleSize)
+{
+    if (type.size() == 4) {
+        containers.insert(fourCC(type), preambleSize);
+    } else {
+        extended.insert(type, preambleSize);
+    }
+}
+
+void ContainerRegistry::remove(const QByteArray &type)
+{
+    if (type.size() == 4) {
+        containers.remove(fourCC(type));
+    } else {
+        extended.remove(type);
+    }
+}
+
+std::optional<std::uint32_t> ContainerRegistry::preambleSize(const QByteArray &type) const
+{
+    if (type.size() != 4) {
+        auto it = extended.constFind(type);
+        return it == extended.constEnd() ? std::nullopt : std::optional<std::uint32_t>(*it);
+    }
+    auto it = containers.constFind(fourCC(type));
+    if (it == containers.constEnd()) {
+        return std::nullopt;
+    }
+    return *it;
+}
+
+}
@@ -0,0 +1,70 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "unboxer_export.h"
+
+#include <QByteArray>
+#include <QHash>
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace unboxer {
+
+/**
+ * @brief Box types which payload is parsed as sub-boxes.
+ *
+ * Some containers start with fixed fields before their sub-boxes, like version and flags of FullBox `meta` or
+ * the sample entry fields of `avc1`. Size of such preamble is stored along with the type, so the preamble is delivered
+ * as the container's data and the rest is parsed as sub-boxes.
+ * Four character types are looked up as 32-bit numbers, any other type, e.g. the 16-byte extended type of a `uuid`
+ * box, as it is.
+ */
+class UNBOXER_EXPORT ContainerRegistry {
+public:
+    ContainerRegistry() = default;
+    // plain containers without preamble
+    explicit ContainerRegistry(const std::vector<QByteArray> &types);
+
+    // containers of ISO/IEC 14496-12 and the common codec sample entries. QuickTime v1/v2 sound sample entries
+    // have bigger preamble than ISO ones, override if such files are expected. Apple's `meta` without FullBox header
+    // is told apart by Unboxer itself.
+    static const ContainerRegistry &isoBmff();
+
+    void add(const QByteArray &type, std::uint32_t preambleSize = 0);
+    void remove(const QByteArray &type);
+
+    // nullopt if the type isn't a container
+    std::optional<std::uint32_t> preambleSize(const QByteArray &type) const;
+    bool                         contains(const QByteArray &type) const { return preambleSize(type).has_value(); }
+
+private:
+    QHash<std::uint32_t, std::uint32_t> containers; // fourcc -> preamble size
+    QHash<QByteArray, std::uint32_t>    extended;   // not four character types -> preamble size
+};
+
+}
@@ -0,0 +1,288 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#if !defined(__cpp_impl_coroutine)
+#error "coro.h needs C++20 coroutines. Configure the library with -DENABLE_COROUTINES=ON"
+#endif
+
+#include "slice.h"
+#include "unboxer.h"
+
+#include <QObject>
+
+#include <coroutine>
+#include <optional>
+#include <vector>
+
+namespace unboxer {
+
+struct BoxEvent {
+    enum Type : std::uint8_t { StreamOpened, BoxOpened, BoxSelected, Data, BoxClosed, StreamClosed };
+
+    Type     type = StreamOpened;
+    Box::Ptr box;                 // the root box for stream events. null if the stream was never opened
+    Slice    data;                // Data only
+    Status   status = Status::Ok; // StreamClosed only
+};
+
+/**
+ * @brief Coroutine interface to Unboxer.
+ *
+ * Instead of callbacks the parse is pulled by awaiting next(), nextBox() or readData(). The source is read right in
+ * the awaiting coroutine until an event is there. If the source has no data yet (e.g. it's a network one), the
+ * coroutine is suspended and resumed from the source's data ready notification. Neither suspension nor events
+ * allocate memory on their own, so thousands of parses can be interleaved on a few threads with event loops.
+ *
+ * Event payload is a Slice which stays valid as long as it's kept. Boxes are recursed into or skipped according to
+ * containers() and setSelection(), since decisions have to be made before the consumer sees the box. Callbacks of
+ * the boxes must not be changed. The stream must not be destroyed by a resumed coroutine before it gets the end of
+ * the stream.
+ *
+ * @code
+ * BoxEventStream<InputFileImpl, NullCache> stream(path);
+ * while (auto box = co_await stream.nextBox()) {
+ *     if (box->type == "mdat") {
+ *         while (auto data = co_await stream.readData(box)) { ... }
+ *     }
+ * }
+ * @endcode
+ */
+template <class Source, class Cache> class BoxEventStream {
+    enum class Want { Any, Box, Data };
+
+    class AwaiterBase {
+    public:
+        AwaiterBase(BoxEventStream &stream, Want want, Box::Ptr target = {}) :
+            stream(stream), want(want), target(std::move(target))
+        {
+        }
+        bool await_ready() { return stream.prepare(want, target); }
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            stream.waiter       = handle;
+            stream.waiterWant   = want;
+            stream.waiterTarget = target;
+        }
+
+    protected:
+        BoxEventStream &stream;
+        Want            want;
+        Box::Ptr        target;
+    };
+
+public:
+    static constexpr std::size_t DEFAULT_READ_SIZE = 64 * 1024;
+
+    // the next event of any type. nullopt after StreamClosed
+    class EventAwaiter : public AwaiterBase {
+    public:
+        using AwaiterBase::AwaiterBase;
+        std::optional<BoxEvent> await_resume() { return this->stream.take(true); }
+    };
+
+    // the next opened box. null at the end of the stream
+    class BoxAwaiter : public AwaiterBase {
+    public:
+        using AwaiterBase::AwaiterBase;
+        Box::Ptr await_resume()
+        {
+            auto event = this->stream.take(false);
+            return event ? event->box : Box::Ptr {};
+        }
+    };
+
+    // the next piece of the box's payload. nullopt when the box (or the stream) is closed
+    class DataAwaiter : public AwaiterBase {
+    public:
+        using AwaiterBase::AwaiterBase;
+        std::optional<Slice> await_resume()
+        {
+            auto event = this->stream.take(false);
+            if (event && event->type == BoxEvent::Data) {
+                return std::move(event->data);
+            }
+            return std::nullopt;
+        }
+    };
+
+    // source is what Source is made of, see Unboxer
+    template <class SourceArg>
+    BoxEventStream(SourceArg        &&source,
+                   ContainerRegistry  containers = ContainerRegistry::isoBmff(),
+                   std::size_t        readSize   = DEFAULT_READ_SIZE) :
+        unboxer(std::forward<SourceArg>(source), std::move(containers)),
+        readSize(readSize)
+    {
+        unboxer.setStreamOpenedCallback([this](Box::Ptr root) {
+            this->root         = root;
+            root->onSubBoxOpen = [this](Box::Ptr box) { forwardBox(box); };
+            pending.push_back({ BoxEvent::StreamOpened, root });
+            readable = true;
+            wake();
+        });
+        unboxer.setStreamClosedCallback([this](Status reason) {
+            closed  = true;
+            status_ = reason;
+            pending.push_back({ BoxEvent::StreamClosed, root, Slice(), reason });
+            if (waiter && !pumping) {
+                // the source is still on the stack and the resumed coroutine could destroy it
+                QMetaObject::invokeMethod(&context, [this]() { wake(); }, Qt::QueuedConnection);
+            }
+        });
+        unboxer.stream().setDataReadyCallback([this]() {
+            readable = true;
+            wake();
+        });
+    }
+
+    BoxEventStream(const BoxEventStream &)            = delete;
+    BoxEventStream &operator=(const BoxEventStream &) = delete;
+
+    // has to be set before the first await
+    bool setSelection(const std::vector<QByteArray> &patterns)
+    {
+        return unboxer.setSelection(patterns,
+                                    [this](Box::Ptr box) { pending.push_back({ BoxEvent::BoxSelected, box }); });
+    }
+    void               setBudget(const ParseBudget &budget) { unboxer.setBudget(budget); }
+    ContainerRegistry &containers() { return unboxer.containers(); }
+
+    EventAwaiter next() { return { *this, Want::Any }; }
+    BoxAwaiter   nextBox() { return { *this, Want::Box }; }
+    // events of other boxes are dropped until this one is closed
+    DataAwaiter readData(Box::Ptr box) { return { *this, Want::Data, std::move(box) }; }
+
+    bool       isClosed() const { return closed; }
+    Status     status() const { return status_; } // close reason. valid when isClosed()
+    ParseStats stats() const { return unboxer.stats(); }
+
+private:
+    void forwardBox(Box::Ptr box)
+    {
+        pending.push_back({ BoxEvent::BoxOpened, box });
+        box->onSubBoxOpen = [this](Box::Ptr subBox) { forwardBox(subBox); };
+        // weak, so the box doesn't own itself through its callbacks
+        box->onDataRead = [this, weakBox = std::weak_ptr<Box>(box)](const QByteArray &data) {
+            auto const &reader = unboxer.impl->reader;
+            auto        slice  = slicer.slice(reader.buffer(), reader.bufferGeneration(), data);
+            pending.push_back({ BoxEvent::Data, weakBox.lock(), std::move(slice) });
+            return Status::Ok;
+        };
+        box->onClose = [this, weakBox = std::weak_ptr<Box>(box)]() {
+            pending.push_back({ BoxEvent::BoxClosed, weakBox.lock() });
+            return Status::Ok;
+        };
+    }
+
+    static bool matches(const BoxEvent &event, Want want, const Box::Ptr &target)
+    {
+        switch (want) {
+        case Want::Any:
+            return true;
+        case Want::Box:
+            return event.type == BoxEvent::BoxOpened || event.type == BoxEvent::StreamClosed;
+        case Want::Data:
+            return event.type == BoxEvent::StreamClosed
+                || (event.box == target && (event.type == BoxEvent::Data || event.type == BoxEvent::BoxClosed));
+        }
+        return false;
+    }
+
+    // reads the source till an event matches. false if the source has to be waited for
+    bool prepare(Want want, const Box::Ptr &target)
+    {
+        pumping    = true;
+        bool ready = false;
+        while (true) {
+            while (head < pending.size() && !matches(pending[head], want, target)) {
+                popFront();
+            }
+            if (head < pending.size() || closed) {
+                ready = true;
+                break;
+            }
+            if (!opened) {
+                opened = true;
+                unboxer.open();
+            } else if (readable) {
+                readable = false; // until the next data ready notification
+                unboxer.read(readSize);
+            } else {
+                break;
+            }
+        }
+        pumping = false;
+        return ready;
+    }
+
+    std::optional<BoxEvent> take(bool takeStreamClosed)
+    {
+        if (head == pending.size() || (!takeStreamClosed && pending[head].type == BoxEvent::StreamClosed)) {
+            return std::nullopt;
+        }
+        return popFront();
+    }
+
+    BoxEvent popFront()
+    {
+        auto event = std::move(pending[head]);
+        if (++head == pending.size()) {
+            pending.clear(); // keeps the capacity
+            head = 0;
+        }
+        return event;
+    }
+
+    void wake()
+    {
+        if (!waiter || pumping || !prepare(waiterWant, waiterTarget)) {
+            return;
+        }
+        waiterTarget.reset();
+        std::exchange(waiter, {}).resume();
+    }
+
+private:
+    Unboxer<Source, Cache> unboxer;
+    std::size_t            readSize;
+    BufferSlicer           slicer;
+    Box::Ptr               root;
+    std::vector<BoxEvent>  pending;
+    std::size_t            head = 0; // first not taken event in pending
+
+    bool   opened   = false;
+    bool   readable = false; // the source has data to read
+    bool   closed   = false;
+    bool   pumping  = false; // the source is being read. its notifications are handled by prepare()
+    Status status_  = Status::Ok;
+
+    std::coroutine_handle<> waiter;
+    Want                    waiterWant = Want::Any;
+    Box::Ptr                waiterTarget;
+    QObject                 context; // to resume after the source is closed
+};
+
+}
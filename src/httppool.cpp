@@ -0,0 +1,122 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "httppool.h"
+
+#include <QThreadStorage>
+#include <QUrl>
+
+namespace unboxer {
+
+namespace {
+    QString hostKey(const QUrl &url)
+    {
+        return url.host() + ':' + QString::number(url.port(url.scheme() == "https" ? 443 : 80));
+    }
+}
+
+HttpPool &HttpPool::forThread()
+{
+    static QThreadStorage<HttpPool *> pools;
+    if (!pools.hasLocalData()) {
+        pools.setLocalData(new HttpPool);
+    }
+    return *pools.localData();
+}
+
+void HttpPool::setMaxConnectionsPerHost(int limit)
+{
+    maxPerHost = qMax(1, limit);
+    // a higher limit could let some of the queued requests go
+    for (auto const &host : queued.keys()) {
+        startQueued(host);
+    }
+}
+
+int HttpPool::queuedRequests(const QString &host) const
+{
+    auto it = queued.constFind(host);
+    return it == queued.constEnd() ? 0 : int(it->size());
+}
+
+void HttpPool::get(QNetworkRequest request, QObject *context, StartedCallback &&callback)
+{
+    // Qt acknowledges HTTP/2 data as it arrives rather than as it's read, so the flow control window doesn't hold a
+    // stream back and only HTTP/1.1 keeps to the read buffer. A caller may turn HTTP/2 off for its request only
+    auto allowed = request.attribute(QNetworkRequest::Http2AllowedAttribute, true).toBool();
+    request.setAttribute(QNetworkRequest::Http2AllowedAttribute, http2Allowed && readBuffer == 0 && allowed);
+    Pending pending { std::move(request), context, std::move(callback) };
+    auto    host = hostKey(pending.request.url());
+    if (active.value(host).size() < maxPerHost) {
+        start(std::move(pending));
+    } else {
+        queued[host].push_back(std::move(pending));
+    }
+}
+
+void HttpPool::start(Pending &&pending)
+{
+    if (!pending.context) {
+        return; // the source was deleted while waiting
+    }
+    auto host  = hostKey(pending.request.url());
+    auto reply = nam.get(pending.request);
+    reply->setReadBufferSize(readBuffer);
+    active[host].insert(reply);
+    // an aborted source deletes the reply without waiting for finished()
+    connect(reply, &QNetworkReply::finished, this, [this, host, reply]() { release(host, reply); });
+    connect(reply, &QObject::destroyed, this, [this, host, reply]() { release(host, reply); });
+    pending.callback(reply);
+}
+
+void HttpPool::release(const QString &host, QNetworkReply *reply)
+{
+    auto it = active.find(host);
+    if (it == active.end() || !it->remove(reply)) {
+        return;
+    }
+    if (it->isEmpty()) {
+        active.erase(it);
+    }
+    startQueued(host);
+}
+
+void HttpPool::startQueued(const QString &host)
+{
+    // looked up every time since callbacks of started requests may queue more
+    while (active.value(host).size() < maxPerHost) {
+        auto it = queued.find(host);
+        if (it == queued.end()) {
+            return;
+        }
+        auto pending = std::move(it->front());
+        it->pop_front();
+        if (it->empty()) {
+            queued.erase(it);
+        }
+        start(std::move(pending));
+    }
+}
+
+} // namespace unboxer
@@ -0,0 +1,101 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "unboxer_export.h"
+
+#include <QHash>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QPointer>
+#include <QSet>
+
+#include <deque>
+#include <functional>
+
+namespace unboxer {
+
+/**
+ * @brief Network access shared by all HTTP sources of a thread.
+ *
+ * QNetworkAccessManager keeps connections alive and multiplexes HTTP/2 streams only for requests made through the same
+ * manager, and a manager can be used only on its own thread. So every thread gets one pool, see forThread().
+ *
+ * Requests to one host beyond maxConnectionsPerHost() wait in the pool until others finish. Without HTTP/2 Qt opens
+ * up to 6 connections per host, so the limit is effective when it's lower than that. With HTTP/2 the requests are
+ * multiplexed over a single connection and the limit bounds the number of concurrent streams.
+ */
+class UNBOXER_EXPORT HttpPool : public QObject {
+    Q_OBJECT
+public:
+    using StartedCallback = std::function<void(QNetworkReply *)>;
+
+    static constexpr int    DEFAULT_MAX_CONNECTIONS_PER_HOST = 6;
+    static constexpr qint64 DEFAULT_READ_BUFFER_SIZE         = 1024 * 1024;
+
+    // the pool of the calling thread. created on first use and deleted when the thread finishes
+    static HttpPool &forThread();
+
+    int  maxConnectionsPerHost() const { return maxPerHost; }
+    void setMaxConnectionsPerHost(int limit);
+    bool isHttp2Allowed() const { return http2Allowed; }
+    void setHttp2Allowed(bool allowed) { http2Allowed = allowed; }
+    // Bytes a reply may receive ahead of the consumer. When they aren't read Qt stops reading the socket and TCP flow
+    // control slows the sender down, so memory per stream stays bounded however fast the network is. 0 - unlimited.
+    // Applies to requests started afterwards. Qt's HTTP/2 doesn't hold back a stream which isn't read, so requests
+    // go over HTTP/1.1 while the size is finite, see setHttp2Allowed().
+    qint64 readBufferSize() const { return readBuffer; }
+    void   setReadBufferSize(qint64 size) { readBuffer = qMax<qint64>(0, size); }
+
+    // Issues the request when the host has a free slot. The callback gets the reply, owned by the caller from then.
+    // Nothing is called if context is deleted before that.
+    void get(QNetworkRequest request, QObject *context, StartedCallback &&callback);
+
+    QNetworkAccessManager &manager() { return nam; }
+    int                    activeRequests(const QString &host) const { return active.value(host).size(); }
+    int                    queuedRequests(const QString &host) const;
+
+private:
+    struct Pending {
+        QNetworkRequest   request;
+        QPointer<QObject> context;
+        StartedCallback   callback;
+    };
+
+    HttpPool() = default;
+    void start(Pending &&pending);
+    void release(const QString &host, QNetworkReply *reply);
+    void startQueued(const QString &host);
+
+    QNetworkAccessManager                 nam;
+    int                                   maxPerHost   = DEFAULT_MAX_CONNECTIONS_PER_HOST;
+    bool                                  http2Allowed = true;
+    qint64                                readBuffer   = DEFAULT_READ_BUFFER_SIZE;
+    QHash<QString, QSet<QNetworkReply *>> active; // by host:port
+    QHash<QString, std::deque<Pending>>   queued;
+};
+
+} // namespace unboxer
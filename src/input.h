@@ -24,10 +24,16 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #pragma once
 
+#include <cstdint>
 #include <memory>
+#include <type_traits>
 
 namespace unboxer {
 
+template <class Impl, class = void> struct HasSkip : std::false_type { };
+template <class Impl>
+struct HasSkip<Impl, std::void_t<decltype(std::declval<Impl>().skip(std::uint64_t()))>> : std::true_type { };
+
 template <class Impl> class Input {
 public:
     template <class... Args> Input(Args &&...args) : impl(std::make_unique<Impl>(std::forward<Args>(args)...)) { }
@@ -36,6 +42,17 @@ public:
     void        read(std::size_t size) { impl->read(size); }
     void        reset() { impl->reset(); }
     std::size_t bytesAvailable() const { return impl->bytesAvailable(); }
+    Impl       &get() { return *impl; }
+
+    // skip bytes right after the last read data. not every source can do this
+    bool skip(std::uint64_t size)
+    {
+        if constexpr (HasSkip<Impl>::value) {
+            return impl->skip(size);
+        } else {
+            return false;
+        }
+    }
 
 private:
     std::unique_ptr<Impl> impl;
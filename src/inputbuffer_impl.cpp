@@ -0,0 +1,104 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "inputbuffer_impl.h"
+
+#include <limits>
+
+namespace unboxer {
+
+MemoryBuffer &MemoryBuffer::append(const QByteArray &part)
+{
+    if (!part.isEmpty()) {
+        parts.push_back({ part.constData(), std::size_t(part.size()), part, {} });
+        size_ += part.size();
+    }
+    return *this;
+}
+
+MemoryBuffer &MemoryBuffer::append(const char *data, std::size_t size, Owner owner)
+{
+    if (size) {
+        parts.push_back({ data, size, {}, std::move(owner) });
+        size_ += size;
+    }
+    return *this;
+}
+
+void InputBufferImpl::read(std::size_t size)
+{
+    if (!available) {
+        closedCallback(Status::Eof);
+        return;
+    }
+    auto const &current   = buffer.parts[part];
+    auto        chunkSize = qMin(qMin(size, current.size - partOffset), std::size_t(std::numeric_limits<int>::max()));
+    // a whole array is shared, so a consumer keeping it (e.g. ThreadedUnboxer) doesn't have to copy it
+    auto chunk = chunkSize == std::size_t(current.array.size())
+        ? current.array
+        : QByteArray::fromRawData(current.data + partOffset, int(chunkSize));
+    partOffset += chunkSize;
+    available -= chunkSize;
+    if (partOffset == current.size) {
+        part++;
+        partOffset = 0;
+    }
+    dataReadCallback(chunk);
+    if (buffer.isEmpty()) {
+        return; // the source was reset by the callback
+    }
+    if (!available) {
+        closedCallback(Status::Eof);
+    } else {
+        dataReadyCallback();
+    }
+}
+
+void InputBufferImpl::reset()
+{
+    buffer     = MemoryBuffer();
+    part       = 0;
+    partOffset = 0;
+    available  = 0;
+}
+
+bool InputBufferImpl::skip(std::uint64_t size)
+{
+    if (size > available) {
+        return false;
+    }
+    available -= size;
+    while (size) {
+        auto step = qMin<std::uint64_t>(size, buffer.parts[part].size - partOffset);
+        partOffset += step;
+        size -= step;
+        if (partOffset == buffer.parts[part].size) {
+            part++;
+            partOffset = 0;
+        }
+    }
+    return true;
+}
+
+} // namespace unboxer
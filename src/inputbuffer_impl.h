@@ -0,0 +1,116 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "status.h"
+#include "unboxer_export.h"
+
+#include <QByteArray>
+#include <QList>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace unboxer {
+
+/**
+ * @brief Bytes already in memory, possibly scattered over several buffers. Nothing is copied.
+ *
+ * A part is either a QByteArray, shared as usual, or external memory kept alive by an owner, e.g. a shared_ptr to
+ * the packager's segment. Copies of a MemoryBuffer share the same memory.
+ */
+class UNBOXER_EXPORT MemoryBuffer {
+public:
+    using Owner = std::shared_ptr<const void>;
+
+    MemoryBuffer() = default;
+    MemoryBuffer(const QByteArray &data) { append(data); }
+    MemoryBuffer(const QList<QByteArray> &parts)
+    {
+        for (auto const &part : parts) {
+            append(part);
+        }
+    }
+    // owner is released when the last copy of the buffer is gone. the memory has to stay unchanged till then
+    MemoryBuffer(const char *data, std::size_t size, Owner owner) { append(data, size, std::move(owner)); }
+
+    MemoryBuffer &append(const QByteArray &part);
+    MemoryBuffer &append(const char *data, std::size_t size, Owner owner);
+
+    std::size_t size() const { return size_; }
+    bool        isEmpty() const { return !size_; }
+
+private:
+    friend class InputBufferImpl;
+
+    struct Part {
+        const char *data;
+        std::size_t size;
+        QByteArray  array; // if the part is an array
+        Owner       owner; // otherwise
+    };
+
+    std::vector<Part> parts;
+    std::size_t       size_ = 0;
+};
+
+/**
+ * @brief Source reading a MemoryBuffer.
+ *
+ * Unlike InputMemoryImpl nothing is decoded or copied: the parser gets raw slices of the parts, or a whole QByteArray
+ * part when it fits into the read size. A read never spans two parts.
+ */
+class UNBOXER_EXPORT InputBufferImpl {
+    std::function<void()>                   openedCallback;
+    std::function<void()>                   dataReadyCallback;
+    std::function<void(const QByteArray &)> dataReadCallback;
+    std::function<void(Status)>             closedCallback;
+
+    MemoryBuffer buffer;
+    std::size_t  part       = 0; // being read
+    std::size_t  partOffset = 0;
+    std::size_t  available  = 0;
+
+public:
+    template <typename OpenedCB, typename DataReadyCB, typename DataReadCB, typename ClosedCB>
+    InputBufferImpl(MemoryBuffer  buffer,
+                    OpenedCB    &&openedCallback,
+                    DataReadyCB &&dataReadyCallback,
+                    DataReadCB  &&dataReadCallback,
+                    ClosedCB    &&closedCallback) :
+        openedCallback(std::move(openedCallback)),
+        dataReadyCallback(std::move(dataReadyCallback)), dataReadCallback(std::move(dataReadCallback)),
+        closedCallback(std::move(closedCallback)), buffer(std::move(buffer)), available(this->buffer.size())
+    {
+    }
+    void        open() { openedCallback(); }
+    void        read(std::size_t size);
+    void        reset();
+    bool        skip(std::uint64_t size);
+    std::size_t bytesAvailable() const { return available; }
+};
+
+} // namespace unboxer
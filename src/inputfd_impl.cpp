@@ -0,0 +1,67 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "inputfd_impl.h"
+
+#include <cstdlib>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace unboxer {
+
+void InputFdImpl::open()
+{
+    int  descriptor = -1;
+    bool shared     = true; // dup() of somebody's descriptor. O_NONBLOCK would change theirs too
+    if (uri == "-") {
+        descriptor = ::fcntl(STDIN_FILENO, F_DUPFD_CLOEXEC, 0);
+    } else if (uri.rfind("fd:", 0) == 0) {
+        char *end    = nullptr;
+        auto  number = std::strtol(uri.c_str() + 3, &end, 10);
+        if (end != uri.c_str() + 3 && !*end) {
+            descriptor = ::fcntl(int(number), F_DUPFD_CLOEXEC, 0);
+        }
+    } else {
+        descriptor = ::open(uri.c_str(), O_RDONLY | O_CLOEXEC);
+        shared     = false;
+    }
+    int flags = descriptor >= 0 ? ::fcntl(descriptor, F_GETFL) : -1;
+    if (flags >= 0) {
+        ::fcntl(descriptor, F_SETFL, flags | O_NONBLOCK);
+    }
+    if (!attach(descriptor, shared ? flags : -1)) {
+        if (descriptor >= 0) {
+            if (flags >= 0) {
+                ::fcntl(descriptor, F_SETFL, flags);
+            }
+            ::close(descriptor);
+        }
+        reportClosed(Status::SourceNotExist);
+        return;
+    }
+    openedCallback();
+}
+
+} // namespace unboxer
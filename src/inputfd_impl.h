@@ -0,0 +1,61 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "inputreactor.h"
+
+#include <string>
+
+namespace unboxer {
+
+/**
+ * @brief Non-blocking source for files, pipes and sockets driven by the thread's Reactor.
+ *
+ * The uri is a file path, "-" for stdin or "fd:N" for an already open descriptor (it's duplicated, so the caller
+ * still owns N). The duplicate shares O_NONBLOCK with the original, so stdin or N is non-blocking while the source is
+ * open; its flags are restored on reset() and destruction.
+ */
+class UNBOXER_EXPORT InputFdImpl : public InputReactorBase {
+public:
+    template <typename OpenedCB, typename DataReadyCB, typename DataReadCB, typename ClosedCB>
+    InputFdImpl(const std::string &uri,
+                OpenedCB         &&openedCallback,
+                DataReadyCB      &&dataReadyCallback,
+                DataReadCB       &&dataReadCallback,
+                ClosedCB         &&closedCallback) :
+        InputReactorBase(std::move(openedCallback),
+                         std::move(dataReadyCallback),
+                         std::move(dataReadCallback),
+                         std::move(closedCallback)),
+        uri(uri)
+    {
+    }
+    void open();
+
+private:
+    std::string uri;
+};
+
+} // namespace unboxer
@@ -26,8 +26,112 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <QUrl>
 
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
 namespace unboxer {
 
+/**
+ * Chunks are read on the worker thread and queued. The consumer takes them one by one and passes them, or raw parts
+ * of them, to the parser, so nothing is copied on the way. Only the queue is guarded by the mutex.
+ */
+struct InputFileImpl::ReadAhead {
+    // shared with the worker
+    std::mutex              mutex;
+    std::condition_variable wake;          // the worker waits for a free slot, a seek or stop
+    std::deque<QByteArray>  chunks;        // read and not yet taken, in order
+    qint64                  seekTo   = -1; // the worker has to continue from this offset
+    std::uint64_t           epoch    = 0;  // incremented on seek. a chunk read before that is dropped
+    bool                    eof      = false;
+    bool                    failed   = false;
+    bool                    stopping = false;
+    bool                    waiting  = false; // the consumer waits for a chunk to be queued
+
+    // consumer only
+    QByteArray current; // the chunk being delivered
+    int        currentOffset = 0;
+    qint64     position      = 0; // file offset of the next byte to deliver
+    qint64     fileSize      = 0;
+    bool       notifyPending = false;
+
+    std::thread thread;
+
+    void run(InputFileImpl *input, QString fileName, int capacity, qint64 chunkSize);
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    qint64 buffered() const
+    {
+        qint64 size = current.size() - currentOffset;
+        for (auto const &chunk : chunks) {
+            size += chunk.size();
+        }
+        return size;
+    }
+};
+
+void InputFileImpl::ReadAhead::run(InputFileImpl *input, QString fileName, int capacity, qint64 chunkSize)
+{
+    QFile file(fileName);
+    bool  ok = file.open(QIODevice::ReadOnly);
+    while (true) {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [&]() { return stopping || seekTo >= 0 || (!eof && !failed && int(chunks.size()) < capacity); });
+        if (stopping) {
+            return;
+        }
+        if (seekTo >= 0) {
+            ok     = ok && file.seek(seekTo);
+            seekTo = -1;
+            eof    = false;
+        }
+        auto readEpoch = epoch;
+        lock.unlock();
+
+        QByteArray chunk;
+        if (ok) {
+            chunk = file.read(chunkSize);
+        }
+
+        lock.lock();
+        if (readEpoch != epoch) {
+            continue; // the consumer skipped past it meanwhile
+        }
+        if (chunk.isEmpty()) {
+            eof    = ok && file.atEnd();
+            failed = !eof;
+        } else {
+            chunks.push_back(std::move(chunk));
+        }
+        if (waiting) {
+            waiting = false;
+            QMetaObject::invokeMethod(input, [input]() { input->onChunkReady(); }, Qt::QueuedConnection);
+        }
+    }
+}
+
+void InputFileImpl::ReadAheadDeleter::operator()(ReadAhead *readAhead) const
+{
+    readAhead->stop();
+    delete readAhead;
+}
+
+void InputFileImpl::setReadAhead(int chunks, qint64 chunkSize)
+{
+    readAheadChunks    = qMax(0, chunks);
+    readAheadChunkSize = qMax<qint64>(1, chunkSize);
+}
+
 void InputFileImpl::open()
 {
     file.setFileName(QString::fromStdString(fileName));
@@ -35,11 +139,22 @@ void InputFileImpl::open()
         closedCallback(Status::SourceNotExist); // well yes. this could be multiple of other reasons
         return;
     }
+    if (readAheadChunks) {
+        readAhead.reset(new ReadAhead);
+        readAhead->fileSize = file.size();
+        readAhead->waiting  = true; // the first chunk is reported by dataReadyCallback
+        readAhead->thread   = std::thread(&ReadAhead::run, readAhead.get(), this, file.fileName(), readAheadChunks,
+                                        readAheadChunkSize);
+    }
     openedCallback();
 }
 
 void InputFileImpl::read(std::size_t size)
 {
+    if (readAhead) {
+        readAheadRead(size);
+        return;
+    }
     auto data = file.read(size);
     if (data.isEmpty()) {
         if (file.atEnd()) {
@@ -49,6 +164,9 @@ void InputFileImpl::read(std::size_t size)
         }
     } else {
         dataReadCallback(data);
+        if (!file.isOpen()) {
+            return; // the source was reset by the callback
+        }
         if (!file.atEnd()) {
             dataReadyCallback();
         } else {
@@ -57,6 +175,118 @@ void InputFileImpl::read(std::size_t size)
     }
 }
 
-void InputFileImpl::reset() { file.close(); }
+void InputFileImpl::reset()
+{
+    readAhead.reset();
+    file.close();
+}
+
+bool InputFileImpl::skip(std::uint64_t size)
+{
+    if (readAhead) {
+        return readAheadSkip(size);
+    }
+    if (!file.isOpen() || size > bytesAvailable()) {
+        return false;
+    }
+    return file.seek(file.pos() + qint64(size));
+}
+
+std::size_t InputFileImpl::bytesAvailable() const
+{
+    if (readAhead) {
+        std::lock_guard<std::mutex> lock(readAhead->mutex);
+        return std::size_t(readAhead->buffered());
+    }
+    return file.isOpen() ? file.size() - file.pos() : 0;
+}
+
+void InputFileImpl::readAheadRead(std::size_t size)
+{
+    auto &ra = *readAhead;
+    if (ra.currentOffset == ra.current.size()) {
+        std::lock_guard<std::mutex> lock(ra.mutex);
+        if (ra.chunks.empty()) {
+            if (!ra.eof && !ra.failed) {
+                ra.waiting = true; // onChunkReady() will call dataReadyCallback
+                return;
+            }
+        } else {
+            ra.current       = std::move(ra.chunks.front());
+            ra.currentOffset = 0;
+            ra.chunks.pop_front();
+            ra.wake.notify_one(); // a slot is free
+        }
+    }
+    if (ra.currentOffset == ra.current.size()) {
+        closedCallback(ra.failed ? Status::Corrupted : Status::Eof);
+        return;
+    }
+
+    auto available = ra.current.size() - ra.currentOffset;
+    auto dataSize  = int(qMin<qint64>(qint64(size), available));
+    // the whole chunk is passed as it is. a part of it is raw data, valid till the callback returns
+    auto data = dataSize == ra.current.size() ? ra.current
+                                              : QByteArray::fromRawData(ra.current.constData() + ra.currentOffset, dataSize);
+    ra.currentOffset += dataSize;
+    ra.position += dataSize;
+    dataReadCallback(data);
+    if (!readAhead) {
+        return; // the source was reset by the callback
+    }
+    if (ra.position >= ra.fileSize && ra.currentOffset == ra.current.size()) {
+        closedCallback(Status::Eof);
+        return;
+    }
+    // queued, so reading from the callback doesn't recurse through the whole file
+    if (!ra.notifyPending) {
+        ra.notifyPending = true;
+        QMetaObject::invokeMethod(this, [this]() { onChunkReady(); }, Qt::QueuedConnection);
+    }
+}
+
+bool InputFileImpl::readAheadSkip(std::uint64_t size)
+{
+    auto &ra = *readAhead;
+    if (qint64(size) > ra.fileSize - ra.position) {
+        return false;
+    }
+    ra.position += qint64(size);
+    auto inCurrent = qMin<qint64>(qint64(size), ra.current.size() - ra.currentOffset);
+    ra.currentOffset += int(inCurrent);
+    size -= std::uint64_t(inCurrent);
+    if (!size) {
+        return true;
+    }
+    ra.current.clear();
+    ra.currentOffset = 0;
+
+    std::unique_lock<std::mutex> lock(ra.mutex);
+    while (!ra.chunks.empty() && size >= std::uint64_t(ra.chunks.front().size())) {
+        size -= ra.chunks.front().size();
+        ra.chunks.pop_front();
+    }
+    if (!ra.chunks.empty()) {
+        ra.current       = std::move(ra.chunks.front());
+        ra.currentOffset = int(size);
+        ra.chunks.pop_front();
+    } else if (size) {
+        // beyond what's read ahead. the worker continues from the new position instead of reading through
+        ra.seekTo = ra.position;
+        ra.epoch++;
+    }
+    lock.unlock();
+    ra.wake.notify_one();
+    return true;
+}
+
+void InputFileImpl::onChunkReady()
+{
+    if (!readAhead) {
+        return;
+    }
+    readAhead->notifyPending = false;
+    dataReadyCallback();
+}
 
 } // namespace unboxer
@@ -47,6 +47,8 @@ public:
     QFile  file;
     qint64 needToRead = 0;
 
+    static constexpr qint64 DEFAULT_CHUNK_SIZE = 1024 * 1024;
+
 public:
     template <typename OpenedCB, typename DataReadyCB, typename DataReadCB, typename ClosedCB>
     InputFileImpl(const std::string &fileName,
@@ -59,13 +61,31 @@ public:
         dataReadCallback(std::move(dataReadCallback)), closedCallback(std::move(closedCallback))
     {
     }
+    // Keeps up to chunks of chunkSize bytes read ahead on a background thread, so the disk is busy while the data is
+    // parsed. Chunks are handed over without copying and skip() beyond them moves the reader instead of reading
+    // through. 0 chunks - read on demand (default). Has to be set before open()
+    void setReadAhead(int chunks, qint64 chunkSize = DEFAULT_CHUNK_SIZE);
+
     void        open();
     void        read(std::size_t size);
     void        reset();
-    std::size_t bytesAvailable() const { return file.isOpen() ? file.size() - file.pos() : 0; }
+    bool        skip(std::uint64_t size);
+    std::size_t bytesAvailable() const;
 
 private:
+    struct ReadAhead;
+    struct ReadAheadDeleter { // stops the thread. ReadAhead is known to the .cpp only
+        void operator()(ReadAhead *readAhead) const;
+    };
+
     void tryRead();
+    void readAheadRead(std::size_t size);
+    bool readAheadSkip(std::uint64_t size);
+    void onChunkReady();
+
+    int                                          readAheadChunks    = 0;
+    qint64                                       readAheadChunkSize = DEFAULT_CHUNK_SIZE;
+    std::unique_ptr<ReadAhead, ReadAheadDeleter> readAhead; // while open in read-ahead mode
 };
 
 } // namespace unboxer
@@ -24,27 +24,110 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "inputhttp_impl.h"
 
+#include <QTimer>
 #include <QUrl>
 
 namespace unboxer {
 
-void InputHttpImpl::open()
+namespace {
+    // errors after which the same request has a good chance to succeed
+    bool isTransient(QNetworkReply::NetworkError error)
+    {
+        switch (error) {
+        case QNetworkReply::ConnectionRefusedError:
+        case QNetworkReply::RemoteHostClosedError:
+        case QNetworkReply::TimeoutError:
+        case QNetworkReply::TemporaryNetworkFailureError:
+        case QNetworkReply::NetworkSessionFailedError:
+        case QNetworkReply::ProxyConnectionClosedError:
+        case QNetworkReply::UnknownNetworkError:
+        case QNetworkReply::ServiceUnavailableError:
+            return true;
+        default:
+            return false;
+        }
+    }
+}
+
+void InputHttpImpl::open() { request(); }
+
+void InputHttpImpl::request()
 {
-    reply.reset(nam.get(QNetworkRequest(QUrl(QString::fromStdString(url)))));
-    connect(reply.get(), &QNetworkReply::metaDataChanged, this, [&]() { openedCallback(); });
-    connect(reply.get(), &QNetworkReply::readyRead, this, [this]() { dataReadyCallback(); });
-    connect(reply.get(), &QNetworkReply::finished, this, [this]() { tryReportClose(); });
+    QNetworkRequest request(QUrl(QString::fromStdString(url)));
+    if (delivered) {
+        request.setRawHeader("Range", "bytes=" + QByteArray::number(delivered) + '-');
+        if (!validator.isEmpty()) {
+            request.setRawHeader("If-Range", validator); // the whole resource comes back if it has changed
+        }
+    }
+    if (readBufferSize > 0) {
+        request.setAttribute(QNetworkRequest::Http2AllowedAttribute, false); // see HttpPool::setReadBufferSize()
+    }
+    HttpPool::forThread().get(request, this, [this](QNetworkReply *started) {
+        if (closed) {
+            started->deleteLater(); // reset while waiting for a free connection
+            return;
+        }
+        reply.reset(started);
+        accepted = false;
+        if (readBufferSize >= 0) {
+            reply->setReadBufferSize(readBufferSize);
+        }
+        connect(reply.get(), &QNetworkReply::metaDataChanged, this, [this]() { onMetaData(); });
+        connect(reply.get(), &QNetworkReply::readyRead, this, [this]() {
+            if (accepted) {
+                dataReadyCallback();
+            }
+        });
+        connect(reply.get(), &QNetworkReply::finished, this, [this]() { tryReportClose(); });
+    });
+}
+
+void InputHttpImpl::onMetaData()
+{
+    auto code = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (accepted || code / 100 != 2) {
+        return; // an error is reported when the reply finishes
+    }
+    if (!delivered) {
+        // the first response, or a repeated one when nothing was received
+        auto etag = reply->rawHeader("ETag");
+        validator = etag.isEmpty() || etag.startsWith("W/") ? reply->rawHeader("Last-Modified") : etag;
+        auto length    = reply->header(QNetworkRequest::ContentLengthHeader);
+        totalSize      = code == 200 && length.isValid() ? length.toLongLong() : -1;
+        rangesAccepted = reply->rawHeader("Accept-Ranges").trimmed().toLower() != "none";
+    } else {
+        auto expected = "bytes " + QByteArray::number(delivered) + '-';
+        auto range    = reply->rawHeader("Content-Range");
+        if (code != 206 || !range.startsWith(expected)
+            || (totalSize >= 0 && !range.endsWith('/' + QByteArray::number(totalSize)))) {
+            // the resource has changed or the server ignored Range
+            reset();
+            closedCallback(Status::Corrupted);
+            return;
+        }
+    }
+    accepted = true;
+    if (!opened) {
+        opened = true;
+        openedCallback();
+    }
 }
 
 void InputHttpImpl::read(std::size_t size)
 {
     needToRead += size;
-    if (reply && reply->bytesAvailable()) {
+    if (reply && accepted && reply->bytesAvailable()) {
         auto dataSz = qMin(needToRead, reply->bytesAvailable());
         if (dataSz) {
             auto data = reply->read(dataSz);
             needToRead -= data.size();
+            delivered += data.size();
+            failures = 0;
             dataReadCallback(data);
+            if (!reply) {
+                return; // the source was reset by the callback
+            }
         }
         if (!reply->bytesAvailable() && !reply->isRunning()) {
 
@@ -57,9 +140,34 @@ void InputHttpImpl::read(std::size_t size)
 
 void InputHttpImpl::reset()
 {
-    auto r = reply.release();
-    r->disconnect(this);
-    r->deleteLater();
+    closed = true;
+    if (auto r = reply.release()) {
+        r->disconnect(this);
+        r->deleteLater();
+    }
+}
+
+bool InputHttpImpl::canResume() const
+{
+    // nothing delivered - the same request once more
+    return failures < maxResumes_ && (!delivered || rangesAccepted) && (totalSize < 0 || delivered < totalSize);
+}
+
+void InputHttpImpl::resume()
+{
+    auto delay = qMin<qint64>(qint64(resumeDelay_) << qMin(failures, 16), MAX_RESUME_DELAY);
+    failures++;
+    resumes_++;
+    accepted = false;
+    if (auto r = reply.release()) {
+        r->disconnect(this);
+        r->deleteLater();
+    }
+    QTimer::singleShot(int(delay), this, [this]() {
+        if (!closed) {
+            request();
+        }
+    });
 }
 
 void InputHttpImpl::tryReportClose()
@@ -67,11 +175,15 @@ void InputHttpImpl::tryReportClose()
     if (closed) {
         return;
     }
-    if (reply && !reply->bytesAvailable() && reply->isFinished()) {
+    if (reply && (!accepted || !reply->bytesAvailable()) && reply->isFinished()) {
+        if (isTransient(reply->error()) && canResume()) {
+            resume();
+            return;
+        }
         auto status = Status::Ok;
         switch (reply->error()) {
         case QNetworkReply::NoError:
-            status = Status::Eof;
+            status = accepted ? Status::Eof : Status::Corrupted;
             break;
         case QNetworkReply::TimeoutError:
             status = Status::Timeout;
@@ -27,7 +27,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "status.h"
 #include "unboxer_export.h"
 
-#include <QNetworkAccessManager>
+#include "httppool.h"
+
 #include <QNetworkReply>
 #include <QPointer>
 
@@ -37,19 +38,32 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 namespace unboxer {
 
+/**
+ * @brief HTTP source receiving the resource with one GET request.
+ *
+ * A download interrupted by a transient network error (connection reset or refused, timeout, 503 and the like) is
+ * resumed transparently: the rest is requested with Range from the first byte which wasn't delivered yet and If-Range
+ * with the ETag or Last-Modified of the first response, so a changed resource isn't spliced to the old one. Anything
+ * but the expected 206 ends the stream with Status::Corrupted, as does the original error once maxResumes() attempts in
+ * a row brought no data. The delay before an attempt starts at resumeDelay() and doubles with every failed one.
+ */
 class UNBOXER_EXPORT InputHttpImpl : public QObject {
     Q_OBJECT
 public:
+    static constexpr int DEFAULT_MAX_RESUMES  = 5;
+    static constexpr int DEFAULT_RESUME_DELAY = 500;   // ms
+    static constexpr int MAX_RESUME_DELAY     = 16000; // ms
+
     std::string                             url;
     std::function<void()>                   openedCallback;
     std::function<void()>                   dataReadyCallback;
     std::function<void(const QByteArray &)> dataReadCallback;
     std::function<void(Status)>             closedCallback;
 
-    QNetworkAccessManager          nam;
-    std::unique_ptr<QNetworkReply> reply;
-    qint64                         needToRead = 0;
-    bool                           closed     = false;
+    std::unique_ptr<QNetworkReply> reply; // null while the request waits in HttpPool
+    qint64                         needToRead     = 0;
+    qint64                         readBufferSize = -1; // -1 - HttpPool's
+    bool                           closed         = false;
 
 public:
     template <typename OpenedCB, typename DataReadyCB, typename DataReadCB, typename ClosedCB>
@@ -63,13 +77,37 @@ public:
         dataReadCallback(std::move(dataReadCallback)), closedCallback(std::move(closedCallback))
     {
     }
+    // bound for data received ahead of read(). see HttpPool::setReadBufferSize(). has to be set before open()
+    void setReadBufferSize(qint64 size) { readBufferSize = size; }
+    // attempts to resume without getting any data before giving up. 0 - don't resume. has to be set before open()
+    void setMaxResumes(int count) { maxResumes_ = qMax(0, count); }
+    int  maxResumes() const { return maxResumes_; }
+    void setResumeDelay(int msecs) { resumeDelay_ = qMax(0, msecs); }
+    int  resumeDelay() const { return resumeDelay_; }
+    int  resumes() const { return resumes_; } // requests made after the first one
+
     void        open();
     void        read(std::size_t size);
     void        reset();
-    std::size_t bytesAvailable() const { return (reply && reply->isOpen()) ? reply->bytesAvailable() : 0; }
+    std::size_t bytesAvailable() const { return (reply && accepted && reply->isOpen()) ? reply->bytesAvailable() : 0; }
 
 private:
+    void request();
+    void onMetaData();
+    bool canResume() const;
+    void resume();
     void tryReportClose();
+
+    int        maxResumes_    = DEFAULT_MAX_RESUMES;
+    int        resumeDelay_   = DEFAULT_RESUME_DELAY;
+    int        resumes_       = 0;
+    int        failures       = 0;     // resumes since data was delivered last time
+    qint64     delivered      = 0;     // where the next request starts
+    qint64     totalSize      = -1;    // from the first response if it tells
+    QByteArray validator;              // strong ETag or Last-Modified of the first response for If-Range
+    bool       rangesAccepted = true;  // unless the server says it doesn't support them
+    bool       opened         = false; // openedCallback was called
+    bool       accepted       = false; // the data of the current reply belongs to the stream
 };
 
 } // namespace unboxer
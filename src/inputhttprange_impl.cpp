@@ -0,0 +1,344 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "inputhttprange_impl.h"
+
+#include <QUrl>
+
+#include <algorithm>
+
+namespace unboxer {
+
+namespace {
+    // "bytes 0-1023/4096"
+    bool parseContentRange(const QByteArray &value, qint64 &start, qint64 &end, qint64 &total)
+    {
+        if (!value.startsWith("bytes ")) {
+            return false;
+        }
+        auto dash  = value.indexOf('-');
+        auto slash = value.indexOf('/');
+        if (dash < 0 || slash < dash) {
+            return false;
+        }
+        bool startOk, endOk, totalOk;
+        start = value.mid(6, dash - 6).trimmed().toLongLong(&startOk);
+        end   = value.mid(dash + 1, slash - dash - 1).toLongLong(&endOk);
+        total = value.mid(slash + 1).trimmed().toLongLong(&totalOk);
+        return startOk && endOk && totalOk && start <= end && end < total;
+    }
+
+    Status replyStatus(const QNetworkReply *reply)
+    {
+        switch (reply->error()) {
+        case QNetworkReply::NoError:
+            return Status::Ok;
+        case QNetworkReply::TimeoutError:
+            return Status::Timeout;
+        default:
+            return Status::Corrupted;
+        }
+    }
+}
+
+void InputHttpRangeImpl::open()
+{
+    connections_ = qMin(2, maxConnections_);
+    sampleTimer.start();
+    request(0, segmentSize_); // the total size is learnt from its Content-Range
+}
+
+void InputHttpRangeImpl::read(std::size_t size)
+{
+    needToRead += size;
+    if (!segments.empty() && !toDiscard) {
+        auto &front = segments.front();
+        if (front.reply && front.reply->bytesAvailable()) {
+            auto data = front.reply->read(qMin(needToRead, front.reply->bytesAvailable()));
+            needToRead -= data.size();
+            front.consumed += data.size();
+            dataReadCallback(data);
+            if (closed) {
+                return; // the source was reset by the callback
+            }
+        }
+    }
+    advance();
+}
+
+void InputHttpRangeImpl::reset()
+{
+    closed = true;
+    for (auto &segment : segments) {
+        drop(segment);
+    }
+    segments.clear();
+}
+
+bool InputHttpRangeImpl::skip(std::uint64_t size)
+{
+    if (closed) {
+        return false;
+    }
+    if (totalSize_ >= 0) {
+        auto position = segments.empty() ? nextOffset : segments.front().offset + segments.front().consumed;
+        if (size > std::uint64_t(totalSize_ - position - toDiscard)) {
+            return false; // beyond the end, like the file source
+        }
+    }
+    toDiscard += size;
+    // segments entirely in the skipped range are dropped, even if not received yet
+    while (!segments.empty()) {
+        auto &front = segments.front();
+        if (front.size < 0 || front.status != Status::Ok || toDiscard < front.size - front.consumed) {
+            break;
+        }
+        toDiscard -= front.size - front.consumed;
+        drop(front);
+        segments.pop_front();
+    }
+    if (segments.empty() && totalSize_ >= 0) {
+        nextOffset = qMin(totalSize_, nextOffset + toDiscard);
+        toDiscard  = 0;
+    }
+    fillWindow();
+    // the rest is discarded by advance() as it arrives
+    return true;
+}
+
+std::size_t InputHttpRangeImpl::bytesAvailable() const
+{
+    if (segments.empty() || !segments.front().reply) {
+        return 0;
+    }
+    return std::size_t(qMax<qint64>(0, segments.front().reply->bytesAvailable() - toDiscard));
+}
+
+InputHttpRangeImpl::Segment *InputHttpRangeImpl::find(qint64 offset)
+{
+    for (auto &segment : segments) {
+        if (segment.offset == offset) {
+            return &segment;
+        }
+    }
+    return nullptr;
+}
+
+void InputHttpRangeImpl::request(qint64 offset, qint64 size)
+{
+    segments.push_back({ offset, size });
+    nextOffset = offset + size;
+
+    QNetworkRequest request(QUrl(QString::fromStdString(url)));
+    request.setRawHeader("Range", "bytes=" + QByteArray::number(offset) + '-' + QByteArray::number(offset + size - 1));
+    HttpPool::forThread().get(request, this, [this, offset](QNetworkReply *reply) { onStarted(offset, reply); });
+}
+
+void InputHttpRangeImpl::onStarted(qint64 offset, QNetworkReply *reply)
+{
+    auto segment = find(offset);
+    if (closed || !segment) {
+        reply->deleteLater(); // reset or skipped while waiting for a free connection
+        return;
+    }
+    segment->reply.reset(reply);
+    // the whole segment fits, so its connection is free as soon as it's received
+    reply->setReadBufferSize(segment->size);
+    connect(reply, &QNetworkReply::metaDataChanged, this, [this, offset]() { onMetaData(offset); });
+    connect(reply, &QNetworkReply::readyRead, this, [this, offset]() {
+        if (!segments.empty() && segments.front().offset == offset) {
+            advance();
+        }
+    });
+    connect(reply, &QNetworkReply::finished, this, [this, offset]() { onFinished(offset); });
+}
+
+void InputHttpRangeImpl::onMetaData(qint64 offset)
+{
+    auto segment = find(offset);
+    if (!segment || !segment->reply) {
+        return;
+    }
+    auto code = segment->reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (code == 206) {
+        qint64 start, end, total;
+        if (!parseContentRange(segment->reply->rawHeader("Content-Range"), start, end, total) || start != offset
+            || (totalSize_ >= 0 && total != totalSize_)) {
+            fail(*segment, Status::Corrupted); // not what was asked or the resource changed meanwhile
+            return;
+        }
+        totalSize_    = total;
+        segment->size = end - start + 1;
+        nextOffset    = qMin(nextOffset, totalSize_);
+    } else if (offset == 0 && code == 200) {
+        segment->size = -1; // Range is ignored. everything comes with this reply
+        segment->reply->setReadBufferSize(HttpPool::forThread().readBufferSize());
+    } else if (offset == 0 && code == 416) {
+        // empty resource
+        totalSize_    = 0;
+        nextOffset    = 0;
+        segment->size = 0;
+        segment->done = true;
+        drop(*segment);
+    } else if (offset != 0 && code / 100 == 2) {
+        fail(*segment, Status::Corrupted);
+        return;
+    }
+    if (offset == 0 && !opened) {
+        opened = true;
+        openedCallback();
+        if (closed) {
+            return;
+        }
+    }
+    fillWindow();
+    if (segments.front().offset == offset) {
+        advance();
+    }
+}
+
+void InputHttpRangeImpl::onFinished(qint64 offset)
+{
+    auto segment = find(offset);
+    if (!segment || !segment->reply) {
+        return;
+    }
+    segment->done   = true;
+    segment->status = replyStatus(segment->reply.get());
+    if (segment->status == Status::Ok && segment->size >= 0
+        && segment->consumed + segment->reply->bytesAvailable() != segment->size) {
+        segment->status = Status::Corrupted; // truncated
+    }
+    if (segment->status == Status::Ok) {
+        adapt(qMax<qint64>(0, segment->size));
+    }
+    fillWindow();
+    if (segments.front().offset == offset) {
+        advance();
+    }
+}
+
+void InputHttpRangeImpl::fail(Segment &segment, Status status)
+{
+    segment.status = status;
+    segment.done   = true;
+    drop(segment);
+    if (&segments.front() == &segment) {
+        advance();
+    }
+}
+
+void InputHttpRangeImpl::drop(Segment &segment)
+{
+    if (auto reply = segment.reply.release()) {
+        reply->disconnect(this);
+        reply->deleteLater();
+    }
+}
+
+void InputHttpRangeImpl::fillWindow()
+{
+    if (closed || totalSize_ < 0) {
+        return;
+    }
+    while (nextOffset < totalSize_ && int(segments.size()) < 2 * maxConnections_ && inFlight() < connections_) {
+        request(nextOffset, qMin(segmentSize_, totalSize_ - nextOffset));
+    }
+}
+
+void InputHttpRangeImpl::adapt(qint64 bytes)
+{
+    // one sample is a segment per connection. keep adding connections while it pays off
+    sampleBytes += bytes;
+    if (++sampleSegments < connections_) {
+        return;
+    }
+    auto rate = double(sampleBytes) / qMax<qint64>(1, sampleTimer.restart());
+    if (rate > lastRate * 1.1) {
+        connections_ = qMin(connections_ + 1, maxConnections_);
+    } else if (rate < lastRate * 0.9) {
+        connections_ = qMax(connections_ - 1, 1);
+    }
+    lastRate       = rate;
+    sampleBytes    = 0;
+    sampleSegments = 0;
+}
+
+void InputHttpRangeImpl::advance()
+{
+    while (!closed && !segments.empty()) {
+        auto &front = segments.front();
+        if (toDiscard && front.reply) {
+            auto discarded = front.reply->skip(qMin(toDiscard, front.reply->bytesAvailable()));
+            front.consumed += discarded;
+            toDiscard -= discarded;
+        }
+        if (!front.done || (front.reply && front.reply->bytesAvailable())) {
+            break;
+        }
+        if (front.status != Status::Ok) {
+            auto status = front.status;
+            reset();
+            closedCallback(status);
+            return;
+        }
+        drop(front);
+        segments.pop_front();
+        fillWindow();
+    }
+    if (closed) {
+        return;
+    }
+    if (segments.empty()) {
+        closed = true;
+        closedCallback(Status::Eof);
+    } else if (bytesAvailable()) {
+        notifyDataReady();
+    }
+}
+
+void InputHttpRangeImpl::notifyDataReady()
+{
+    // queued, so a consumer reading from the callback doesn't recurse through a whole segment
+    if (notifyPending) {
+        return;
+    }
+    notifyPending = true;
+    QMetaObject::invokeMethod(
+        this,
+        [this]() {
+            notifyPending = false;
+            if (!closed && bytesAvailable()) {
+                dataReadyCallback();
+            }
+        },
+        Qt::QueuedConnection);
+}
+
+int InputHttpRangeImpl::inFlight() const
+{
+    return int(std::count_if(segments.begin(), segments.end(), [](auto const &segment) { return !segment.done; }));
+}
+
+} // namespace unboxer
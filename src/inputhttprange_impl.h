@@ -0,0 +1,136 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "status.h"
+#include "unboxer_export.h"
+
+#include "httppool.h"
+
+#include <QElapsedTimer>
+#include <QNetworkReply>
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace unboxer {
+
+/**
+ * @brief HTTP source fetching the resource with several concurrent Range requests.
+ *
+ * The resource is split into segments of segmentSize() bytes. Up to connections() of them are downloaded at once and
+ * the data is delivered strictly in order, so for the parser it's the same as InputHttpImpl. Segments received ahead
+ * of the one being read wait in a window of 2 * maxConnections() segments, which bounds memory per stream.
+ *
+ * The number of connections starts at 2 and is adapted to the observed throughput: it grows while every sample gets
+ * faster and shrinks when it gets slower. The per-host limit of HttpPool applies on top of maxConnections().
+ *
+ * If the server ignores Range the whole resource is received with the first request, like with InputHttpImpl.
+ */
+class UNBOXER_EXPORT InputHttpRangeImpl : public QObject {
+    Q_OBJECT
+public:
+    static constexpr qint64 DEFAULT_SEGMENT_SIZE    = 4 * 1024 * 1024;
+    static constexpr int    DEFAULT_MAX_CONNECTIONS = 4;
+
+    std::string                             url;
+    std::function<void()>                   openedCallback;
+    std::function<void()>                   dataReadyCallback;
+    std::function<void(const QByteArray &)> dataReadCallback;
+    std::function<void(Status)>             closedCallback;
+
+public:
+    template <typename OpenedCB, typename DataReadyCB, typename DataReadCB, typename ClosedCB>
+    InputHttpRangeImpl(const std::string &url,
+                       OpenedCB         &&openedCallback,
+                       DataReadyCB      &&dataReadyCallback,
+                       DataReadCB       &&dataReadCallback,
+                       ClosedCB         &&closedCallback) :
+        url(url),
+        openedCallback(std::move(openedCallback)), dataReadyCallback(std::move(dataReadyCallback)),
+        dataReadCallback(std::move(dataReadCallback)), closedCallback(std::move(closedCallback))
+    {
+    }
+
+    // have to be set before open()
+    qint64 segmentSize() const { return segmentSize_; }
+    void   setSegmentSize(qint64 size) { segmentSize_ = qMax<qint64>(1, size); }
+    int    maxConnections() const { return maxConnections_; }
+    void   setMaxConnections(int limit) { maxConnections_ = qMax(1, limit); }
+
+    int    connections() const { return connections_; } // the current adapted number
+    qint64 totalSize() const { return totalSize_; }      // -1 until known
+
+    void        open();
+    void        read(std::size_t size);
+    void        reset();
+    bool        skip(std::uint64_t size);
+    std::size_t bytesAvailable() const;
+
+private:
+    struct Segment {
+        qint64                         offset;
+        qint64                         size;         // -1 - till the end if the server ignored Range
+        qint64                         consumed = 0; // read from the reply or skipped
+        std::unique_ptr<QNetworkReply> reply;        // null while the request waits in HttpPool or after an error
+        Status                         status = Status::Ok; // reported once all the preceding data is delivered
+        bool                           done   = false;      // nothing more will be received
+    };
+
+    Segment *find(qint64 offset);
+    void     request(qint64 offset, qint64 size);
+    void     onStarted(qint64 offset, QNetworkReply *reply);
+    void     onMetaData(qint64 offset);
+    void     onFinished(qint64 offset);
+    void     fail(Segment &segment, Status status);
+    void     drop(Segment &segment);
+    void     fillWindow();
+    void     adapt(qint64 bytes);
+    void     advance();
+    void     notifyDataReady();
+    int      inFlight() const;
+
+    qint64              segmentSize_    = DEFAULT_SEGMENT_SIZE;
+    int                 maxConnections_ = DEFAULT_MAX_CONNECTIONS;
+    int                 connections_    = 2;
+    qint64              totalSize_      = -1;
+    qint64              nextOffset      = 0; // of the next segment to request
+    qint64              needToRead      = 0;
+    qint64              toDiscard       = 0; // skipped bytes of the front segment which didn't arrive yet
+    std::deque<Segment> segments;            // requested but not yet delivered, in order
+    bool                opened          = false;
+    bool                closed          = false;
+    bool                notifyPending   = false; // dataReadyCallback is queued
+
+    // throughput sampling for adapt()
+    QElapsedTimer sampleTimer;
+    qint64        sampleBytes    = 0;
+    int           sampleSegments = 0;
+    double        lastRate       = 0;
+};
+
+} // namespace unboxer
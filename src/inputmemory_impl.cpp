@@ -28,12 +28,16 @@ namespace unboxer {
 
 void InputMemoryImpl::read(std::size_t size)
 {
-    if (data.size() - offset > size) {
-        dataReadCallback(QByteArray::fromRawData(data.data() + offset, size));
-        offset += size;
-    } else {
-        dataReadCallback(QByteArray::fromRawData(data.data() + offset, data.size() - offset));
-        offset = data.size();
+    auto chunkSize = qMin(size, bytesAvailable());
+    if (!chunkSize) {
+        closedCallback(Status::Eof);
+        return;
+    }
+    auto chunk = QByteArray::fromRawData(data.constData() + offset, int(chunkSize));
+    offset += chunkSize;
+    dataReadCallback(chunk);
+    if (data.isEmpty()) {
+        return; // the source was reset by the callback
     }
     if (offset == std::size_t(data.size())) {
         closedCallback(Status::Eof);
@@ -62,6 +62,14 @@ public:
         data.clear();
         offset = 0;
     }
+    bool skip(std::uint64_t size)
+    {
+        if (size > bytesAvailable()) {
+            return false;
+        }
+        offset += size;
+        return true;
+    }
     std::size_t bytesAvailable() const { return data.size() - offset; }
 };
 
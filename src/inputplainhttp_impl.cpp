@@ -0,0 +1,270 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "inputplainhttp_impl.h"
+
+#include <QList>
+
+#include <cerrno>
+#include <cstring>
+
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace unboxer {
+
+namespace {
+    constexpr int maxHeadersSize = 64 * 1024;
+    constexpr int maxLineSize    = 1024;
+
+    int connectTo(const std::string &host, const std::string &port)
+    {
+        addrinfo hints {};
+        hints.ai_family   = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo *addresses = nullptr;
+        if (::getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0) {
+            return -1;
+        }
+        int fd = -1;
+        for (auto address = addresses; address && fd < 0; address = address->ai_next) {
+            fd = ::socket(address->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (fd >= 0 && ::connect(fd, address->ai_addr, address->ai_addrlen) != 0 && errno != EINPROGRESS) {
+                ::close(fd);
+                fd = -1;
+            }
+        }
+        ::freeaddrinfo(addresses);
+        return fd;
+    }
+}
+
+void InputPlainHttpImpl::open()
+{
+    const std::string scheme = "http://";
+    if (url.rfind(scheme, 0) != 0) {
+        reportClosed(Status::SourceNotExist);
+        return;
+    }
+    auto pathStart = url.find('/', scheme.size());
+    auto authority = url.substr(scheme.size(), pathStart == std::string::npos ? pathStart : pathStart - scheme.size());
+    auto path      = pathStart == std::string::npos ? std::string("/") : url.substr(pathStart);
+    auto host      = authority;
+    auto port      = std::string("80");
+    auto colon     = authority.rfind(':');
+    if (colon != std::string::npos && authority.find(']', colon) == std::string::npos) {
+        host = authority.substr(0, colon);
+        port = authority.substr(colon + 1);
+    }
+    if (host.size() > 2 && host.front() == '[' && host.back() == ']') {
+        host = host.substr(1, host.size() - 2);
+    }
+
+    int descriptor = connectTo(host, port);
+    request        = QByteArray("GET ") + path.c_str() + " HTTP/1.1\r\nHost: " + authority.c_str()
+        + "\r\nUser-Agent: unboxer\r\nAccept-Encoding: identity\r\nConnection: close\r\n\r\n";
+    waitWritable = true;
+    if (!attach(descriptor)) {
+        if (descriptor >= 0) {
+            ::close(descriptor);
+        }
+        reportClosed(Status::SourceNotExist);
+    }
+    // opened when the response headers come
+}
+
+void InputPlainHttpImpl::onReady(std::uint32_t events)
+{
+    if (state != State::Connecting && state != State::Sending) {
+        InputReactorBase::onReady(events);
+        return;
+    }
+    if (state == State::Connecting) {
+        int       error  = 0;
+        socklen_t length = sizeof(error);
+        if (::getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) != 0 || error) {
+            reportClosed(Status::SourceNotExist);
+            return;
+        }
+        state = State::Sending;
+    }
+    auto sent = ::send(fd, request.constData() + requestSent, request.size() - requestSent, MSG_NOSIGNAL);
+    if (sent < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            reportClosed(Status::Corrupted);
+        }
+        return;
+    }
+    requestSent += int(sent);
+    if (requestSent == request.size()) {
+        request.clear();
+        state        = State::Headers;
+        waitWritable = false;
+        updateInterest();
+    }
+}
+
+void InputPlainHttpImpl::consume(const char *data, std::size_t size)
+{
+    if (state == State::Headers) {
+        auto searchFrom = qMax(0, line.size() - 3);
+        line.append(data, int(size));
+        auto end = line.indexOf("\r\n\r\n", searchFrom);
+        if (end < 0) {
+            if (line.size() > maxHeadersSize) {
+                finish(Status::Corrupted);
+            }
+            return;
+        }
+        auto headers = line.left(end + 2);
+        auto rest    = line.mid(end + 4);
+        line.clear();
+        if (!parseHeaders(headers)) {
+            return;
+        }
+        openedCallback();
+        consume(rest.constData(), rest.size());
+        return;
+    }
+    while (size && !isFinished()) {
+        auto taken = consumeBody(data, size);
+        if (!taken) {
+            return; // finished
+        }
+        data += taken;
+        size -= taken;
+    }
+}
+
+bool InputPlainHttpImpl::parseHeaders(const QByteArray &headers)
+{
+    auto lines      = headers.split('\n');
+    auto statusLine = lines.takeFirst().trimmed().split(' ');
+    auto code       = statusLine.size() >= 2 && statusLine[0].startsWith("HTTP/1.") ? statusLine[1].toInt() : 0;
+    if (code < 200 || code >= 300) {
+        finish(code >= 400 && code < 500 ? Status::SourceNotExist : Status::Corrupted);
+        return false;
+    }
+    state = State::Body;
+    for (auto const &header : lines) {
+        auto colon = header.indexOf(':');
+        if (colon < 0) {
+            continue;
+        }
+        auto name  = header.left(colon).trimmed().toLower();
+        auto value = header.mid(colon + 1).trimmed();
+        if (name == "content-length") {
+            bool ok  = false;
+            bodyLeft = value.toLongLong(&ok);
+            if (!ok || bodyLeft < 0) {
+                finish(Status::Corrupted);
+                return false;
+            }
+        } else if (name == "transfer-encoding" && value.toLower().contains("chunked")) {
+            state = State::ChunkSize;
+        }
+    }
+    if (state == State::ChunkSize) {
+        bodyLeft = -1; // chunked coding has priority
+    } else if (bodyLeft == 0) {
+        finish(Status::Eof);
+    }
+    return true;
+}
+
+// appends data to line till the end of line. true if the line is complete
+bool InputPlainHttpImpl::takeLine(const char *data, std::size_t size, std::size_t &taken)
+{
+    auto end = static_cast<const char *>(std::memchr(data, '\n', size));
+    taken    = end ? std::size_t(end - data + 1) : size;
+    line.append(data, int(taken));
+    if (!end && line.size() > maxLineSize) {
+        finish(Status::Corrupted);
+    }
+    return end != nullptr;
+}
+
+// returns how much was taken. 0 if the body is finished
+std::size_t InputPlainHttpImpl::consumeBody(const char *data, std::size_t size)
+{
+    std::size_t taken = 0;
+    switch (state) {
+    case State::Body:
+        taken = bodyLeft < 0 ? size : std::size_t(qMin<std::int64_t>(bodyLeft, size));
+        append(data, taken);
+        if (bodyLeft >= 0 && (bodyLeft -= taken) == 0) {
+            finish(Status::Eof);
+            return 0;
+        }
+        return taken;
+    case State::ChunkSize:
+        if (takeLine(data, size, taken)) {
+            bool ok   = false;
+            chunkLeft = line.left(line.indexOf(';')).trimmed().toULongLong(&ok, 16);
+            line.clear();
+            if (!ok) {
+                finish(Status::Corrupted);
+                return 0;
+            }
+            state = chunkLeft ? State::ChunkData : State::Trailer;
+        }
+        break;
+    case State::ChunkData:
+        taken = std::size_t(qMin<std::uint64_t>(chunkLeft, size));
+        append(data, taken);
+        chunkLeft -= taken;
+        if (!chunkLeft) {
+            state = State::ChunkDataEnd;
+        }
+        return taken;
+    case State::ChunkDataEnd:
+        if (takeLine(data, size, taken)) {
+            line.clear();
+            state = State::ChunkSize;
+        }
+        break;
+    case State::Trailer:
+        if (takeLine(data, size, taken)) {
+            bool last = line.trimmed().isEmpty();
+            line.clear();
+            if (last) {
+                finish(Status::Eof);
+                return 0;
+            }
+        }
+        break;
+    default:
+        return 0;
+    }
+    return taken;
+}
+
+void InputPlainHttpImpl::onEof()
+{
+    // only a body without length may be ended by closing the connection
+    finish(state == State::Body && bodyLeft < 0 ? Status::Eof : Status::Corrupted);
+}
+
+} // namespace unboxer
@@ -0,0 +1,77 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "inputreactor.h"
+
+#include <string>
+
+namespace unboxer {
+
+/**
+ * @brief Plain HTTP/1.1 GET source driven by the thread's Reactor, without Qt networking.
+ *
+ * Handles Content-Length, chunked and close delimited bodies. No TLS, redirects or keep-alive; use InputHttpImpl
+ * for those. The host name is resolved synchronously, so prefer addresses or a local resolver cache.
+ */
+class UNBOXER_EXPORT InputPlainHttpImpl : public InputReactorBase {
+public:
+    template <typename OpenedCB, typename DataReadyCB, typename DataReadCB, typename ClosedCB>
+    InputPlainHttpImpl(const std::string &url,
+                       OpenedCB         &&openedCallback,
+                       DataReadyCB      &&dataReadyCallback,
+                       DataReadCB       &&dataReadCallback,
+                       ClosedCB         &&closedCallback) :
+        InputReactorBase(std::move(openedCallback),
+                         std::move(dataReadyCallback),
+                         std::move(dataReadCallback),
+                         std::move(closedCallback)),
+        url(url)
+    {
+    }
+    void open();
+
+protected:
+    void consume(const char *data, std::size_t size) override;
+    void onEof() override;
+    void onReady(std::uint32_t events) override;
+
+private:
+    enum class State { Connecting, Sending, Headers, Body, ChunkSize, ChunkData, ChunkDataEnd, Trailer };
+
+    bool        parseHeaders(const QByteArray &headers);
+    std::size_t consumeBody(const char *data, std::size_t size);
+    bool        takeLine(const char *data, std::size_t size, std::size_t &taken);
+
+    std::string   url;
+    State         state = State::Connecting;
+    QByteArray    request;
+    int           requestSent = 0;
+    QByteArray    line;           // headers or a line of chunked coding being received
+    std::int64_t  bodyLeft  = -1; // by Content-Length. -1 - till the connection is closed
+    std::uint64_t chunkLeft = 0;
+};
+
+} // namespace unboxer
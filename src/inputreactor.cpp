@@ -0,0 +1,285 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "inputreactor.h"
+
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace unboxer {
+
+InputReactorBase::InputReactorBase(std::function<void()>                   &&openedCallback,
+                                   std::function<void()>                   &&dataReadyCallback,
+                                   std::function<void(const QByteArray &)> &&dataReadCallback,
+                                   std::function<void(Status)>             &&closedCallback) :
+    reactor(Reactor::threadLocal()),
+    openedCallback(std::move(openedCallback)), dataReadyCallback(std::move(dataReadyCallback)),
+    dataReadCallback(std::move(dataReadCallback)), closedCallback(std::move(closedCallback))
+{
+}
+
+InputReactorBase::~InputReactorBase()
+{
+    reset();
+    reactor.cancel(this);
+}
+
+bool InputReactorBase::attach(int fd, int restoreFlags)
+{
+    struct stat info;
+    if (fd < 0 || ::fstat(fd, &info) != 0) {
+        return false;
+    }
+    this->fd           = fd;
+    this->restoreFlags = restoreFlags;
+    regular            = S_ISREG(info.st_mode); // epoll doesn't take regular files. they are always "ready" anyway
+    if (regular) {
+        reactor.schedule(this); // data ready is notified as for anything else
+    }
+    updateInterest();
+    return true;
+}
+
+std::size_t InputReactorBase::bytesAvailable() const
+{
+    if (regular) {
+        // the rest of the file. read() takes it right from the descriptor
+        struct stat info;
+        auto        pos = ::lseek(fd, 0, SEEK_CUR);
+        return pos >= 0 && ::fstat(fd, &info) == 0 && info.st_size > pos ? std::size_t(info.st_size - pos) : 0;
+    }
+    return std::size_t(buffer.size() - bufferOffset);
+}
+
+void InputReactorBase::read(std::size_t size)
+{
+    if (closed) {
+        return;
+    }
+    if (regular) {
+        readRegular(size);
+        return;
+    }
+    auto chunkSize = int(qMin(size, bytesAvailable()));
+    if (chunkSize) {
+        auto chunk = QByteArray(buffer.constData() + bufferOffset, chunkSize);
+        bufferOffset += chunkSize;
+        if (bufferOffset == buffer.size()) {
+            buffer.clear();
+            bufferOffset = 0;
+        }
+        dataReadCallback(chunk);
+        if (closed) {
+            return; // the source was reset by the callback
+        }
+        updateInterest();
+    }
+    if (bytesAvailable()) {
+        reactor.schedule(this);
+    } else if (finished) {
+        reportClosed(finishStatus);
+    }
+}
+
+void InputReactorBase::readRegular(std::size_t size)
+{
+    QByteArray data(int(qMin<std::size_t>(size, MAX_BUFFERED)), Qt::Uninitialized);
+    auto       result = ::read(fd, data.data(), data.size());
+    if (result < 0) {
+        reportClosed(Status::Corrupted);
+        return;
+    }
+    if (result == 0) {
+        reportClosed(Status::Eof);
+        return;
+    }
+    data.resize(int(result));
+    dataReadCallback(data);
+    if (!closed) {
+        reactor.schedule(this);
+    }
+}
+
+void InputReactorBase::reset()
+{
+    closed = true;
+    if (fd >= 0) {
+        if (watched) {
+            reactor.remove(fd, this);
+            watched = false;
+        }
+        if (restoreFlags >= 0) {
+            ::fcntl(fd, F_SETFL, restoreFlags);
+        }
+        ::close(fd);
+        fd = -1;
+    }
+    reactor.cancel(this);
+    buffer.clear();
+    bufferOffset = 0;
+}
+
+bool InputReactorBase::skip(std::uint64_t size)
+{
+    if (closed) {
+        return false;
+    }
+    if (regular) {
+        struct stat info;
+        auto        pos = ::lseek(fd, 0, SEEK_CUR);
+        if (pos < 0 || ::fstat(fd, &info) != 0 || std::uint64_t(info.st_size - pos) < size) {
+            return false;
+        }
+        return ::lseek(fd, off_t(size), SEEK_CUR) >= 0;
+    }
+    if (size <= bytesAvailable()) {
+        bufferOffset += int(size);
+        return true;
+    }
+    if (finished) {
+        return false;
+    }
+    // the rest is dropped as it comes. not read by the consumer at least
+    toDiscard = size - bytesAvailable();
+    buffer.clear();
+    bufferOffset = 0;
+    updateInterest();
+    return true;
+}
+
+void InputReactorBase::onReactorEvents(std::uint32_t events)
+{
+    if (closed) {
+        return;
+    }
+    if (events == 0) {
+        dataReadyCallback();
+    } else {
+        onReady(events);
+    }
+}
+
+void InputReactorBase::onReady([[maybe_unused]] std::uint32_t events)
+{
+    readFd();
+}
+
+void InputReactorBase::readFd()
+{
+    auto before = bytesAvailable();
+    char chunk[READ_CHUNK];
+    while (!finished && !closed && bytesAvailable() < MAX_BUFFERED) {
+        auto result = ::read(fd, chunk, sizeof(chunk));
+        if (result > 0) {
+            consume(chunk, std::size_t(result));
+        } else if (result == 0) {
+            onEof();
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        } else if (errno != EINTR) {
+            finish(Status::Corrupted);
+        }
+    }
+    if (closed) {
+        return;
+    }
+    updateInterest();
+    if (bytesAvailable() > before) {
+        dataReadyCallback();
+    } else if (finished && !bytesAvailable()) {
+        reportClosed(finishStatus);
+    }
+}
+
+void InputReactorBase::consume(const char *data, std::size_t size)
+{
+    append(data, size);
+}
+
+void InputReactorBase::onEof()
+{
+    finish(Status::Eof);
+}
+
+void InputReactorBase::append(const char *data, std::size_t size)
+{
+    if (toDiscard) {
+        auto dropped = qMin<std::uint64_t>(toDiscard, size);
+        toDiscard -= dropped;
+        data += dropped;
+        size -= dropped;
+    }
+    if (!size) {
+        return;
+    }
+    if (bufferOffset && bufferOffset >= buffer.size() / 2) {
+        buffer.remove(0, bufferOffset); // keep it from growing
+        bufferOffset = 0;
+    }
+    buffer.append(data, int(size));
+}
+
+void InputReactorBase::finish(Status status)
+{
+    if (!finished) {
+        finished     = true;
+        finishStatus = status;
+    }
+}
+
+void InputReactorBase::reportClosed(Status status)
+{
+    if (closed) {
+        return;
+    }
+    reset();
+    closedCallback(status);
+}
+
+void InputReactorBase::updateInterest()
+{
+    if (fd < 0 || regular) {
+        return;
+    }
+    bool want = !finished && (waitWritable || bytesAvailable() < MAX_BUFFERED);
+    if (want) {
+        std::uint32_t events = waitWritable ? EPOLLOUT : EPOLLIN;
+        if (!watched) {
+            watched = reactor.add(fd, events, this);
+        } else if (events != watchedEvents) {
+            reactor.modify(fd, events, this);
+        }
+        watchedEvents = events;
+    } else if (watched) {
+        // removed rather than muted. hang ups are reported even without interest
+        reactor.remove(fd, this);
+        watched = false;
+    }
+}
+
+} // namespace unboxer
@@ -0,0 +1,105 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "reactor.h"
+#include "status.h"
+#include "unboxer_export.h"
+
+#include <QByteArray>
+
+#include <functional>
+
+namespace unboxer {
+
+/**
+ * @brief Common part of the sources driven by a Reactor: a non-blocking descriptor and a bounded buffer.
+ *
+ * The descriptor is watched only while the buffer has room, so a slow consumer makes the kernel (and TCP flow
+ * control) hold the rest instead of memory. Regular files can't be watched. They are read directly in read() and are
+ * always ready, their bytesAvailable() is the rest of the file. Data ready notifications are delivered from the reactor, never from read() itself.
+ */
+class UNBOXER_EXPORT InputReactorBase : public ReactorHandler {
+public:
+    static constexpr std::size_t MAX_BUFFERED = 1024 * 1024;
+    static constexpr std::size_t READ_CHUNK   = 64 * 1024;
+
+    InputReactorBase(std::function<void()>                   &&openedCallback,
+                     std::function<void()>                   &&dataReadyCallback,
+                     std::function<void(const QByteArray &)> &&dataReadCallback,
+                     std::function<void(Status)>             &&closedCallback);
+    ~InputReactorBase() override;
+
+    void        read(std::size_t size);
+    void        reset();
+    bool        skip(std::uint64_t size);
+    std::size_t bytesAvailable() const;
+
+    void onReactorEvents(std::uint32_t events) override;
+
+protected:
+    // takes ownership of a non-blocking descriptor. false if it can't be used. restoreFlags, if not -1, are file status
+    // flags put back before it's closed, when it shares the open file description with the caller's one (dup())
+    bool attach(int fd, int restoreFlags = -1);
+    // raw bytes read from the descriptor. the default puts them to the buffer as is
+    virtual void consume(const char *data, std::size_t size);
+    // the descriptor reached its end. the default finishes with Eof
+    virtual void onEof();
+    // the descriptor is ready (connected sockets). the default reads it
+    virtual void onReady(std::uint32_t events);
+
+    void append(const char *data, std::size_t size);
+    // no more data will come. what's buffered is still delivered
+    void finish(Status status);
+    bool isFinished() const { return finished; }
+    void reportClosed(Status status);
+    void updateInterest();
+
+    Reactor                                &reactor;
+    int                                     fd = -1;
+    std::function<void()>                   openedCallback;
+    std::function<void()>                   dataReadyCallback;
+    std::function<void(const QByteArray &)> dataReadCallback;
+    std::function<void(Status)>             closedCallback;
+
+    bool waitWritable = false; // the descriptor is watched for EPOLLOUT instead of EPOLLIN
+
+private:
+    void readFd();
+    void readRegular(std::size_t size);
+
+    QByteArray    buffer;
+    int           bufferOffset  = 0;
+    std::uint64_t toDiscard     = 0; // skipped bytes which aren't received yet
+    bool          regular       = false;
+    bool          watched       = false;
+    std::uint32_t watchedEvents = 0;
+    bool          finished      = false;
+    bool          closed        = false;
+    Status        finishStatus  = Status::Eof;
+    int           restoreFlags  = -1;
+};
+
+} // namespace unboxer
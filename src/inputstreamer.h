@@ -27,6 +27,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "cacher.h"
 #include "input.h"
 #include "status.h"
+#include "trace.h"
 
 #include <QByteArray>
 
@@ -70,11 +71,13 @@ public:
     using ClosedCallback    = std::function<void(Status)>;
     using DataReadyCallback = std::function<void()>;
 
-    InputStreamer(const std::string &inputUri,
+    // sourceArg is passed to InputImpl's constructor. usually an uri
+    template <class SourceArg>
+    InputStreamer(SourceArg        &&sourceArg,
                   OpenedCallback   &&openedCallback,
                   DataReadCallback &&dataReadCallback,
                   ClosedCallback   &&closedCallback) :
-        source(inputUri,
+        source(std::forward<SourceArg>(sourceArg),
                std::bind(&InputStreamer::onStreamOpened, this),
                std::bind(&InputStreamer::onDataReady, this),
                std::bind(&InputStreamer::onDataRead, this, std::placeholders::_1),
@@ -84,10 +87,17 @@ public:
     {
     }
 
-    void        open() { source.open(); }
-    void        read(std::size_t size) { source.read(size); }
-    void        setDataReadyCallback(DataReadyCallback &&callback) { dataReadyCallback = std::move(callback); }
-    std::size_t bytesAvailable() const { return source.bytesAvailable(); }
+    void          open() { source.open(); }
+    void          read(std::size_t size)
+    {
+        UNBOXER_TRACE_SPAN("source read");
+        source.read(size);
+    }
+    void          setDataReadyCallback(DataReadyCallback &&callback) { dataReadyCallback = std::move(callback); }
+    bool          skip(std::uint64_t size) { return source.skip(size); }
+    std::size_t   bytesAvailable() const { return source.bytesAvailable(); }
+    std::uint64_t bytesRead() const { return bytesRead_; }
+    InputImpl    &input() { return source.get(); } // for source specific settings
 
 private:
     void onStreamOpened() { openedCallback(); }
@@ -99,10 +109,13 @@ private:
     }
     void onDataRead(const QByteArray &data)
     {
-        if (dataReadCallback(data) != Status::Ok) {
+        bytesRead_ += data.size();
+        UNBOXER_TRACE_COUNTER("bytes read", bytesRead_);
+        auto status = dataReadCallback(data);
+        if (status != Status::Ok) {
             source.reset();
             cacher.reset();
-            closedCallback(Status::Corrupted);
+            closedCallback(status);
         }
     }
     void onStreamClosed(Status reason) { closedCallback(reason); }
@@ -115,6 +128,7 @@ private:
     DataReadCallback  dataReadCallback;
     ClosedCallback    closedCallback;
     DataReadyCallback dataReadyCallback;
+    std::uint64_t     bytesRead_ = 0;
 };
 
 }
@@ -0,0 +1,176 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "reactor.h"
+
+#include <algorithm>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace unboxer {
+
+Reactor::Reactor() : epollFd(::epoll_create1(EPOLL_CLOEXEC)), wakeFd(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+{
+    epoll_event event {};
+    event.events   = EPOLLIN;
+    event.data.ptr = nullptr; // the wake up descriptor
+    ::epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+}
+
+Reactor::~Reactor()
+{
+    ::close(wakeFd);
+    ::close(epollFd);
+}
+
+Reactor &Reactor::threadLocal()
+{
+    static thread_local Reactor reactor;
+    return reactor;
+}
+
+bool Reactor::add(int fd, std::uint32_t events, ReactorHandler *handler)
+{
+    epoll_event event {};
+    event.events   = events;
+    event.data.ptr = handler;
+    return ::epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) == 0;
+}
+
+bool Reactor::modify(int fd, std::uint32_t events, ReactorHandler *handler)
+{
+    epoll_event event {};
+    event.events   = events;
+    event.data.ptr = handler;
+    return ::epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event) == 0;
+}
+
+void Reactor::remove(int fd, ReactorHandler *handler)
+{
+    ::epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    // events for the descriptor could be already fetched in this iteration
+    removed.push_back(handler);
+}
+
+void Reactor::schedule(ReactorHandler *handler)
+{
+    if (!handler->scheduled) {
+        handler->scheduled = true;
+        scheduled.push_back(handler);
+    }
+}
+
+void Reactor::cancel(ReactorHandler *handler)
+{
+    if (handler->scheduled) {
+        handler->scheduled = false;
+        scheduled.erase(std::remove(scheduled.begin(), scheduled.end(), handler), scheduled.end());
+    }
+    removed.push_back(handler);
+    cancelled.push_back(handler);
+}
+
+void Reactor::post(std::function<void()> &&fn)
+{
+    {
+        std::lock_guard<std::mutex> lock(postedMutex);
+        posted.push_back(std::move(fn));
+    }
+    hasPosted = true;
+    std::uint64_t one = 1;
+    [[maybe_unused]] auto written = ::write(wakeFd, &one, sizeof(one));
+}
+
+bool Reactor::contains(const std::vector<ReactorHandler *> &handlers, ReactorHandler *handler)
+{
+    return std::find(handlers.begin(), handlers.end(), handler) != handlers.end();
+}
+
+int Reactor::runOnce(int timeoutMs)
+{
+    if (!scheduled.empty() || hasPosted) {
+        timeoutMs = 0;
+    }
+    removed.clear();
+    cancelled.clear();
+
+    constexpr int maxEvents = 256;
+    epoll_event   events[maxEvents];
+    int           count   = ::epoll_wait(epollFd, events, maxEvents, timeoutMs);
+    int           handled = 0;
+    for (int i = 0; i < count; i++) {
+        auto handler = static_cast<ReactorHandler *>(events[i].data.ptr);
+        if (!handler) {
+            std::uint64_t value;
+            [[maybe_unused]] auto size = ::read(wakeFd, &value, sizeof(value));
+            continue;
+        }
+        if (!contains(removed, handler)) {
+            handler->onReactorEvents(events[i].events);
+            handled++;
+        }
+    }
+
+    // handlers scheduled from here are called on the next iteration
+    running.swap(scheduled);
+    for (std::size_t i = 0; i < running.size(); i++) {
+        auto handler = running[i];
+        if (!contains(cancelled, handler)) {
+            handler->scheduled = false;
+            handler->onReactorEvents(0);
+            handled++;
+        }
+    }
+    running.clear();
+
+    if (hasPosted.exchange(false)) {
+        std::vector<std::function<void()>> calls;
+        {
+            std::lock_guard<std::mutex> lock(postedMutex);
+            calls.swap(posted);
+        }
+        for (auto &call : calls) {
+            call();
+        }
+    }
+    return handled;
+}
+
+void Reactor::run()
+{
+    while (!stopping.exchange(false)) {
+        runOnce(-1);
+    }
+}
+
+void Reactor::stop()
+{
+    stopping          = true;
+    std::uint64_t one = 1;
+    [[maybe_unused]] auto written = ::write(wakeFd, &one, sizeof(one));
+}
+
+}
@@ -0,0 +1,105 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "unboxer_export.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace unboxer {
+
+class Reactor;
+
+// receives notifications from a Reactor
+class UNBOXER_EXPORT ReactorHandler {
+public:
+    virtual ~ReactorHandler() = default;
+
+    // events is a mask of EPOLLIN, EPOLLOUT, EPOLLERR and EPOLLHUP, or 0 for a call made with Reactor::schedule()
+    virtual void onReactorEvents(std::uint32_t events) = 0;
+
+private:
+    friend class Reactor;
+    bool scheduled = false;
+};
+
+/**
+ * @brief Minimal epoll based event loop for the Qt-free sources (InputFdImpl, InputPlainHttpImpl).
+ *
+ * One reactor drives any number of streams on its thread. Every thread has its own, see threadLocal(), so a few
+ * threads each calling run() can serve thousands of streams. Everything but post() and stop() has to be called from
+ * the reactor's thread. Descriptors are level triggered.
+ */
+class UNBOXER_EXPORT Reactor {
+public:
+    Reactor();
+    ~Reactor();
+
+    Reactor(const Reactor &)            = delete;
+    Reactor &operator=(const Reactor &) = delete;
+
+    // the reactor of the calling thread. created on first use
+    static Reactor &threadLocal();
+
+    bool add(int fd, std::uint32_t events, ReactorHandler *handler);
+    bool modify(int fd, std::uint32_t events, ReactorHandler *handler);
+    void remove(int fd, ReactorHandler *handler);
+
+    // handler->onReactorEvents(0) on the next iteration. Scheduling it again before that has no effect
+    void schedule(ReactorHandler *handler);
+    // drop everything pending for the handler. has to be called before the handler is destroyed
+    void cancel(ReactorHandler *handler);
+
+    // fn is called on the reactor's thread. thread safe
+    void post(std::function<void()> &&fn);
+
+    // waits up to timeoutMs (-1 - forever) and handles what's ready. returns the number of notified handlers
+    int runOnce(int timeoutMs = -1);
+    // runs till stop()
+    void run();
+    // thread safe
+    void stop();
+
+private:
+    static bool contains(const std::vector<ReactorHandler *> &handlers, ReactorHandler *handler);
+
+    int                           epollFd = -1;
+    int                           wakeFd  = -1; // eventfd for post() and stop()
+    std::vector<ReactorHandler *> scheduled;
+    std::vector<ReactorHandler *> running;   // scheduled handlers being called now
+    std::vector<ReactorHandler *> removed;   // descriptors removed during the current iteration
+    std::vector<ReactorHandler *> cancelled; // during the current iteration
+    std::atomic<bool>             stopping { false };
+
+    std::mutex                         postedMutex;
+    std::vector<std::function<void()>> posted;
+    std::atomic<bool>                  hasPosted { false };
+};
+
+}
@@ -0,0 +1,98 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <QByteArray>
+
+#include <cstdint>
+
+namespace unboxer {
+
+// true if the array doesn't own its data, i.e. it was made with QByteArray::fromRawData()
+inline bool isRawData(const QByteArray &array)
+{
+    return !array.isEmpty() && const_cast<QByteArray &>(array).data_ptr()->alloc == 0;
+}
+
+/**
+ * @brief A part of a buffer which keeps the whole buffer alive.
+ *
+ * QByteArray can't share a part of another array, so the box reader hands out raw slices valid only during
+ * a callback. A Slice holds a reference to the owning buffer instead, so it can be passed to another thread
+ * without copying the data.
+ */
+class Slice {
+public:
+    Slice() = default;
+    // the owner has to own its data (see isRawData)
+    Slice(const QByteArray &owner, const char *data, int size) : owner(owner), ptr(data), size_(size)
+    {
+        Q_ASSERT(!isRawData(owner));
+        Q_ASSERT(data >= owner.constData() && data + size <= owner.constData() + owner.size());
+    }
+    explicit Slice(const QByteArray &owner) : Slice(owner, owner.constData(), owner.size()) { }
+
+    // raw view. valid while this slice is alive
+    QByteArray data() const { return QByteArray::fromRawData(ptr, size_); }
+    int        size() const { return size_; }
+
+private:
+    QByteArray  owner;
+    const char *ptr   = nullptr;
+    int         size_ = 0;
+};
+
+/**
+ * @brief Makes Slices of the data passed to BoxReader's DataReadCallback.
+ *
+ * Raw buffers (see isRawData) are copied once per feed and sliced from the copy, everything else is shared.
+ */
+class BufferSlicer {
+public:
+    // buffer and generation are BoxReader::buffer() and BoxReader::bufferGeneration() at the time of the callback
+    Slice slice(const QByteArray &buffer, std::uint64_t generation, const QByteArray &data)
+    {
+        auto begin = buffer.constData();
+        if (data.constData() < begin || data.constData() + data.size() > begin + buffer.size()) {
+            return Slice(QByteArray(data.constData(), data.size())); // not from the buffer. never happens
+        }
+        if (isRawData(buffer)) {
+            // nothing keeps raw data alive. copy the whole buffer once and slice the copy. the next raw buffer may
+            // get the same address, so only the generation tells if the copy is still the same data
+            if (rawCopy.isEmpty() || rawGeneration != generation) {
+                rawCopy       = QByteArray(begin, buffer.size());
+                rawGeneration = generation;
+            }
+            return Slice(rawCopy, rawCopy.constData() + (data.constData() - begin), data.size());
+        }
+        return Slice(buffer, data.constData(), data.size());
+    }
+
+private:
+    QByteArray    rawCopy; // of the last raw buffer
+    std::uint64_t rawGeneration = 0;
+};
+
+}
@@ -0,0 +1,91 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace unboxer {
+
+/**
+ * @brief Bounded lock-free queue for exactly one producer thread and one consumer thread.
+ *
+ * Neither side ever blocks here. Waiting for space or items is up to the user, see ThreadedUnboxer.
+ */
+template <class T> class SpscQueue {
+public:
+    explicit SpscQueue(std::size_t capacity) : ring(roundUp(capacity)), mask(ring.size() - 1) { }
+
+    SpscQueue(const SpscQueue &)            = delete;
+    SpscQueue &operator=(const SpscQueue &) = delete;
+
+    // producer side. false if the queue is full
+    bool tryPush(T &&item)
+    {
+        auto tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_seq_cst) == ring.size()) {
+            return false;
+        }
+        ring[tail & mask] = std::move(item);
+        tail_.store(tail + 1, std::memory_order_seq_cst);
+        return true;
+    }
+
+    // consumer side. false if the queue is empty
+    bool tryPop(T &item)
+    {
+        auto head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_seq_cst)) {
+            return false;
+        }
+        item              = std::move(ring[head & mask]);
+        ring[head & mask] = T {}; // don't keep anything alive in the slot
+        head_.store(head + 1, std::memory_order_seq_cst);
+        return true;
+    }
+
+    bool        isEmpty() const { return head_.load() == tail_.load(); }
+    std::size_t capacity() const { return ring.size(); }
+
+private:
+    static std::size_t roundUp(std::size_t capacity)
+    {
+        std::size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    std::vector<T>    ring;
+    const std::size_t mask;
+
+    // on separate cache lines, so the producer and the consumer don't invalidate each other's index
+    alignas(64) std::atomic<std::size_t> head_ { 0 }; // next to pop. written by the consumer
+    alignas(64) std::atomic<std::size_t> tail_ { 0 }; // next to push. written by the producer
+};
+
+}
@@ -0,0 +1,65 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace unboxer {
+
+/**
+ * @brief Parse statistics of one stream.
+ *
+ * Collected only when the library is built with ENABLE_STATS. Otherwise everything but bytesRead stays zero.
+ */
+struct ParseStats {
+    std::uint64_t bytesRead      = 0; // received from the source
+    std::uint64_t bytesFed       = 0; // passed to the box reader
+    std::uint64_t bytesDelivered = 0; // passed to onDataRead callbacks of the boxes
+    std::uint64_t bytesSkipped   = 0; // skipped by the source without reading
+    std::uint64_t bytesDamaged   = 0; // dropped to resynchronize after corruption, see Unboxer::setResyncCallback()
+
+    std::uint64_t                    boxesOpened = 0;
+    std::size_t                      maxDepth    = 0; // top level boxes have depth 1
+    QHash<QByteArray, std::uint64_t> boxesByType;
+
+    std::uint64_t bufferCopies   = 0; // times the reader had to copy input data into its own buffer
+    std::size_t   peakBufferSize = 0; // max size of the reader's buffer
+
+    std::chrono::nanoseconds parserTime { 0 };   // spent in the library itself
+    std::chrono::nanoseconds callbackTime { 0 }; // spent in the library user's callbacks
+};
+
+}
+
+#ifdef UNBOXER_WITH_STATS
+#define UNBOXER_STAT(expr) expr
+#else
+#define UNBOXER_STAT(expr)
+#endif
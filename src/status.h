@@ -26,6 +26,6 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 namespace unboxer {
 
-enum Status { Ok, NeedMoreData, Eof, Timeout, Corrupted, SourceNotExist };
+enum Status { Ok, NeedMoreData, Eof, Timeout, Corrupted, SourceNotExist, BudgetExceeded, WriteFailed };
 
 }
@@ -0,0 +1,120 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "syncscanner.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define UNBOXER_SSE2
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace unboxer {
+
+namespace {
+    std::uint32_t fourcc(const char *data)
+    {
+        std::uint32_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+#ifdef UNBOXER_SSE2
+    int lowestBit(unsigned mask)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return int(index);
+#else
+        return __builtin_ctz(mask);
+#endif
+    }
+#endif
+}
+
+std::vector<QByteArray> SyncScanner::defaultTypes()
+{
+    return { "moof", "mdat", "styp", "sidx", "ftyp", "moov", "emsg", "prft", "mfra" };
+}
+
+SyncScanner::SyncScanner(const std::vector<QByteArray> &types)
+{
+    for (auto const &type : types) {
+        if (type.size() != 4) {
+            continue;
+        }
+        this->types.push_back(fourcc(type.constData()));
+        if (std::find(firstBytes.begin(), firstBytes.end(), type[0]) == firstBytes.end()) {
+            firstBytes.push_back(type[0]);
+        }
+    }
+}
+
+bool SyncScanner::matches(const char *data) const
+{
+    auto value = fourcc(data);
+    return std::find(types.begin(), types.end(), value) != types.end();
+}
+
+std::size_t SyncScanner::findType(const char *data, std::size_t size) const
+{
+    if (size < 4 || types.empty()) {
+        return npos;
+    }
+    auto        end = size - 3; // positions a type may start at
+    std::size_t i   = 0;
+#ifdef UNBOXER_SSE2
+    // a bit per position which starts with the first byte of any type. only those are compared as a whole
+    while (i + 16 <= end) {
+        auto block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        auto hits  = _mm_setzero_si128();
+        for (auto c : firstBytes) {
+            hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, _mm_set1_epi8(c)));
+        }
+        auto mask = unsigned(_mm_movemask_epi8(hits));
+        while (mask) {
+            auto position = i + lowestBit(mask);
+            if (matches(data + position)) {
+                return position;
+            }
+            mask &= mask - 1;
+        }
+        i += 16;
+    }
+#endif
+    for (; i < end; i++) {
+        if (matches(data + i)) {
+            return i;
+        }
+    }
+    return npos;
+}
+
+} // namespace unboxer
@@ -0,0 +1,60 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "unboxer_export.h"
+
+#include <QByteArray>
+
+#include <cstdint>
+#include <vector>
+
+namespace unboxer {
+
+/**
+ * @brief Finds box types in damaged data to resume parsing there.
+ *
+ * Looks for any of a few four character codes, 16 positions at a time where SSE2 is available.
+ */
+class UNBOXER_EXPORT SyncScanner {
+public:
+    static constexpr std::size_t npos = std::size_t(-1);
+
+    // top level types of fragmented and progressive files
+    static std::vector<QByteArray> defaultTypes();
+
+    explicit SyncScanner(const std::vector<QByteArray> &types = defaultTypes());
+
+    // position of the first of the types in data, or npos
+    std::size_t findType(const char *data, std::size_t size) const;
+
+private:
+    bool matches(const char *data) const;
+
+    std::vector<std::uint32_t> types;      // in memory order, to compare as integers
+    std::vector<char>          firstBytes; // distinct
+};
+
+} // namespace unboxer
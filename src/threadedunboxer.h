@@ -0,0 +1,330 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "slice.h"
+#include "spscqueue.h"
+#include "unboxer.h"
+
+#include <QObject>
+#include <QThread>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+namespace unboxer {
+
+/**
+ * @brief Unboxer running the source and the parser on a worker thread.
+ *
+ * The API is the same as Unboxer's, but the callbacks are called on the thread which created the object (it needs
+ * an event loop) while I/O and parsing go on in parallel. Events go through a bounded lock-free queue and carry
+ * data as Slices of the reader's buffers, so the payload isn't copied on the way (except for sources giving raw
+ * data, which are copied once per read). When the consumer lags and the queue is full the worker waits.
+ *
+ * Since the worker can't wait for the consumer's decisions, what to recurse into or to skip is decided by
+ * containers() and setSelection() only. Changing Box::isContainer in the callbacks has no effect.
+ * Returning an error from onDataRead stops the stream, though some already queued events are dropped then.
+ */
+template <class Source, class Cache> class ThreadedUnboxer {
+public:
+    static constexpr std::size_t DEFAULT_READ_SIZE      = 64 * 1024;
+    static constexpr std::size_t DEFAULT_QUEUE_CAPACITY = 1024; // events
+    static constexpr int         MAX_DISPATCH_BATCH     = 256;  // events handled before yielding to the event loop
+
+    // source is what Source is made of, see Unboxer. it's copied to the worker
+    template <class SourceArg>
+    ThreadedUnboxer(SourceArg        &&source,
+                    ContainerRegistry  containers    = ContainerRegistry::isoBmff(),
+                    std::size_t        readSize      = DEFAULT_READ_SIZE,
+                    std::size_t        queueCapacity = DEFAULT_QUEUE_CAPACITY) :
+        makeUnboxer([source = std::decay_t<SourceArg>(std::forward<SourceArg>(source))](ContainerRegistry &&containers) {
+            return std::make_unique<Unboxer<Source, Cache>>(source, std::move(containers));
+        }),
+        containers_(std::move(containers)), readSize(readSize), queue(queueCapacity)
+    {
+        workerContext = new QObject;
+        workerContext->moveToThread(&thread);
+    }
+
+    ~ThreadedUnboxer()
+    {
+        stopping = true;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            spaceAvailable.notify_one();
+        }
+        if (thread.isRunning()) {
+            // sources may have thread affine objects, e.g. network replies
+            QMetaObject::invokeMethod(
+                workerContext, [this]() { unboxer.reset(); }, Qt::BlockingQueuedConnection);
+            thread.quit();
+            thread.wait();
+        }
+        delete workerContext;
+    }
+
+    ThreadedUnboxer(const ThreadedUnboxer &)            = delete;
+    ThreadedUnboxer &operator=(const ThreadedUnboxer &) = delete;
+
+    // everything has to be set before open()
+    void setStreamOpenedCallback(UnboxerImpl::StreamOpenedCallback &&callback)
+    {
+        streamOpenedCallback = std::move(callback);
+    }
+    void setStreamClosedCallback(UnboxerImpl::StreamClosedCallback &&callback)
+    {
+        streamClosedCallback = std::move(callback);
+    }
+    bool setSelection(const std::vector<QByteArray> &patterns, UnboxerImpl::BoxSelectedCallback &&callback)
+    {
+        selection           = patterns;
+        boxSelectedCallback = std::move(callback);
+        return BoxSelector().setPatterns(patterns);
+    }
+    void               setBudget(const ParseBudget &budget) { this->budget = budget; }
+    void               setHashing(int algorithms) { hashAlgorithms = algorithms; } // on the worker thread
+    ContainerRegistry &containers() { return containers_; }
+
+    // starts the worker. the stream is opened and read till the end there
+    void open()
+    {
+        thread.start();
+        QMetaObject::invokeMethod(workerContext, [this]() { startWorker(); }, Qt::QueuedConnection);
+    }
+
+private:
+    struct Event {
+        enum Type : std::uint8_t { StreamOpened, BoxOpened, BoxSelected, Data, BoxClosed, StreamClosed };
+
+        Type          type = StreamOpened;
+        Status        status = Status::Ok;
+        bool          isContainer = false;
+        std::uint32_t headerSize   = 0;
+        std::uint32_t preambleSize = 0;
+        std::uint64_t size         = 0;
+        std::uint64_t fileOffset   = 0;
+        QByteArray    boxType;
+        Slice         data;
+        BoxDigest     digest; // BoxClosed
+    };
+
+    // worker thread
+
+    void startWorker()
+    {
+        unboxer = makeUnboxer(std::move(containers_));
+        unboxer->setBudget(budget);
+        unboxer->setHashing(hashAlgorithms);
+        if (!selection.empty()) {
+            unboxer->setSelection(selection, [this](Box::Ptr) { push(Event { Event::BoxSelected }); });
+        }
+        unboxer->setStreamOpenedCallback([this](Box::Ptr root) {
+            push(Event { Event::StreamOpened });
+            root->onSubBoxOpen = [this](Box::Ptr box) { forwardBox(box); };
+            postRead();
+        });
+        unboxer->setStreamClosedCallback([this](Status reason) {
+            Event event { Event::StreamClosed };
+            event.status = reason;
+            push(std::move(event));
+        });
+        // sources call it right from read(). don't go deeper in the stack for every chunk
+        unboxer->stream().setDataReadyCallback([this]() { postRead(); });
+        unboxer->open();
+    }
+
+    void postRead()
+    {
+        QMetaObject::invokeMethod(
+            workerContext,
+            [this]() {
+                if (unboxer && !stopping) {
+                    unboxer->read(readSize);
+                }
+            },
+            Qt::QueuedConnection);
+    }
+
+    void forwardBox(Box::Ptr box)
+    {
+        Event event { Event::BoxOpened };
+        event.isContainer  = box->isContainer;
+        event.headerSize   = box->headerSize;
+        event.preambleSize = box->preambleSize;
+        event.size         = box->size;
+        event.fileOffset   = box->fileOffset;
+        event.boxType      = box->type;
+        push(std::move(event));
+
+        box->onSubBoxOpen = [this](Box::Ptr subBox) { forwardBox(subBox); };
+        box->onDataRead   = [this](const QByteArray &data) {
+            auto const &reader = unboxer->impl->reader;
+            Event       event { Event::Data };
+            event.data = slicer.slice(reader.buffer(), reader.bufferGeneration(), data);
+            push(std::move(event));
+            return consumerStatus.load();
+        };
+        box->onClose = [this, box = box.get()]() {
+            Event event { Event::BoxClosed };
+            event.digest = box->digest;
+            push(std::move(event));
+            return Status::Ok;
+        };
+    }
+
+    void push(Event &&event)
+    {
+        if (!queue.tryPush(std::move(event))) {
+            std::unique_lock<std::mutex> lock(mutex);
+            producerWaiting = true;
+            spaceAvailable.wait(lock, [&]() { return stopping || queue.tryPush(std::move(event)); });
+            producerWaiting = false;
+        }
+        if (consumerIdle.exchange(false)) {
+            QMetaObject::invokeMethod(&consumerContext, [this]() { dispatch(); }, Qt::QueuedConnection);
+        }
+    }
+
+    // consumer thread
+
+    void dispatch()
+    {
+        for (int handled = 0; handled < MAX_DISPATCH_BATCH; handled++) {
+            Event event;
+            if (!queue.tryPop(event)) {
+                consumerIdle = true;
+                // the producer could push right before the flag was set and not post anything
+                if (queue.isEmpty() || !consumerIdle.exchange(false)) {
+                    return;
+                }
+                continue;
+            }
+            if (producerWaiting) {
+                std::lock_guard<std::mutex> lock(mutex);
+                spaceAvailable.notify_one();
+            }
+            handle(event);
+        }
+        QMetaObject::invokeMethod(&consumerContext, [this]() { dispatch(); }, Qt::QueuedConnection);
+    }
+
+    void handle(Event &event)
+    {
+        if (event.type == Event::StreamClosed) {
+            boxes.clear();
+            if (streamClosedCallback) {
+                streamClosedCallback(consumerStatus != Status::Ok ? consumerStatus.load() : event.status);
+            }
+            return;
+        }
+        if (consumerStatus != Status::Ok) {
+            return; // the consumer stopped the stream. waiting for the worker to close it
+        }
+        switch (event.type) {
+        case Event::StreamOpened:
+            boxes.assign(1, std::make_shared<Box>(true));
+            if (streamOpenedCallback) {
+                streamOpenedCallback(boxes.back());
+            }
+            break;
+        case Event::BoxOpened: {
+            auto box          = std::make_shared<Box>(event.isContainer, event.boxType, event.size, event.fileOffset);
+            box->headerSize   = event.headerSize;
+            box->preambleSize = event.preambleSize;
+            auto parent       = boxes.back();
+            boxes.push_back(box);
+            if (parent->onSubBoxOpen) {
+                parent->onSubBoxOpen(box);
+            }
+            break;
+        }
+        case Event::BoxSelected:
+            if (boxSelectedCallback) {
+                boxSelectedCallback(boxes.back());
+            }
+            break;
+        case Event::Data: {
+            auto const &box = boxes.back();
+            box->dataFed_ += event.data.size();
+            if (box->onDataRead) {
+                auto status = box->onDataRead(event.data.data());
+                if (status != Status::Ok) {
+                    consumerStatus = status;
+                }
+            }
+            break;
+        }
+        case Event::BoxClosed: {
+            auto box       = boxes.back();
+            box->isClosed_ = true;
+            box->digest    = std::move(event.digest);
+            boxes.pop_back();
+            if (box->onClose) {
+                box->onClose();
+            }
+            break;
+        }
+        case Event::StreamClosed:
+            break;
+        }
+    }
+
+private:
+    using UnboxerFactory = std::function<std::unique_ptr<Unboxer<Source, Cache>>(ContainerRegistry &&)>;
+
+    // set before open(). read by the worker
+    UnboxerFactory                   makeUnboxer; // keeps a copy of the source argument
+    ContainerRegistry                containers_;
+    std::size_t                      readSize;
+    ParseBudget                      budget;
+    int                              hashAlgorithms = NoHash;
+    std::vector<QByteArray>          selection;
+    UnboxerImpl::BoxSelectedCallback boxSelectedCallback;
+    UnboxerImpl::StreamOpenedCallback streamOpenedCallback;
+    UnboxerImpl::StreamClosedCallback streamClosedCallback;
+
+    // worker
+    QThread                                 thread;
+    QObject                                *workerContext = nullptr;
+    std::unique_ptr<Unboxer<Source, Cache>> unboxer;
+    BufferSlicer                            slicer;
+
+    // shared
+    SpscQueue<Event>        queue;
+    std::mutex              mutex; // only to wait for space in the queue
+    std::condition_variable spaceAvailable;
+    std::atomic<bool>       producerWaiting { false };
+    std::atomic<bool>       consumerIdle { true };
+    std::atomic<bool>       stopping { false };
+    std::atomic<Status>     consumerStatus { Status::Ok };
+
+    // consumer
+    QObject               consumerContext;
+    std::vector<Box::Ptr> boxes;
+};
+
+}
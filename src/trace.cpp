@@ -0,0 +1,184 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "trace.h"
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QMutex>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace unboxer::trace {
+
+namespace {
+
+    constexpr std::size_t BLOCK_SIZE            = 4096;
+    constexpr std::size_t MAX_EVENTS_PER_THREAD = 1024 * 1024; // ~32MB. the rest is dropped
+
+    struct Event {
+        const char  *name;
+        std::int64_t ts;    // ns since epoch
+        std::int64_t value; // duration for spans, value for counters
+        char         phase; // 'X' - complete span, 'C' - counter
+    };
+
+    struct Block {
+        Event                events[BLOCK_SIZE];
+        std::atomic<Block *> next { nullptr };
+    };
+
+    // written only by its thread. readers see events published with `size`
+    class ThreadBuffer {
+    public:
+        explicit ThreadBuffer(int tid) : tid(tid), head(new Block), tail(head) { }
+        ~ThreadBuffer()
+        {
+            while (head) {
+                delete std::exchange(head, head->next.load());
+            }
+        }
+
+        void append(const Event &event)
+        {
+            auto count = size.load(std::memory_order_relaxed);
+            if (count == MAX_EVENTS_PER_THREAD) {
+                return;
+            }
+            if (count && count % BLOCK_SIZE == 0) {
+                auto block = new Block;
+                tail->next.store(block, std::memory_order_release);
+                tail = block;
+            }
+            tail->events[count % BLOCK_SIZE] = event;
+            size.store(count + 1, std::memory_order_release);
+        }
+
+        template <typename Func> void forEach(Func &&func) const
+        {
+            auto count = size.load(std::memory_order_acquire);
+            auto block = head;
+            for (std::size_t i = 0; i < count; i++) {
+                if (i && i % BLOCK_SIZE == 0) {
+                    block = block->next.load(std::memory_order_acquire);
+                }
+                func(block->events[i % BLOCK_SIZE]);
+            }
+        }
+
+        const int tid;
+
+    private:
+        Block                   *head;
+        Block                   *tail;
+        std::atomic<std::size_t> size { 0 };
+    };
+
+    struct Registry {
+        std::atomic<bool>                          enabled { false };
+        std::chrono::steady_clock::time_point      epoch = std::chrono::steady_clock::now();
+        QMutex                                     mutex; // guards only the list. never taken on recording
+        std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    };
+
+    Registry &registry()
+    {
+        static Registry instance;
+        return instance;
+    }
+
+    ThreadBuffer &threadBuffer()
+    {
+        thread_local std::shared_ptr<ThreadBuffer> buffer = []() {
+            auto       &r = registry();
+            QMutexLocker locker(&r.mutex);
+            r.buffers.push_back(std::make_shared<ThreadBuffer>(int(r.buffers.size()) + 1));
+            return r.buffers.back();
+        }();
+        return *buffer;
+    }
+
+}
+
+bool isAvailable()
+{
+#ifdef UNBOXER_WITH_TRACING
+    return true;
+#else
+    return false;
+#endif
+}
+
+void setEnabled(bool enabled) { registry().enabled.store(enabled, std::memory_order_relaxed); }
+
+bool isEnabled() { return registry().enabled.load(std::memory_order_relaxed); }
+
+std::int64_t now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - registry().epoch)
+        .count();
+}
+
+void complete(const char *name, std::int64_t start) { threadBuffer().append({ name, start, now() - start, 'X' }); }
+
+void counter(const char *name, std::int64_t value) { threadBuffer().append({ name, now(), value, 'C' }); }
+
+bool exportChromeJson(QIODevice *device)
+{
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    {
+        auto        &r = registry();
+        QMutexLocker locker(&r.mutex);
+        buffers = r.buffers;
+    }
+
+    auto micros = [](std::int64_t ns) { return QByteArray::number(double(ns) / 1000, 'f', 3); };
+
+    QByteArray json("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    bool       first = true;
+    for (auto const &buffer : buffers) {
+        auto common = ",\"pid\":1,\"tid\":" + QByteArray::number(buffer->tid);
+        buffer->forEach([&](const Event &event) {
+            json += first ? "\n{\"name\":\"" : ",\n{\"name\":\"";
+            first = false;
+            json += event.name;
+            json += "\",\"ph\":\"";
+            json += event.phase;
+            json += "\",\"ts\":" + micros(event.ts) + common;
+            if (event.phase == 'X') {
+                json += ",\"dur\":" + micros(event.value) + "}";
+            } else {
+                json += ",\"args\":{\"value\":" + QByteArray::number(qint64(event.value)) + "}}";
+            }
+        });
+    }
+    json += "\n]}\n";
+    return device->write(json) == json.size();
+}
+
+}
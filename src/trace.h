@@ -0,0 +1,94 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "unboxer_export.h"
+
+#include <cstdint>
+
+class QIODevice;
+
+namespace unboxer::trace {
+
+/*
+ Timeline of the parse in Chrome trace-event format (chrome://tracing, ui.perfetto.dev).
+
+ Events are recorded only if the library is built with ENABLE_TRACING and recording is switched on at runtime
+ with setEnabled(true). Every thread writes to its own buffer without locks; export may run concurrently and
+ takes whatever was recorded so far. Names have to be string literals since only pointers are stored.
+*/
+
+// true if the library itself was built with instrumentation
+UNBOXER_EXPORT bool isAvailable();
+
+UNBOXER_EXPORT void setEnabled(bool enabled);
+UNBOXER_EXPORT bool isEnabled();
+
+// nanoseconds since the trace epoch
+UNBOXER_EXPORT std::int64_t now();
+
+// record a span started at `start` (see now()) and ending now
+UNBOXER_EXPORT void complete(const char *name, std::int64_t start);
+UNBOXER_EXPORT void counter(const char *name, std::int64_t value);
+
+// write all the recorded events as Chrome trace JSON
+UNBOXER_EXPORT bool exportChromeJson(QIODevice *device);
+
+class Span {
+public:
+    explicit Span(const char *name) : name(name), start(isEnabled() ? now() : -1) { }
+    ~Span()
+    {
+        if (start >= 0) {
+            complete(name, start);
+        }
+    }
+
+    Span(const Span &)            = delete;
+    Span &operator=(const Span &) = delete;
+
+private:
+    const char  *name;
+    std::int64_t start;
+};
+
+}
+
+#ifdef UNBOXER_WITH_TRACING
+#define UNBOXER_TRACE_CONCAT_(a, b) a##b
+#define UNBOXER_TRACE_CONCAT(a, b) UNBOXER_TRACE_CONCAT_(a, b)
+#define UNBOXER_TRACE_SPAN(name) unboxer::trace::Span UNBOXER_TRACE_CONCAT(unboxerTraceSpan, __LINE__)(name)
+#define UNBOXER_TRACE_COUNTER(name, value)                                                                             \
+    do {                                                                                                               \
+        if (unboxer::trace::isEnabled()) {                                                                             \
+            unboxer::trace::counter(name, std::int64_t(value));                                                        \
+        }                                                                                                              \
+    } while (0)
+#else
+#define UNBOXER_TRACE_SPAN(name)
+#define UNBOXER_TRACE_COUNTER(name, value)                                                                             \
+    do {                                                                                                               \
+    } while (0)
+#endif
@@ -32,22 +32,42 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <QObject>
 
+#include <type_traits>
 #include <variant>
 
 namespace unboxer {
 
+template <class Source, class Cache> class ThreadedUnboxer;
+template <class Source, class Cache> class BoxEventStream;
+
 template <class Source, class Cache> class Unboxer {
 public:
     using StreamType = InputStreamer<Source, Cache>;
 
-    Unboxer(const std::string &uri, std::vector<QByteArray> &&containerTypes = { { "moof", "traf" } }) :
-        impl(std::make_unique<UnboxerImpl>(std::move(containerTypes))),
-        stream_(uri,
+    // source is what Source is made of: an uri for most of them, a MemoryBuffer for InputBufferImpl.
+    // all ISO BMFF containers are parsed. see ContainerRegistry::isoBmff()
+    template <class SourceArg, class = std::enable_if_t<!std::is_same_v<std::decay_t<SourceArg>, Unboxer>>>
+    Unboxer(SourceArg &&source) : Unboxer(std::forward<SourceArg>(source), ContainerRegistry::isoBmff())
+    {
+    }
+
+    // only the given types are containers
+    template <class SourceArg>
+    Unboxer(SourceArg &&source, std::vector<QByteArray> &&containerTypes) :
+        Unboxer(std::forward<SourceArg>(source), ContainerRegistry(containerTypes))
+    {
+    }
+
+    template <class SourceArg>
+    Unboxer(SourceArg &&source, ContainerRegistry containers) :
+        impl(std::make_unique<UnboxerImpl>(std::move(containers))),
+        stream_(std::forward<SourceArg>(source),
                 std::bind(&UnboxerImpl::onStreamOpened, impl.get()),
                 std::bind(&UnboxerImpl::onStreamDataRead, impl.get(), std::placeholders::_1),
                 std::bind(&UnboxerImpl::onStreamClosed, impl.get(), std::placeholders::_1))
 
     {
+        impl->reader.setSkipCallback([this](std::uint64_t size) { return stream_.skip(size); });
     }
 
     Unboxer(Unboxer &&other)      = delete;
@@ -57,18 +77,73 @@ public:
     {
         impl->streamOpenedCallback = std::move(callback);
     }
+    // Another consumer of the same parse. It gets its own root box and makes its own decisions: a box is parsed
+    // as a container if any consumer wants it, and consumers who took it as a blob get its raw payload anyway.
+    // Skipped if nobody needs the payload. All consumers get the same data slices. Has to be called before open().
+    void subscribe(UnboxerImpl::StreamOpenedCallback &&callback) { impl->subscribe(std::move(callback)); }
+
     void setStreamClosedCallback(UnboxerImpl::StreamClosedCallback &&callback)
     {
         impl->streamClosedCallback = std::move(callback);
     }
 
+    // containers of this parse. may be adjusted before open(), e.g. to add a custom container
+    ContainerRegistry &containers() { return impl->containers; }
+
+    // Deliver only boxes matching path patterns like "moov/trak/mdia/mdhd", "moof/*/trun" or "**/emsg".
+    // Selected boxes are passed to the callback right after their parent's onSubBoxOpen. Boxes on the way to them are
+    // parsed as usual and everything else is skipped, without even being read if the source can seek.
+    // Wildcards descend only into containers(). See BoxSelector for details. Has to be set before open().
+    // Returns false on a malformed pattern.
+    bool setSelection(const std::vector<QByteArray> &patterns, UnboxerImpl::BoxSelectedCallback &&callback)
+    {
+        impl->boxSelectedCallback = std::move(callback);
+        return impl->selector.setPatterns(patterns);
+    }
+
+    // Recover from damaged data instead of stopping with Status::Corrupted. All open boxes are closed on damage and
+    // parsing resumes at the next top level box of the types (moof, mdat, styp, sidx and so on by default). The
+    // callback gets every skipped range as file offset and size. Has to be set before open().
+    void setResyncCallback(BoxReader::ResyncCallback     &&callback,
+                           const std::vector<QByteArray> &types = SyncScanner::defaultTypes())
+    {
+        impl->reader.setResyncCallback(std::move(callback), types);
+    }
+
+    // Compute digests of blob payloads (HashAlgorithm flags) from the very slices given to onDataRead, so checksums
+    // come with the parse instead of another read of the output. Box::digest is set right before onClose. Boxes
+    // nobody reads, containers and the parts of containers delivered raw to some consumer are not hashed.
+    void setHashing(int algorithms) { impl->hashAlgorithms = algorithms; }
+
+    // Parser state at the last box boundary. Save it now and then, and if the parse is interrupted, e.g. the process is
+    // killed, pass it to resumeFrom() of another unboxer to go on from there. nullopt while recovering from damage.
+    std::optional<Checkpoint> checkpoint() const { return impl->reader.checkpoint(); }
+
+    // Start at the checkpoint instead of the beginning. Right after the stream is opened the containers open at the
+    // checkpoint are opened again through onSubBoxOpen, then parsing goes on at its offset. A source which can skip
+    // seeks there, others are read through without parsing. Has to be called before open().
+    void resumeFrom(const Checkpoint &checkpoint) { impl->resumePoint = checkpoint; }
+
+    // resource limits for the stream. has to be set before open()
+    void setBudget(const ParseBudget &budget) { impl->reader.setBudget(budget); }
+
+    // snapshot of the parse statistics. see ParseStats
+    ParseStats stats() const
+    {
+        auto stats      = impl->stats;
+        stats.bytesRead = stream_.bytesRead();
+        return stats;
+    }
+
     Box::Ptr    rootBox() const { return impl->rootBox(); }
     void        open() { stream_.open(); }
     void        read(std::size_t size) { stream_.read(size); }
     StreamType &stream() { return stream_; }
 
 private:
-private:
+    friend class ThreadedUnboxer<Source, Cache>;
+    friend class BoxEventStream<Source, Cache>;
+
     std::unique_ptr<UnboxerImpl> impl;
     StreamType                   stream_;
 };
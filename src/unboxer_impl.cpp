@@ -24,85 +24,255 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "unboxer_impl.h"
 
+#include "trace.h"
+
 #include <QVector>
 
 namespace unboxer {
 
-UnboxerImpl::UnboxerImpl(std::vector<QByteArray> &&containerTypes) :
-    containerTypes(std::move(containerTypes)), reader {
+#ifdef UNBOXER_WITH_STATS
+class ScopedTimer {
+public:
+    ScopedTimer(std::chrono::nanoseconds &total) : total(total), start(std::chrono::steady_clock::now()) { }
+    ~ScopedTimer() { total += std::chrono::steady_clock::now() - start; }
+
+private:
+    std::chrono::nanoseconds             &total;
+    std::chrono::steady_clock::time_point start;
+};
+#endif
+
+UnboxerImpl::UnboxerImpl(ContainerRegistry &&containers) :
+    containers(std::move(containers)), reader {
         std::bind(&UnboxerImpl::onBoxOpened, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3),
         std::bind(&UnboxerImpl::onBoxClosed, this),
         std::bind(&UnboxerImpl::onDataRead, this, std::placeholders::_1)
     }
 {
+    reader.setStats(&stats);
+    reader.setHeaderCallback([this](const QByteArray &header) { lastHeader = header; });
+}
+
+bool UnboxerImpl::statsEnabled()
+{
+#ifdef UNBOXER_WITH_STATS
+    return true;
+#else
+    return false;
+#endif
 }
 
 void UnboxerImpl::onStreamOpened()
 {
-    boxes.emplace_back(std::make_shared<Box>(true));
+    deferredStatus = Status::Ok;
+    auto &root     = nodes.emplace_back();
+    for (std::size_t i = 0; i <= subscribers.size(); i++) {
+        root.views.push_back({ std::make_shared<Box>(true) });
+    }
+    selectorStates.assign(1, selector.start());
+
+    UNBOXER_STAT(ScopedTimer timer(stats.callbackTime));
+    UNBOXER_TRACE_SPAN("streamOpened");
     if (streamOpenedCallback) {
-        streamOpenedCallback(boxes.back());
+        streamOpenedCallback(root.views[0].box);
+    }
+    for (std::size_t i = 0; i < subscribers.size(); i++) {
+        subscribers[i](root.views[i + 1].box);
+    }
+    if (resumePoint) {
+        reader.resume(*resumePoint); // the containers are opened for the consumers set up above
     }
 }
 
-Status UnboxerImpl::onStreamDataRead(const QByteArray &data) { return reader.feed(data); }
+Status UnboxerImpl::onStreamDataRead(const QByteArray &data)
+{
+#ifdef UNBOXER_WITH_STATS
+    stats.bytesFed += data.size();
+    auto start         = std::chrono::steady_clock::now();
+    auto callbackStart = stats.callbackTime;
+    auto status        = reader.feed(data);
+    stats.parserTime += (std::chrono::steady_clock::now() - start) - (stats.callbackTime - callbackStart);
+#else
+    auto status = reader.feed(data);
+#endif
+    return status == Status::Ok ? deferredStatus : status;
+}
 
 void UnboxerImpl::onStreamClosed(Status reason)
 {
     reason = reader.close(reason);
     if (reason == Status::Eof) {
-        while (!boxes.empty()) {
+        while (!nodes.empty()) {
             // check for incomplete boxes like one having explicit size but still requiring more data to close
-            auto box = boxes.back();
-
             // if box close wasn't handled by reader we need to close it explicitly
             // and let the the library's client to decide how valid it is
-            box->isClosed_ = true;
-            if (box->onClose) {
-                auto status = box->onClose();
-                if (status != Status::Ok) {
-                    reason = status;
-                    break;
+            finishDigest(nodes.back());
+            for (auto const &view : nodes.back().views) {
+                if (!view.box || view.raw) {
+                    continue;
+                }
+                view.box->isClosed_ = true;
+                if (view.box->onClose) {
+                    UNBOXER_STAT(ScopedTimer timer(stats.callbackTime));
+                    UNBOXER_TRACE_SPAN("onClose");
+                    auto status = view.box->onClose();
+                    if (status != Status::Ok) {
+                        reason = status;
+                    }
                 }
             }
-            boxes.pop_back();
+            if (reason != Status::Eof) {
+                break;
+            }
+            nodes.pop_back();
         }
     }
-    boxes.clear();
+    nodes.clear();
+    selectorStates.clear();
     if (streamClosedCallback) {
         streamClosedCallback(reason);
     }
 }
 
-bool UnboxerImpl::onBoxOpened(const QByteArray &type, std::uint64_t size, uint64_t fileOffset)
+BoxDecision UnboxerImpl::onBoxOpened(const QByteArray &type, std::uint64_t size, uint64_t fileOffset)
 {
-    bool isContainer = std::find(containerTypes.begin(), containerTypes.end(), type) != containerTypes.end();
-    auto parentBox   = boxes.back();
-    auto box         = boxes.emplace_back(std::make_shared<Box>(isContainer, type, size, fileOffset));
-    if (parentBox->onSubBoxOpen) {
-        parentBox->onSubBoxOpen(box);
+    auto preambleSize = containers.preambleSize(type);
+    if (type == "meta" && preambleSize == 4u && reader.payloadStart().mid(4, 4) == "hdlr") {
+        preambleSize = 0; // QuickTime's `meta` has no FullBox header. its hdlr follows right away
+    }
+    bool isContainer = preambleSize.has_value();
+    bool isSelected  = false;
+    bool isVisible   = true;
+    if (!selector.isEmpty()) {
+        auto match = selector.next(selectorStates.back(), type);
+        selectorStates.push_back(match.state);
+        isSelected  = match.selected;
+        isContainer = match.recurse || (match.recurseIfContainer && isContainer);
+        isVisible   = isSelected || isContainer;
+    }
+    UNBOXER_STAT(stats.boxesOpened++; stats.boxesByType[type]++;
+                 stats.maxDepth = qMax(stats.maxDepth, nodes.size()));
+
+    auto const &parent = nodes.back();
+    auto       &node   = nodes.emplace_back();
+    node.views.resize(parent.views.size());
+    for (std::size_t i = 0; i < parent.views.size(); i++) {
+        auto const &parentView = parent.views[i];
+        if (!parentView.box) {
+            continue;
+        }
+        if (parentView.raw || !parentView.box->isContainer) {
+            // the consumer took the parent as a blob though another one recursed into it
+            if (parentView.box->onDataRead) {
+                node.views[i] = { parentView.box, true };
+                UNBOXER_STAT(ScopedTimer timer(stats.callbackTime));
+                UNBOXER_TRACE_SPAN("onDataRead");
+                auto status = parentView.box->onDataRead(lastHeader);
+                if (status != Status::Ok && deferredStatus == Status::Ok) {
+                    deferredStatus = status;
+                }
+            }
+            continue;
+        }
+        if (!isVisible) {
+            continue;
+        }
+        auto box          = std::make_shared<Box>(isContainer, type, size, fileOffset);
+        box->headerSize   = std::uint32_t(lastHeader.size());
+        box->preambleSize = preambleSize.value_or(0);
+        node.views[i].box = box;
+        if (parentView.box->onSubBoxOpen) {
+            UNBOXER_STAT(ScopedTimer timer(stats.callbackTime));
+            UNBOXER_TRACE_SPAN("onSubBoxOpen");
+            parentView.box->onSubBoxOpen(box);
+        }
+    }
+    lastHeader.clear();
+    if (isSelected && boxSelectedCallback && node.views[0].box && !node.views[0].raw) {
+        UNBOXER_STAT(ScopedTimer timer(stats.callbackTime));
+        UNBOXER_TRACE_SPAN("onSelected");
+        boxSelectedCallback(node.views[0].box);
     }
-    return box->isContainer;
+
+    // recurse if anybody wants to, skip if nobody needs the payload
+    std::optional<std::uint32_t> recursePreamble;
+    bool                         needData = false;
+    for (auto const &view : node.views) {
+        if (!view.box) {
+            continue;
+        }
+        if (view.raw || !view.box->isContainer) {
+            needData = needData || view.box->onDataRead;
+        } else if (!recursePreamble) {
+            recursePreamble = view.box->preambleSize;
+        }
+    }
+    if (recursePreamble) {
+        return { BoxAction::Recurse, *recursePreamble };
+    }
+    if (needData && hashAlgorithms) {
+        node.hasher = std::make_unique<BoxHasher>(hashAlgorithms);
+    }
+    return needData ? BoxAction::Blob : BoxAction::Skip;
 }
 
 Status UnboxerImpl::onDataRead(const QByteArray &data)
 {
-    auto box = boxes.back();
-    box->dataFed_ += data.size();
-    if (box->onDataRead) {
-        return box->onDataRead(data);
+    auto &node = nodes.back();
+    if (node.hasher) {
+        UNBOXER_TRACE_SPAN("hash");
+        node.hasher->update(data);
+    }
+    // every consumer gets the same slice
+    for (auto const &view : node.views) {
+        if (!view.box) {
+            continue;
+        }
+        view.box->dataFed_ += data.size();
+        if (view.box->onDataRead) {
+            UNBOXER_STAT(stats.bytesDelivered += data.size(); ScopedTimer timer(stats.callbackTime));
+            UNBOXER_TRACE_SPAN("onDataRead");
+            auto status = view.box->onDataRead(data);
+            if (status != Status::Ok) {
+                return status;
+            }
+        }
     }
     return Status::Ok;
 }
 
 void UnboxerImpl::onBoxClosed()
 {
-    auto box       = boxes.back();
-    box->isClosed_ = true;
-    if (box->onClose) {
-        box->onClose();
+    finishDigest(nodes.back());
+    for (auto const &view : nodes.back().views) {
+        if (!view.box || view.raw) {
+            continue;
+        }
+        view.box->isClosed_ = true;
+        if (view.box->onClose) {
+            UNBOXER_STAT(ScopedTimer timer(stats.callbackTime));
+            UNBOXER_TRACE_SPAN("onClose");
+            view.box->onClose();
+        }
+    }
+    nodes.pop_back();
+    if (!selector.isEmpty()) {
+        selectorStates.pop_back();
+    }
+}
+
+void UnboxerImpl::finishDigest(Node &node)
+{
+    if (!node.hasher) {
+        return;
+    }
+    auto digest = node.hasher->result();
+    for (auto const &view : node.views) {
+        if (view.box && !view.raw) {
+            view.box->digest = digest;
+        }
     }
-    boxes.pop_back();
+    node.hasher.reset();
 }
 
 } // namespace unboxer
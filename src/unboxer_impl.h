@@ -25,12 +25,18 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #pragma once
 
 #include "box.h"
+#include "boxhasher.h"
 #include "boxreader.h"
+#include "boxselector.h"
+#include "checkpoint.h"
+#include "containerregistry.h"
+#include "stats.h"
 #include "status.h"
 #include "unboxer_export.h"
 
 #include <list>
 #include <memory>
+#include <optional>
 #include <variant>
 
 namespace unboxer {
@@ -39,10 +45,17 @@ class UNBOXER_EXPORT UnboxerImpl {
 public:
     using StreamOpenedCallback = std::function<void(Box::Ptr)>;
     using StreamClosedCallback = std::function<void(Status)>;
+    using BoxSelectedCallback  = std::function<void(Box::Ptr)>;
 
-    UnboxerImpl(std::vector<QByteArray> &&containerTypes);
+    UnboxerImpl(ContainerRegistry &&containers);
 
-    Box::Ptr rootBox() const { return boxes.empty() ? Box::Ptr {} : boxes.front(); }
+    Box::Ptr rootBox() const { return nodes.empty() ? Box::Ptr {} : nodes.front().views.front().box; }
+
+    // one more consumer of the same parse with its own root box. has to be called before the stream is opened
+    void subscribe(StreamOpenedCallback &&callback) { subscribers.push_back(std::move(callback)); }
+
+    // true if the library was built with statistics collection
+    static bool statsEnabled();
 
     // streaming
     void   onStreamOpened();
@@ -50,17 +63,42 @@ public:
     void   onStreamClosed(Status reason);
 
     // unboxing
-    bool   onBoxOpened(const QByteArray &type, std::uint64_t size, std::uint64_t fileOffset);
-    Status onDataRead(const QByteArray &data);
-    void   onBoxClosed();
+    BoxDecision onBoxOpened(const QByteArray &type, std::uint64_t size, std::uint64_t fileOffset);
+    Status      onDataRead(const QByteArray &data);
+    void        onBoxClosed();
 
-    std::vector<QByteArray> containerTypes;
+    ContainerRegistry containers;
 
     StreamOpenedCallback streamOpenedCallback;
     StreamClosedCallback streamClosedCallback;
 
-    BoxReader           reader;
-    std::list<Box::Ptr> boxes;
+    BoxSelector                     selector;
+    BoxSelectedCallback             boxSelectedCallback;
+    std::vector<BoxSelector::State> selectorStates; // of the open boxes when selector is in use
+
+    // how one consumer sees an open box
+    struct View {
+        Box::Ptr box;         // null if the consumer isn't interested
+        bool     raw = false; // box is an ancestor blob which gets this one as a part of its payload
+    };
+    // an open box. views are in order of consumers, the primary one (streamOpenedCallback) first
+    struct Node {
+        std::vector<View>          views;
+        std::unique_ptr<BoxHasher> hasher; // blobs only if hashing is on
+    };
+    void finishDigest(Node &node);
+
+    std::vector<StreamOpenedCallback> subscribers;
+
+    int hashAlgorithms = NoHash; // HashAlgorithm flags
+
+    std::optional<Checkpoint> resumePoint; // where to start instead of the beginning
+
+    BoxReader       reader;
+    std::list<Node> nodes;
+    QByteArray      lastHeader;                  // raw header of the box being opened. valid only in onBoxOpened
+    Status          deferredStatus = Status::Ok; // error of a callback which had no way to report it immediately
+    ParseStats      stats;
 };
 
 } // namespace unboxer
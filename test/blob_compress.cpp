@@ -0,0 +1,172 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <atomic>
+
+#include "blobextractor.h"
+#include "compressor.h"
+
+using namespace unboxer;
+
+class BlobCompressTest : public QObject {
+    Q_OBJECT
+
+    // zlib under another suffix, counting the blocks
+    class CountingCodec : public ZlibCodec {
+    public:
+        QString    suffix() const override { return QStringLiteral(".test"); }
+        QByteArray compress(const QByteArray &block) const override
+        {
+            blocks++;
+            return ZlibCodec::compress(block);
+        }
+        mutable std::atomic<int> blocks { 0 };
+    };
+
+    static QByteArray text()
+    {
+        QByteArray data;
+        for (int i = 0; data.size() < 1000000; i++) {
+            auto number = QByteArray::number(i);
+            data += "<p begin=\"" + number + "s\">subtitle line number " + number + "</p>\n";
+        }
+        return data;
+    }
+
+    static QByteArray noise()
+    {
+        QByteArray data(1000000, '\0');
+        quint32    state = 2463534242;
+        for (auto &byte : data) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            byte = char(state);
+        }
+        return data;
+    }
+
+    static QByteArray content(const QString &filename)
+    {
+        QFile file(filename);
+        return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+    }
+
+    // feeds a box in chunks as the unboxer would and waits for the file
+    static QString extract(BlobExtractor &extractor, const QByteArray &type, const QByteArray &payload)
+    {
+        QString filename;
+        extractor.setOnBoxClosedCallback([&](Box::Ptr, const QString &name) { filename = name; });
+        auto box = std::make_shared<Box>(false, type, payload.size() + 8, 0);
+        extractor.add(box);
+        for (int i = 0; i < payload.size(); i += 16384) {
+            extractor.addBoxData(box, payload.mid(i, 16384));
+        }
+        extractor.closeBox(box);
+        extractor.waitForDone();
+        QTRY_VERIFY_WITH_TIMEOUT(!filename.isEmpty(), 5000);
+        return filename;
+    }
+
+private slots:
+
+    void compressibleTest()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        ZlibCodec     codec;
+        BlobExtractor extractor("%1.%2");
+        extractor.setOutputDirectory(QDir(dir.path()));
+        extractor.setCompression("mdat", std::make_shared<ZlibCodec>());
+        auto filename = extract(extractor, "mdat", text());
+        QVERIFY(filename.endsWith(".zz"));
+        auto compressed = content(filename);
+        QVERIFY(compressed.size() < text().size() / 4);
+        QCOMPARE(CompressedFile::decode(compressed, codec), std::optional<QByteArray>(text()));
+        QVERIFY(!QFile::exists(filename.chopped(3))); // renamed, not copied
+    }
+
+    void incompressibleTest()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        auto          codec = std::make_shared<CountingCodec>();
+        BlobExtractor extractor("%1.%2");
+        extractor.setOutputDirectory(QDir(dir.path()));
+        extractor.setCompression("mdat", codec);
+        auto filename = extract(extractor, "mdat", noise());
+        QVERIFY(!filename.endsWith(codec->suffix()));
+        QCOMPARE(content(filename), noise());
+        QCOMPARE(codec->blocks.load(), 1); // only the first block is tried
+    }
+
+    void perTypeTest()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        auto          codec = std::make_shared<CountingCodec>();
+        BlobExtractor extractor("%1.%2", { "mdat", "moov" });
+        extractor.setOutputDirectory(QDir(dir.path()));
+        extractor.setCompression("moov", codec);
+
+        auto moov = extract(extractor, "moov", text());
+        QVERIFY(moov.endsWith(".test"));
+        QCOMPARE(CompressedFile::decode(content(moov), *codec), std::optional<QByteArray>(text()));
+
+        auto mdat = extract(extractor, "mdat", text());
+        QVERIFY(!mdat.endsWith(".test"));
+        QCOMPARE(content(mdat), text());
+    }
+
+    void damagedTest()
+    {
+        ZlibCodec  codec;
+        QByteArray truncated(4, '\0');
+        truncated[3] = 16;  // a block of 16 bytes
+        truncated += "abc"; // with only 3 of them
+        QVERIFY(!CompressedFile::decode(truncated, codec));
+        QCOMPARE(CompressedFile::decode(QByteArray(), codec), std::optional<QByteArray>(QByteArray()));
+    }
+
+    void workerOrderTest()
+    {
+        QList<int> order;
+        {
+            CompressionWorker worker(100); // every job waits for the previous one
+            for (int i = 0; i < 20; i++) {
+                worker.post([&order, i]() { order << i; }, 60);
+            }
+        }
+        QCOMPARE(order.size(), 20);
+        for (int i = 0; i < 20; i++) {
+            QCOMPARE(order[i], i);
+        }
+    }
+};
+
+QTEST_MAIN(BlobCompressTest)
+#include "blob_compress.moc"
@@ -0,0 +1,155 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <QCryptographicHash>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include "blobextractor.h"
+
+using namespace unboxer;
+
+class BlobDedupeTest : public QObject {
+    Q_OBJECT
+
+    // feeds a box to the extractor in chunks as the unboxer would
+    static QString extract(BlobExtractor &extractor, const QByteArray &type, const QByteArray &payload,
+                           std::uint64_t offset = 0)
+    {
+        QString filename;
+        extractor.setOnBoxClosedCallback([&](Box::Ptr, const QString &name) { filename = name; });
+        auto box = std::make_shared<Box>(false, type, payload.size() + 8, offset);
+        extractor.add(box);
+        for (int i = 0; i < payload.size(); i += 1000) {
+            extractor.addBoxData(box, payload.mid(i, 1000));
+        }
+        extractor.closeBox(box);
+        return filename;
+    }
+
+    static QByteArray content(const QString &filename)
+    {
+        QFile file(filename);
+        return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+    }
+
+    static QString sha256(const QByteArray &data)
+    {
+        return QString::fromLatin1(QCryptographicHash::hash(data, QCryptographicHash::Sha256).toHex());
+    }
+
+    static QStringList objects(const QTemporaryDir &dir)
+    {
+        return QDir(dir.filePath("objects")).entryList(QDir::Files);
+    }
+
+private slots:
+
+    void dedupeTest()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QByteArray init(500, 'i'), subtitle("<tt>same text</tt>"), other("<tt>other text</tt>");
+
+        for (int asset = 0; asset < 3; asset++) {
+            BlobExtractor extractor("%1.%2", { "moov", "mdat" });
+            extractor.setOutputDirectory(QDir(dir.path()));
+            extractor.setContentAddressed(true);
+            auto initFile = extract(extractor, "moov", init);
+            QCOMPARE(QFileInfo(initFile).fileName(), sha256(init));
+            QCOMPARE(content(initFile), init);
+            extract(extractor, "mdat", subtitle, 1000);
+            extract(extractor, "mdat", asset == 1 ? other : subtitle, 2000);
+
+            auto manifest = extractor.manifest();
+            QCOMPARE(manifest.size(), 3);
+            auto last = manifest.last().toObject();
+            QCOMPARE(last["type"].toString(), QString("mdat"));
+            QCOMPARE(last["offset"].toInt(), 2000);
+            QCOMPARE(last["size"].toInt(), (asset == 1 ? other : subtitle).size());
+            QCOMPARE(last["sha256"].toString(), sha256(asset == 1 ? other : subtitle));
+            QCOMPARE(last["file"].toString(), "objects/" + sha256(asset == 1 ? other : subtitle));
+            QVERIFY(extractor.saveManifest(dir.filePath(QString("asset%1.json").arg(asset))));
+        }
+        QCOMPARE(objects(dir).size(), 3); // init, subtitle and other
+    }
+
+    void existingObjectIsNotWrittenTest()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QByteArray payload("payload");
+        QDir(dir.path()).mkpath("objects");
+        QFile marker(dir.filePath("objects/" + sha256(payload)));
+        QVERIFY(marker.open(QIODevice::WriteOnly));
+        marker.write("marker"); // if the object were rewritten, it would be lost
+        marker.close();
+
+        BlobExtractor extractor("%1.%2");
+        extractor.setOutputDirectory(QDir(dir.path()));
+        extractor.setContentAddressed(true);
+        extract(extractor, "mdat", payload);
+        QCOMPARE(content(marker.fileName()), QByteArray("marker"));
+    }
+
+    void largePayloadTest()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QByteArray payload(10000, '\0');
+        for (int i = 0; i < payload.size(); i++) {
+            payload[i] = char(i * 7);
+        }
+        for (int copy = 0; copy < 2; copy++) {
+            BlobExtractor extractor("%1.%2");
+            extractor.setOutputDirectory(QDir(dir.path()));
+            extractor.setContentAddressed(true, 2500); // spilled to a temporary file after a few chunks
+            auto filename = extract(extractor, "mdat", payload);
+            QCOMPARE(content(filename), payload);
+            QCOMPARE(objects(dir), QStringList() << sha256(payload)); // no temporary files left
+        }
+    }
+
+    void digestTest()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        BlobExtractor extractor("%1.%2");
+        extractor.setOutputDirectory(QDir(dir.path()));
+        extractor.setContentAddressed(true);
+        extractor.setHashing(Xxh64Hash);
+        BoxDigest digest;
+        auto      box = std::make_shared<Box>(false, "mdat", 12, 0);
+        extractor.setOnBoxClosedCallback([&](Box::Ptr box, const QString &) { digest = box->digest; });
+        extractor.add(box);
+        extractor.addBoxData(box, "data");
+        extractor.closeBox(box);
+        QVERIFY(digest.xxh64.has_value());
+        QCOMPARE(QString::fromLatin1(digest.sha256.toHex()), sha256("data"));
+    }
+};
+
+QTEST_MAIN(BlobDedupeTest)
+#include "blob_dedupe.moc"
@@ -0,0 +1,165 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTest>
+#include <QUuid>
+#include <QtEndian>
+
+#include <cstdio>
+
+#include "eventwriter.h"
+#include "inputbuffer_impl.h"
+#include "status.h"
+#include "testutil.h"
+#include "unboxer.h"
+
+using namespace unboxer;
+using namespace unboxer::testutil;
+
+class EventWriterTest : public QObject {
+    Q_OBJECT
+
+    static QByteArray uuid() { return QUuid("{12345678-9abc-def0-1234-56789abcdef0}").toRfc4122(); }
+
+    // ftyp at 0, moov at 12 with mvhd at 20, uuid at 32, mdat at 60
+    static QByteArray movie()
+    {
+        return makeBox("ftyp", "isom") + makeBox("moov", makeBox("mvhd", "MVHD")) + makeBox("uuid", uuid() + "meta")
+            + makeBox("mdat", "12345678");
+    }
+
+    // events of movie() numbered the way mp4crawler does it, written by EventWriter
+    static QByteArray write(EventWriter::Format format, int bufferSize = EventWriter::DEFAULT_BUFFER_SZ)
+    {
+        auto output = std::tmpfile();
+        if (!output) {
+            return {};
+        }
+        {
+            EventWriter                      writer(format, output, bufferSize);
+            std::uint64_t                    lastId = 0;
+            testutil::Parse<InputBufferImpl> run(movie());
+
+            std::function<void(Box::Ptr, std::uint64_t, std::uint32_t)> setup = [&](Box::Ptr      box,
+                                                                                   std::uint64_t parentId,
+                                                                                   std::uint32_t depth) {
+                auto id = ++lastId;
+                writer.boxOpened({ id, parentId, depth, box->fileOffset, box->size, box->type });
+                box->onSubBoxOpen = [&, id, depth](Box::Ptr subBox) { setup(subBox, id, depth + 1); };
+            };
+            run.unboxer.setStreamOpenedCallback([&](Box::Ptr root) {
+                root->onSubBoxOpen = [&](Box::Ptr box) { setup(box, 0, 0); };
+            });
+            run.unboxer.setStreamClosedCallback([&](Status reason) {
+                run.closed = true;
+                run.status = reason;
+            });
+            run.unboxer.open();
+            run.drain();
+        }
+        QByteArray data;
+        std::rewind(output);
+        char chunk[4096];
+        for (std::size_t size; (size = std::fread(chunk, 1, sizeof(chunk), output)) > 0;) {
+            data.append(chunk, int(size));
+        }
+        std::fclose(output);
+        return data;
+    }
+
+private slots:
+
+    void textTest()
+    {
+        // indented like the baseline mp4crawler output below its "artificial root" line
+        QByteArray expected = "  ftyp of size 12 with fileOffset 0\n"
+                              "  moov of size 20 with fileOffset 12\n"
+                              "    mvhd of size 12 with fileOffset 20\n"
+                              "  {12345678-9abc-def0-1234-56789abcdef0} of size 28 with fileOffset 32\n"
+                              "  mdat of size 16 with fileOffset 60\n";
+        QCOMPARE(write(EventWriter::Format::Text), expected);
+        QCOMPARE(write(EventWriter::Format::Text, 16), expected); // flushed after every event
+    }
+
+    void jsonLinesTest()
+    {
+        QByteArray expected = "{\"id\":1,\"parent\":0,\"depth\":0,\"type\":\"ftyp\",\"offset\":0,\"size\":12}\n"
+                              "{\"id\":2,\"parent\":0,\"depth\":0,\"type\":\"moov\",\"offset\":12,\"size\":20}\n"
+                              "{\"id\":3,\"parent\":2,\"depth\":1,\"type\":\"mvhd\",\"offset\":20,\"size\":12}\n"
+                              "{\"id\":4,\"parent\":0,\"depth\":0,\"type\":\"12345678-9abc-def0-1234-56789abcdef0\","
+                              "\"offset\":32,\"size\":28}\n"
+                              "{\"id\":5,\"parent\":0,\"depth\":0,\"type\":\"mdat\",\"offset\":60,\"size\":16}\n";
+        auto output = write(EventWriter::Format::JsonLines);
+        QCOMPARE(output, expected);
+        for (auto const &line : output.trimmed().split('\n')) {
+            QJsonParseError error;
+            auto            object = QJsonDocument::fromJson(line, &error).object();
+            QCOMPARE(error.error, QJsonParseError::NoError);
+            QCOMPARE(object.size(), 6);
+        }
+    }
+
+    void binaryTest()
+    {
+        auto output = write(EventWriter::Format::Binary);
+        QCOMPARE(output.size(), 8 + 5 * EventWriter::BINARY_RECORD_SZ);
+        QCOMPARE(output.left(6), QByteArray("UBXEV\0", 6));
+        QCOMPARE(qFromLittleEndian<quint16>(output.constData() + 6), EventWriter::BINARY_VERSION);
+
+        auto record = [&](int index) { return output.constData() + 8 + index * EventWriter::BINARY_RECORD_SZ; };
+        // mvhd
+        QCOMPARE(qFromLittleEndian<quint64>(record(2)), quint64(3));
+        QCOMPARE(qFromLittleEndian<quint64>(record(2) + 8), quint64(2));
+        QCOMPARE(qFromLittleEndian<quint64>(record(2) + 16), quint64(20));
+        QCOMPARE(qFromLittleEndian<quint64>(record(2) + 24), quint64(12));
+        QCOMPARE(qFromLittleEndian<quint32>(record(2) + 32), quint32(1));
+        QCOMPARE(qFromLittleEndian<quint32>(record(2) + 36), quint32(0));
+        QCOMPARE(QByteArray(record(2) + 40, 16), QByteArray("mvhd") + QByteArray(12, '\0'));
+        // uuid
+        QCOMPARE(qFromLittleEndian<quint64>(record(3) + 16), quint64(32));
+        QCOMPARE(qFromLittleEndian<quint32>(record(3) + 36), quint32(1));
+        QCOMPARE(QByteArray(record(3) + 40, 16), uuid());
+
+        QCOMPARE(write(EventWriter::Format::Binary, 16), output);
+    }
+
+    void noEventsTest()
+    {
+        // e.g. mp4crawler --summary --format binary
+        auto output = std::tmpfile();
+        QVERIFY(output);
+        {
+            EventWriter writer(EventWriter::Format::Binary, output);
+            writer.text(0, "ignored");
+        }
+        QCOMPARE(std::ftell(output), 0L);
+        std::fclose(output);
+    }
+};
+
+QTEST_MAIN(EventWriterTest)
+
+#include "event_writer.moc"
@@ -0,0 +1,117 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <QTemporaryFile>
+#include <QTest>
+
+#include "inputfile_impl.h"
+#include "inputstreamer.h"
+#include "status.h"
+#include "testutil.h"
+#include "unboxer.h"
+
+using namespace unboxer;
+using namespace unboxer::testutil;
+
+class FileReadAheadTest : public QObject {
+    Q_OBJECT
+
+    static QByteArray movie(int mdatSize)
+    {
+        auto moov = makeBox("moov", makeBox("mvhd", "MVHD"));
+        return makeBox("ftyp", "isom") + moov + makeBox("mdat", pattern(mdatSize));
+    }
+
+    struct Parse : testutil::Parse<InputFileImpl> {
+        Parse(const QString &fileName, int chunks, qint64 chunkSize, const std::vector<QByteArray> &selection = {}) :
+            testutil::Parse<InputFileImpl>(fileName.toStdString())
+        {
+            input().setReadAhead(chunks, chunkSize);
+            start(selection);
+        }
+    };
+
+    QTemporaryFile file;
+
+    void write(const QByteArray &data)
+    {
+        file.resize(0);
+        file.seek(0);
+        file.write(data);
+        file.flush();
+    }
+
+private slots:
+
+    void initTestCase() { QVERIFY(file.open()); }
+
+    void orderTest_data()
+    {
+        QTest::addColumn<int>("chunks");
+        QTest::addColumn<qint64>("chunkSize");
+
+        QTest::newRow("on demand") << 0 << qint64(0);
+        QTest::newRow("double small") << 2 << qint64(4096);
+        QTest::newRow("triple") << 3 << qint64(64 * 1024);
+        QTest::newRow("chunk over read size") << 3 << InputFileImpl::DEFAULT_CHUNK_SIZE;
+    }
+
+    void orderTest()
+    {
+        QFETCH(int, chunks);
+        QFETCH(qint64, chunkSize);
+
+        constexpr int mdatSize = 1024 * 1024 + 123;
+        write(movie(mdatSize));
+        Parse parse(file.fileName(), chunks, chunkSize);
+        QTRY_VERIFY_WITH_TIMEOUT(parse.closed, 10000);
+        QCOMPARE(parse.status, Status::Eof);
+        QCOMPARE(parse.data["mvhd"], QByteArray("MVHD"));
+        QVERIFY(parse.data["mdat"] == pattern(mdatSize));
+        QCOMPARE(parse.unboxer.stream().bytesRead(), std::uint64_t(file.size()));
+    }
+
+    void skipTest()
+    {
+        constexpr int mdatSize = 8 * 1024 * 1024;
+        write(movie(mdatSize) + makeBox("free", "tail"));
+        Parse parse(file.fileName(), 3, 64 * 1024, { "moov/mvhd", "free" });
+        QTRY_VERIFY_WITH_TIMEOUT(parse.closed, 10000);
+        QCOMPARE(parse.status, Status::Eof);
+        QCOMPARE(parse.data["mvhd"], QByteArray("MVHD"));
+        QVERIFY(parse.data["mdat"].isEmpty());
+        QVERIFY(parse.unboxer.stream().bytesRead() < std::uint64_t(mdatSize) / 2); // skipped, not read through
+    }
+
+    void missingFileTest()
+    {
+        Parse parse(file.fileName() + ".missing", 3, 4096);
+        QTRY_VERIFY_WITH_TIMEOUT(parse.closed, 1000);
+        QCOMPARE(parse.status, Status::SourceNotExist);
+    }
+};
+
+QTEST_MAIN(FileReadAheadTest)
+
+#include "file_readahead.moc"
@@ -0,0 +1,270 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <QTemporaryFile>
+#include <QTest>
+#include <QtEndian>
+
+#include <limits>
+
+#include "boxrewriter.h"
+#include "inputfile_impl.h"
+#include "inputstreamer.h"
+#include "status.h"
+#include "testutil.h"
+#include "unboxer.h"
+
+using namespace unboxer;
+using namespace unboxer::testutil;
+using FileUnboxer = unboxer::Unboxer<InputFileImpl, NullCache>;
+
+class FileRewriteTest : public QObject {
+    Q_OBJECT
+
+    // fragments with trun data_offset relative to the moof (default-base-is-moof), a uuid inside traf and a free box
+    // between moof and mdat
+    static QByteArray fragmented(int mdatSize)
+    {
+        auto file = makeBox("ftyp", "iso6") + makeBox("free", QByteArray(30, 'x'));
+        for (int fragment = 0; fragment < 3; fragment++) {
+            auto moof = [&](quint32 dataOffset) {
+                auto tfhd = makeBox("tfhd", be32(0x020000) + be32(1));
+                auto trun = makeBox("trun", be32(0x000001) + be32(1) + be32(dataOffset) + be32(mdatSize));
+                auto traf = makeBox("traf", tfhd + makeBox("uuid", QByteArray(16, 'u') + "meta") + trun);
+                return makeBox("moof", makeBox("mfhd", be32(0) + be32(fragment + 1)) + traf);
+            };
+            auto gap = makeBox("free", QByteArray(7, 'g'));
+            file += moof(quint32(moof(0).size() + gap.size() + 8)) + gap + makeBox("mdat", pattern(mdatSize, fragment));
+        }
+        return file;
+    }
+
+    // like fragmented(), but tfhd has an absolute base_data_offset (flag 0x000001) and data_offset of trun is 0,
+    // i.e. relative to that base
+    static QByteArray fragmentedWithBase(int mdatSize)
+    {
+        auto file = makeBox("ftyp", "iso6") + makeBox("free", QByteArray(30, 'x'));
+        for (int fragment = 0; fragment < 3; fragment++) {
+            auto moof = [&](quint64 base) {
+                QByteArray baseField(8, '\0');
+                qToBigEndian<quint64>(base, baseField.data());
+                auto tfhd = makeBox("tfhd", be32(0x000001) + be32(1) + baseField);
+                auto trun = makeBox("trun", be32(0x000001) + be32(1) + be32(0) + be32(mdatSize));
+                auto traf = makeBox("traf", tfhd + makeBox("uuid", QByteArray(16, 'u') + "meta") + trun);
+                return makeBox("moof", makeBox("mfhd", be32(0) + be32(fragment + 1)) + traf);
+            };
+            auto gap = makeBox("free", QByteArray(7, 'g'));
+            file += moof(quint64(file.size() + moof(0).size() + gap.size() + 8)) + gap
+                + makeBox("mdat", pattern(mdatSize, fragment));
+        }
+        return file;
+    }
+
+    // base_data_offset of every tfhd
+    static QList<quint64> bases(const QByteArray &file)
+    {
+        QList<quint64> result;
+        for (int tfhd = 0; (tfhd = file.indexOf("tfhd", tfhd)) >= 0; tfhd += 4) {
+            result << qFromBigEndian<quint64>(file.constData() + tfhd + 12);
+        }
+        return result;
+    }
+
+    // payloads the truns point to
+    static QList<QByteArray> samples(const QByteArray &file, int mdatSize)
+    {
+        QList<QByteArray> result;
+        for (int offset = 0; offset + 8 <= file.size();) {
+            auto size = qFromBigEndian<quint32>(file.constData() + offset);
+            if (size < 8) {
+                break;
+            }
+            if (file.mid(offset + 4, 4) == "moof") {
+                auto trun       = file.indexOf("trun", offset);
+                auto dataOffset = qFromBigEndian<qint32>(file.constData() + trun + 12);
+                result << file.mid(offset + dataOffset, mdatSize);
+            }
+            offset += int(size);
+        }
+        return result;
+    }
+
+    struct Result {
+        QByteArray    output;
+        Status        status = Status::Ok;
+        std::uint64_t bytesRead;
+        std::uint64_t bytesCopied;
+    };
+
+    Result rewrite(BoxRewriter::Filter &&filter, bool zeroCopy = false)
+    {
+        QTemporaryFile output;
+        if (!output.open()) {
+            return {};
+        }
+        BoxRewriter rewriter(&output, std::move(filter));
+        if (zeroCopy) {
+            rewriter.setSourceFile(source.fileName());
+        }
+        Result      result;
+        bool        closed = false;
+        FileUnboxer unboxer(source.fileName().toStdString());
+        unboxer.setStreamOpenedCallback([&](Box::Ptr root) { rewriter.attach(root); });
+        unboxer.setStreamClosedCallback([&](Status reason) {
+            closed        = true;
+            result.status = reason;
+        });
+        unboxer.stream().setDataReadyCallback([&]() { unboxer.read(16 * 1024); });
+        unboxer.open();
+        if (unboxer.stream().bytesAvailable()) {
+            unboxer.read(16 * 1024);
+        }
+        QTest::qWaitFor([&]() { return closed; }, 10000);
+        if (result.status == Status::Eof || rewriter.status() != Status::Ok) {
+            result.status = rewriter.status(); // its own error is what stopped the parse
+        }
+        output.flush();
+        output.seek(0);
+        result.output      = output.readAll();
+        result.bytesRead   = unboxer.stream().bytesRead();
+        result.bytesCopied = rewriter.bytesCopied();
+        return result;
+    }
+
+    QTemporaryFile source;
+
+    void write(const QByteArray &data)
+    {
+        source.resize(0);
+        source.seek(0);
+        source.write(data);
+        source.flush();
+    }
+
+private slots:
+
+    void initTestCase() { QVERIFY(source.open()); }
+
+    void identityTest()
+    {
+        auto input = fragmented(1000);
+        write(input);
+        auto result = rewrite({});
+        QCOMPARE(result.status, Status::Ok);
+        QVERIFY(result.output == input);
+    }
+
+    void dropTest()
+    {
+        auto input = fragmented(1000);
+        write(input);
+        auto result = rewrite(BoxRewriter::dropping({ "uuid", "free" }));
+        QCOMPARE(result.status, Status::Ok);
+        QVERIFY(!result.output.contains("free"));
+        QVERIFY(!result.output.contains("uuid"));
+        QCOMPARE(result.output.size(), input.size() - 38 - 3 * (28 + 15));
+        QCOMPARE(samples(result.output, 1000), samples(input, 1000));
+
+        // sizes are consistent. the copy is parsed as it is
+        write(result.output);
+        auto again = rewrite({});
+        QCOMPARE(again.status, Status::Ok);
+        QVERIFY(again.output == result.output);
+    }
+
+    void replaceTest()
+    {
+        auto input = fragmented(1000);
+        write(input);
+        auto result = rewrite([](const Box::Ptr &box, std::size_t) {
+            if (box->type == "mfhd") {
+                return BoxRewriter::Edit { BoxRewriter::Action::Replace, makeBox("mfhd", QByteArray(100, '\0')) };
+            }
+            return BoxRewriter::Edit();
+        });
+        QCOMPARE(result.status, Status::Ok);
+        QCOMPARE(result.output.size(), input.size() + 3 * 92);
+        QCOMPARE(samples(result.output, 1000), samples(input, 1000));
+        auto moof = result.output.indexOf("moof") - 4;
+        QCOMPARE(qFromBigEndian<quint32>(result.output.constData() + moof), quint32(8 + 108 + 76));
+    }
+
+    void baseDataOffsetTest()
+    {
+        constexpr int mdatSize = 1000;
+        auto          input    = fragmentedWithBase(mdatSize);
+        write(input);
+        auto result = rewrite(BoxRewriter::dropping({ "uuid", "free" }));
+        QCOMPARE(result.status, Status::Ok);
+
+        // every absolute base moved by the distance its mdat moved, trun data_offset stays relative to it
+        auto inputBases  = bases(input);
+        auto outputBases = bases(result.output);
+        QCOMPARE(inputBases.size(), 3);
+        QCOMPARE(outputBases.size(), 3);
+        for (int fragment = 0, inputMdat = 0, outputMdat = 0; fragment < 3; fragment++) {
+            inputMdat  = input.indexOf("mdat", inputMdat + 4);
+            outputMdat = result.output.indexOf("mdat", outputMdat + 4);
+            auto shift = qint64(outputMdat) - inputMdat;
+            QCOMPARE(shift, -qint64(38 + (fragment + 1) * (28 + 15)));
+            QCOMPARE(qint64(outputBases[fragment]), qint64(inputBases[fragment]) + shift);
+            QVERIFY(result.output.mid(int(outputBases[fragment]), mdatSize) == pattern(mdatSize, fragment));
+            auto trun = result.output.indexOf("trun", outputMdat - 100);
+            QCOMPARE(qFromBigEndian<qint32>(result.output.constData() + trun + 12), 0);
+        }
+    }
+
+    void offsetOverflowTest()
+    {
+        // growing the moof pushes data_offset of the first trun beyond the signed 32-bit field
+        auto input = fragmented(1000);
+        qToBigEndian<qint32>(std::numeric_limits<qint32>::max() - 10, input.data() + input.indexOf("trun") + 12);
+        write(input);
+        auto result = rewrite([](const Box::Ptr &box, std::size_t) {
+            if (box->type == "mfhd") {
+                return BoxRewriter::Edit { BoxRewriter::Action::Replace, makeBox("mfhd", QByteArray(100, '\0')) };
+            }
+            return BoxRewriter::Edit();
+        });
+        QCOMPARE(result.status, Status::WriteFailed);
+    }
+
+    void zeroCopyTest()
+    {
+        constexpr int mdatSize = 4 * 1024 * 1024;
+        auto          input    = fragmented(mdatSize);
+        write(input);
+        auto result = rewrite(BoxRewriter::dropping({ "free" }), true);
+        QCOMPARE(result.status, Status::Ok);
+        QCOMPARE(samples(result.output, mdatSize), samples(input, mdatSize));
+        QVERIFY(result.bytesRead < std::uint64_t(mdatSize)); // mdat payloads are skipped by the parser
+#ifdef Q_OS_LINUX
+        QVERIFY(result.bytesCopied > 0);
+#endif
+    }
+};
+
+QTEST_MAIN(FileRewriteTest)
+
+#include "file_rewrite.moc"
@@ -0,0 +1,201 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTest>
+#include <QTimer>
+
+#include <algorithm>
+
+#include "httppool.h"
+#include "inputhttp_impl.h"
+#include "inputstreamer.h"
+#include "status.h"
+#include "testutil.h"
+#include "unboxer.h"
+
+using namespace unboxer;
+using namespace unboxer::testutil;
+
+// keep-alive HTTP/1.1 server answering every request with the same body after a short delay
+class HttpStandIn : public QTcpServer {
+public:
+    HttpStandIn(const QByteArray &body, int delay = 20) : body(body), delay(delay)
+    {
+        listen(QHostAddress::LocalHost);
+        connect(this, &QTcpServer::newConnection, this, [this]() {
+            while (auto socket = nextPendingConnection()) {
+                connections++;
+                connect(socket, &QTcpSocket::readyRead, socket, [this, socket]() { onReadyRead(socket); });
+            }
+        });
+    }
+    QString url() const { return QString("http://127.0.0.1:%1/movie.mp4").arg(serverPort()); }
+
+    int connections   = 0;
+    int requests      = 0;
+    int maxConcurrent = 0;
+
+private:
+    void onReadyRead(QTcpSocket *socket)
+    {
+        auto &buffer = buffers[socket];
+        buffer += socket->readAll();
+        int end;
+        while ((end = buffer.indexOf("\r\n\r\n")) >= 0) {
+            buffer.remove(0, end + 4);
+            requests++;
+            maxConcurrent = qMax(maxConcurrent, ++concurrent);
+            QTimer::singleShot(delay, socket, [this, socket]() {
+                concurrent--;
+                socket->write("HTTP/1.1 200 OK\r\nConnection: keep-alive\r\nContent-Length: "
+                              + QByteArray::number(body.size()) + "\r\n\r\n" + body);
+            });
+        }
+    }
+
+    QByteArray                      body;
+    int                             delay;
+    QHash<QTcpSocket *, QByteArray> buffers;
+    int                             concurrent = 0;
+};
+
+class HttpPoolTest : public QObject {
+    Q_OBJECT
+
+    static QByteArray movie(int mdatSize = 5000)
+    {
+        auto moov = makeBox("moov", makeBox("mvhd", "MVHD"));
+        return makeBox("ftyp", "isom") + moov + makeBox("mdat", QByteArray(mdatSize, 'm'));
+    }
+
+    struct Parse : testutil::Parse<InputHttpImpl> {
+        Parse(const QString &url, qint64 readBufferSize = -1, std::size_t readSize = 4096) :
+            testutil::Parse<InputHttpImpl>(url.toStdString())
+        {
+            input().setReadBufferSize(readBufferSize);
+            this->readSize = readSize;
+            start();
+        }
+    };
+
+    static bool allClosed(const std::vector<std::unique_ptr<Parse>> &parses)
+    {
+        return std::all_of(parses.begin(), parses.end(), [](auto const &parse) { return parse->closed; });
+    }
+
+private slots:
+
+    void initTestCase()
+    {
+        HttpPool::forThread().setHttp2Allowed(false); // the stand-in speaks HTTP/1.1 only
+    }
+
+    void init() { HttpPool::forThread().setMaxConnectionsPerHost(HttpPool::DEFAULT_MAX_CONNECTIONS_PER_HOST); }
+
+    void reuseTest()
+    {
+        HttpStandIn server(movie());
+        for (int i = 0; i < 5; i++) {
+            Parse parse(server.url());
+            QTRY_VERIFY_WITH_TIMEOUT(parse.closed, 10000);
+            QCOMPARE(parse.status, Status::Eof);
+            QCOMPARE(parse.data["mdat"].size(), 5000);
+        }
+        QCOMPARE(server.requests, 5);
+        QCOMPARE(server.connections, 1);
+    }
+
+    void limitTest()
+    {
+        HttpStandIn server(movie());
+        auto       &pool = HttpPool::forThread();
+        pool.setMaxConnectionsPerHost(2);
+
+        std::vector<std::unique_ptr<Parse>> parses;
+        for (int i = 0; i < 8; i++) {
+            parses.push_back(std::make_unique<Parse>(server.url()));
+        }
+        auto host = QString("127.0.0.1:%1").arg(server.serverPort());
+        QCOMPARE(pool.activeRequests(host), 2);
+        QCOMPARE(pool.queuedRequests(host), 6);
+
+        QTRY_VERIFY_WITH_TIMEOUT(allClosed(parses), 10000);
+        for (auto const &parse : parses) {
+            QCOMPARE(parse->status, Status::Eof);
+            QCOMPARE(parse->data["mdat"].size(), 5000);
+        }
+        QCOMPARE(server.requests, 8);
+        QVERIFY(server.maxConcurrent <= 2);
+        QVERIFY(server.connections <= 2);
+        QTRY_COMPARE(pool.activeRequests(host), 0);
+        QCOMPARE(pool.queuedRequests(host), 0);
+    }
+
+    void dropQueuedTest()
+    {
+        HttpStandIn server(movie());
+        auto       &pool = HttpPool::forThread();
+        pool.setMaxConnectionsPerHost(1);
+
+        auto first  = std::make_unique<Parse>(server.url());
+        auto second = std::make_unique<Parse>(server.url());
+        auto host   = QString("127.0.0.1:%1").arg(server.serverPort());
+        QCOMPARE(pool.queuedRequests(host), 1);
+        second.reset();
+
+        QTRY_VERIFY_WITH_TIMEOUT(first->closed, 10000);
+        QCOMPARE(first->status, Status::Eof);
+        QTRY_COMPARE(pool.activeRequests(host), 0);
+        QCOMPARE(pool.queuedRequests(host), 0);
+        QCOMPARE(server.requests, 1);
+    }
+
+    void boundedBufferTest()
+    {
+        constexpr int    mdatSize   = 64 * 1024 * 1024;
+        constexpr qint64 bufferSize = 256 * 1024;
+
+        HttpStandIn server(movie(mdatSize), 0);
+        Parse       parse(server.url(), bufferSize, 64 * 1024);
+        parse.paused = true;
+
+        // the server writes everything at once but the reply holds only what it's allowed to
+        QTest::qWait(500);
+        QVERIFY(parse.unboxer.stream().bytesAvailable() > 0);
+        QVERIFY(parse.unboxer.stream().bytesAvailable() <= std::size_t(2 * bufferSize)); // give or take a socket read
+        QVERIFY(!parse.closed);
+
+        parse.paused = false;
+        parse.unboxer.read(64 * 1024);
+        QTRY_VERIFY_WITH_TIMEOUT(parse.closed, 30000);
+        QCOMPARE(parse.status, Status::Eof);
+        QCOMPARE(parse.data["mdat"].size(), mdatSize);
+    }
+};
+
+QTEST_MAIN(HttpPoolTest)
+
+#include "http_pool.moc"
@@ -0,0 +1,247 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTest>
+#include <QTimer>
+#include <QtEndian>
+
+#include <algorithm>
+
+#include "httppool.h"
+#include "inputhttprange_impl.h"
+#include "inputstreamer.h"
+#include "status.h"
+#include "testutil.h"
+#include "unboxer.h"
+
+using namespace unboxer;
+using namespace unboxer::testutil;
+
+// keep-alive HTTP/1.1 server answering Range requests with varying delays, so segments finish out of order
+class RangeStandIn : public QTcpServer {
+public:
+    RangeStandIn(const QByteArray &body, bool acceptRanges = true) : body(body), acceptRanges(acceptRanges)
+    {
+        listen(QHostAddress::LocalHost);
+        connect(this, &QTcpServer::newConnection, this, [this]() {
+            while (auto socket = nextPendingConnection()) {
+                connect(socket, &QTcpSocket::readyRead, socket, [this, socket]() { onReadyRead(socket); });
+            }
+        });
+    }
+    QString url() const { return QString("http://127.0.0.1:%1/master.mp4").arg(serverPort()); }
+
+    qint64 truncateAt    = -1; // the response covering this offset is cut there and the connection closed
+    int    delay         = -1; // ms every response is delayed by, so more connections give more throughput
+    int    requests      = 0;
+    int    maxConcurrent = 0;
+    qint64 bytesServed   = 0;
+
+private:
+    void onReadyRead(QTcpSocket *socket)
+    {
+        auto &buffer = buffers[socket];
+        buffer += socket->readAll();
+        int end;
+        while ((end = buffer.indexOf("\r\n\r\n")) >= 0) {
+            auto head = buffer.left(end);
+            buffer.remove(0, end + 4);
+            qint64 first  = 0;
+            qint64 last   = body.size() - 1;
+            bool   ranged = false;
+            for (auto const &line : head.split('\n')) {
+                auto header = line.trimmed();
+                if (acceptRanges && header.toLower().startsWith("range: bytes=")) {
+                    auto spec = header.mid(13).split('-');
+                    first     = spec[0].toLongLong();
+                    last      = qMin<qint64>(spec[1].toLongLong(), body.size() - 1);
+                    ranged    = true;
+                }
+            }
+            maxConcurrent = qMax(maxConcurrent, ++concurrent);
+            auto wait = delay >= 0 ? delay : 10 * (requests % 3);
+            requests++;
+            QTimer::singleShot(wait, socket, [=]() {
+                concurrent--;
+                respond(socket, ranged, first, last);
+            });
+        }
+    }
+
+    void respond(QTcpSocket *socket, bool ranged, qint64 first, qint64 last)
+    {
+        auto length = last - first + 1;
+        auto cut    = (truncateAt >= first && truncateAt <= last) ? truncateAt - first : length;
+        auto head   = ranged ? "HTTP/1.1 206 Partial Content\r\nContent-Range: bytes " + QByteArray::number(first) + '-'
+                + QByteArray::number(last) + '/' + QByteArray::number(body.size()) + "\r\n"
+                             : QByteArray("HTTP/1.1 200 OK\r\n");
+        socket->write(head + "Connection: keep-alive\r\nContent-Length: " + QByteArray::number(length) + "\r\n\r\n"
+                      + body.mid(first, cut));
+        bytesServed += cut;
+        if (cut < length) {
+            socket->disconnectFromHost();
+        }
+    }
+
+    QByteArray                      body;
+    bool                            acceptRanges;
+    QHash<QTcpSocket *, QByteArray> buffers;
+    int                             concurrent = 0;
+};
+
+class HttpRangeTest : public QObject {
+    Q_OBJECT
+
+    static QByteArray movie(int mdatSize)
+    {
+        auto moov = makeBox("moov", makeBox("mvhd", "MVHD"));
+        return makeBox("ftyp", "isom") + moov + makeBox("mdat", pattern(mdatSize));
+    }
+
+    struct Parse : testutil::Parse<InputHttpRangeImpl> {
+        Parse(const QString &url, const std::vector<QByteArray> &selection = {}, int maxConnections = 4) :
+            testutil::Parse<InputHttpRangeImpl>(url.toStdString())
+        {
+            input().setSegmentSize(64 * 1024);
+            input().setMaxConnections(maxConnections);
+            start(selection);
+        }
+    };
+
+private slots:
+
+    void initTestCase() { HttpPool::forThread().setHttp2Allowed(false); }
+
+    void orderTest()
+    {
+        constexpr int mdatSize = 3 * 1024 * 1024;
+        RangeStandIn  server(movie(mdatSize));
+        Parse         parse(server.url());
+        QTRY_VERIFY_WITH_TIMEOUT(parse.closed, 30000);
+        QCOMPARE(parse.status, Status::Eof);
+        QVERIFY(parse.data["mdat"] == pattern(mdatSize));
+        QCOMPARE(parse.unboxer.stream().input().totalSize(), qint64(movie(mdatSize).size()));
+        QVERIFY(server.requests > 1);
+        QVERIFY(server.maxConcurrent > 1);
+        QVERIFY(server.maxConcurrent <= parse.unboxer.stream().input().maxConnections());
+    }
+
+    void smallResourceTest()
+    {
+        RangeStandIn server(movie(1000)); // fits the first segment
+        Parse        parse(server.url());
+        QTRY_VERIFY_WITH_TIMEOUT(parse.closed, 10000);
+        QCOMPARE(parse.status, Status::Eof);
+        QVERIFY(parse.data["mdat"] == pattern(1000));
+        QCOMPARE(server.requests, 1);
+    }
+
+    void noRangeTest()
+    {
+        constexpr int mdatSize = 1024 * 1024;
+        RangeStandIn  server(movie(mdatSize), false);
+        Parse         parse(server.url());
+        QTRY_VERIFY_WITH_TIMEOUT(parse.closed, 30000);
+        QCOMPARE(parse.status, Status::Eof);
+        QVERIFY(parse.data["mdat"] == pattern(mdatSize));
+        QCOMPARE(server.requests, 1);
+    }
+
+    void skipTest()
+    {
+        constexpr int mdatSize = 16 * 1024 * 1024;
+        RangeStandIn  server(movie(mdatSize));
+        Parse         parse(server.url(), { "moov/mvhd" });
+        QTRY_VERIFY_WITH_TIMEOUT(parse.closed, 30000);
+        QCOMPARE(parse.status, Status::Eof);
+        QCOMPARE(parse.data["mvhd"], QByteArray("MVHD"));
+        QVERIFY(parse.data["mdat"].isEmpty());
+        QVERIFY(server.bytesServed < mdatSize / 4); // the window ahead at most
+    }
+
+    void skipBeyondEndTest()
+    {
+        // mdat claims more than the resource has. it can't be skipped, so the stream ends in the middle of it
+        constexpr int mdatSize = 1024 * 1024;
+        auto          data     = movie(mdatSize);
+        qToBigEndian<quint32>(quint32(8 + 2 * mdatSize), data.data() + data.indexOf("mdat") - 4);
+        RangeStandIn server(data);
+        Parse        parse(server.url(), { "moov/mvhd" });
+        QTRY_VERIFY_WITH_TIMEOUT(parse.closed, 30000);
+        QCOMPARE(parse.status, Status::Corrupted);
+        QCOMPARE(parse.data["mvhd"], QByteArray("MVHD"));
+    }
+
+    void adaptTest()
+    {
+        // with a fixed latency per segment the throughput grows with every connection added
+        constexpr int mdatSize = 8 * 1024 * 1024;
+        RangeStandIn  server(movie(mdatSize));
+        server.delay = 20;
+        Parse      parse(server.url(), {}, 6);
+        auto      &input = parse.unboxer.stream().input();
+        QList<int> observed { input.connections() };
+        QTimer     sampler;
+        connect(&sampler, &QTimer::timeout, this, [&]() {
+            if (observed.last() != input.connections()) {
+                observed << input.connections();
+            }
+        });
+        sampler.start(1);
+        QTRY_VERIFY_WITH_TIMEOUT(parse.closed, 30000);
+        QCOMPARE(parse.status, Status::Eof);
+        QVERIFY(parse.data["mdat"] == pattern(mdatSize));
+        QCOMPARE(observed.first(), 2);
+        QCOMPARE(*std::max_element(observed.begin(), observed.end()), 6);
+        QVERIFY(*std::min_element(observed.begin(), observed.end()) >= 1);
+        QVERIFY(server.maxConcurrent <= 6);
+
+        // never more than allowed, however it pays off
+        RangeStandIn single(movie(mdatSize / 8));
+        single.delay = 20;
+        Parse one(single.url(), {}, 1);
+        QTRY_VERIFY_WITH_TIMEOUT(one.closed, 30000);
+        QCOMPARE(one.status, Status::Eof);
+        QCOMPARE(one.unboxer.stream().input().connections(), 1);
+        QCOMPARE(single.maxConcurrent, 1);
+    }
+
+    void truncatedTest()
+    {
+        constexpr int mdatSize = 1024 * 1024;
+        RangeStandIn  server(movie(mdatSize));
+        server.truncateAt = mdatSize / 2;
+        Parse parse(server.url());
+        QTRY_VERIFY_WITH_TIMEOUT(parse.closed, 30000);
+        QCOMPARE(parse.status, Status::Corrupted);
+        QVERIFY(parse.data["mdat"].size() < mdatSize / 2);
+        QVERIFY(parse.data["mdat"] == pattern(mdatSize).left(parse.data["mdat"].size()));
+    }
+};
+
+QTEST_MAIN(HttpRangeTest)
+
+#include "http_range.moc"
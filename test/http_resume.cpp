@@ -0,0 +1,201 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTest>
+
+#include "httppool.h"
+#include "inputhttp_impl.h"
+#include "inputstreamer.h"
+#include "status.h"
+#include "testutil.h"
+#include "unboxer.h"
+
+using namespace unboxer;
+using namespace unboxer::testutil;
+
+// HTTP/1.1 server with Range and If-Range support dropping the connection after some bytes of every response
+class FlakyStandIn : public QTcpServer {
+public:
+    FlakyStandIn(const QByteArray &body) : body(body)
+    {
+        listen(QHostAddress::LocalHost);
+        connect(this, &QTcpServer::newConnection, this, [this]() {
+            while (auto socket = nextPendingConnection()) {
+                connect(socket, &QTcpSocket::readyRead, socket, [this, socket]() { onReadyRead(socket); });
+            }
+        });
+    }
+    QString url() const { return QString("http://127.0.0.1:%1/live.mp4").arg(serverPort()); }
+
+    qint64     dropAfter    = -1;   // bytes of body sent before the connection is closed. -1 - never
+    bool       acceptRanges = true; // otherwise "Accept-Ranges: none" and Range is ignored
+    int        changeAfter  = -1;   // requests after which the resource gets another ETag
+    QByteArray etag         = "\"v1\"";
+
+    QList<QByteArray> ranges;   // of every request. empty if none
+    QList<QByteArray> ifRanges; // of every request. empty if none
+
+private:
+    void onReadyRead(QTcpSocket *socket)
+    {
+        auto &buffer = buffers[socket];
+        buffer += socket->readAll();
+        int end;
+        while ((end = buffer.indexOf("\r\n\r\n")) >= 0) {
+            auto head = buffer.left(end);
+            buffer.remove(0, end + 4);
+            QByteArray range, ifRange;
+            for (auto const &line : head.split('\n')) {
+                auto header = line.trimmed();
+                if (header.toLower().startsWith("range: ")) {
+                    range = header.mid(7);
+                } else if (header.toLower().startsWith("if-range: ")) {
+                    ifRange = header.mid(10);
+                }
+            }
+            ranges << range;
+            ifRanges << ifRange;
+            respond(socket, range, ifRange);
+            if (ranges.size() - 1 == changeAfter) {
+                etag = "\"v2\"";
+            }
+        }
+    }
+
+    void respond(QTcpSocket *socket, const QByteArray &range, const QByteArray &ifRange)
+    {
+        bool   ranged = acceptRanges && range.startsWith("bytes=") && (ifRange.isEmpty() || ifRange == etag);
+        qint64 first  = ranged ? range.mid(6, range.indexOf('-') - 6).toLongLong() : 0;
+        qint64 length = body.size() - first;
+        qint64 cut    = dropAfter >= 0 ? qMin(dropAfter, length) : length;
+        auto   span   = QByteArray::number(first) + '-' + QByteArray::number(body.size() - 1) + '/'
+            + QByteArray::number(body.size());
+        auto head = ranged ? "HTTP/1.1 206 Partial Content\r\nContent-Range: bytes " + span + "\r\n"
+                           : QByteArray("HTTP/1.1 200 OK\r\n");
+        head += "ETag: " + etag + "\r\nAccept-Ranges: " + (acceptRanges ? "bytes" : "none") + "\r\n";
+        socket->write(head + "Connection: keep-alive\r\nContent-Length: " + QByteArray::number(length) + "\r\n\r\n"
+                      + body.mid(first, cut));
+        if (cut < length) {
+            socket->disconnectFromHost();
+        }
+    }
+
+    QByteArray                      body;
+    QHash<QTcpSocket *, QByteArray> buffers;
+};
+
+class HttpResumeTest : public QObject {
+    Q_OBJECT
+
+    static constexpr int MDAT_SIZE = 1024 * 1024;
+    static constexpr int HEAD_SIZE = 12 + 20 + 8; // ftyp, moov and the mdat header
+
+    static QByteArray movie()
+    {
+        auto moov = makeBox("moov", makeBox("mvhd", "MVHD"));
+        return makeBox("ftyp", "isom") + moov + makeBox("mdat", pattern(MDAT_SIZE));
+    }
+
+    struct Parse : testutil::Parse<InputHttpImpl> {
+        Parse(const QString &url, int maxResumes = InputHttpImpl::DEFAULT_MAX_RESUMES) :
+            testutil::Parse<InputHttpImpl>(url.toStdString())
+        {
+            input().setMaxResumes(maxResumes);
+            input().setResumeDelay(10);
+            start();
+        }
+    };
+
+private slots:
+
+    void initTestCase() { HttpPool::forThread().setHttp2Allowed(false); }
+
+    void resumeTest()
+    {
+        FlakyStandIn server(movie());
+        server.dropAfter = 100 * 1024;
+        Parse parse(server.url());
+        QTRY_VERIFY_WITH_TIMEOUT(parse.closed, 30000);
+        QCOMPARE(parse.status, Status::Eof);
+        QVERIFY(parse.data["mdat"] == pattern(MDAT_SIZE));
+        QCOMPARE(server.ranges.size(), (movie().size() + 100 * 1024 - 1) / (100 * 1024));
+        QCOMPARE(parse.unboxer.stream().input().resumes(), server.ranges.size() - 1);
+        // every request continues where the previous one was cut and makes sure it's the same resource
+        QVERIFY(server.ranges[0].isEmpty());
+        for (int i = 1; i < server.ranges.size(); i++) {
+            QCOMPARE(server.ranges[i], "bytes=" + QByteArray::number(i * 100 * 1024) + '-');
+            QCOMPARE(server.ifRanges[i], QByteArray("\"v1\""));
+        }
+    }
+
+    void changedTest()
+    {
+        // If-Range doesn't match, so the whole new resource comes back. it must not be spliced to the old one
+        FlakyStandIn server(movie());
+        server.dropAfter   = 100 * 1024;
+        server.changeAfter = 0;
+        Parse parse(server.url());
+        QTRY_VERIFY_WITH_TIMEOUT(parse.closed, 30000);
+        QCOMPARE(parse.status, Status::Corrupted);
+        QCOMPARE(server.ranges.size(), 2);
+        QCOMPARE(parse.data["mdat"].size(), 100 * 1024 - HEAD_SIZE);
+        QVERIFY(parse.data["mdat"] == pattern(MDAT_SIZE).left(parse.data["mdat"].size()));
+    }
+
+    void noRangesTest()
+    {
+        FlakyStandIn server(movie());
+        server.dropAfter    = 100 * 1024;
+        server.acceptRanges = false;
+        Parse parse(server.url());
+        QTRY_VERIFY_WITH_TIMEOUT(parse.closed, 30000);
+        QCOMPARE(parse.status, Status::Corrupted);
+        QCOMPARE(server.ranges.size(), 1);
+    }
+
+    void limitTest()
+    {
+        // the connection is lost before any data, so no attempt makes progress
+        FlakyStandIn server(movie());
+        server.dropAfter = 0;
+        Parse parse(server.url(), 2);
+        QTRY_VERIFY_WITH_TIMEOUT(parse.closed, 30000);
+        QCOMPARE(parse.status, Status::Corrupted);
+        QCOMPARE(server.ranges.size(), 3);
+        QCOMPARE(parse.unboxer.stream().input().resumes(), 2);
+
+        FlakyStandIn once(movie());
+        once.dropAfter = 100 * 1024;
+        Parse disabled(once.url(), 0);
+        QTRY_VERIFY_WITH_TIMEOUT(disabled.closed, 30000);
+        QCOMPARE(disabled.status, Status::Corrupted);
+        QCOMPARE(once.ranges.size(), 1);
+    }
+};
+
+QTEST_MAIN(HttpResumeTest)
+
+#include "http_resume.moc"
@@ -0,0 +1,127 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <QTest>
+
+#include "inputmemory_impl.h"
+#include "inputstreamer.h"
+#include "status.h"
+#include "testutil.h"
+#include "unboxer.h"
+
+using namespace unboxer;
+using namespace unboxer::testutil;
+using MemUnboxer = unboxer::Unboxer<InputMemoryImpl, NullCache>;
+
+class MemBudgetTest : public QObject {
+    Q_OBJECT
+
+    static QByteArray nested(int depth)
+    {
+        auto box = makeBox("free");
+        while (depth--) {
+            box = makeBox("traf", box);
+        }
+        return makeBox("moof", box);
+    }
+
+    static QByteArray flood(int count)
+    {
+        QByteArray data;
+        while (count--) {
+            data += makeBox("free");
+        }
+        return data;
+    }
+
+    Status parse(const QByteArray &data, const ParseBudget &budget, std::size_t chunkSize = 4096)
+    {
+        bool   closed = false;
+        Status status = Status::Ok;
+        auto   base64 = data.toBase64();
+
+        MemUnboxer unboxer(base64.toStdString());
+        unboxer.setBudget(budget);
+        unboxer.setStreamClosedCallback([&](Status reason) mutable {
+            closed = true;
+            status = reason;
+        });
+        unboxer.open();
+        while (!closed) {
+            unboxer.read(chunkSize);
+        }
+        return status;
+    }
+
+private slots:
+
+    void unlimitedTest()
+    {
+        QCOMPARE(parse(nested(100), ParseBudget {}), Status::Eof);
+        QCOMPARE(parse(flood(10000), ParseBudget {}), Status::Eof);
+    }
+
+    void depthTest()
+    {
+        ParseBudget budget;
+        budget.maxDepth = 5;
+        QCOMPARE(parse(nested(3), budget), Status::Eof); // moof + 3 traf + free
+        QCOMPARE(parse(nested(4), budget), Status::BudgetExceeded);
+    }
+
+    void boxCountTest()
+    {
+        ParseBudget budget;
+        budget.maxBoxes = 100;
+        QCOMPARE(parse(flood(100), budget), Status::Eof);
+        QCOMPARE(parse(flood(101), budget), Status::BudgetExceeded);
+    }
+
+    void headerRateTest()
+    {
+        ParseBudget budget;
+        budget.maxHeadersPerMB = 1000;
+        QCOMPARE(parse(flood(1000), budget), Status::Eof);
+        QCOMPARE(parse(flood(1001), budget), Status::BudgetExceeded);
+
+        // the same amount of boxes is fine when they carry some payload
+        QByteArray data;
+        for (int i = 0; i < 2000; i++) {
+            data += makeBox("mdat", QByteArray(2048, 'x'));
+        }
+        QCOMPARE(parse(data, budget), Status::Eof);
+    }
+
+    void bufferedBytesTest()
+    {
+        ParseBudget budget;
+        budget.maxBufferedBytes = 4;
+        QCOMPARE(parse(flood(10), budget, 8), Status::Eof);
+        QCOMPARE(parse(flood(10), budget, 5), Status::BudgetExceeded); // 5 bytes of a header have to wait for more
+    }
+};
+
+QTEST_MAIN(MemBudgetTest)
+
+#include "mem_budget.moc"
@@ -0,0 +1,243 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <QTest>
+
+#include <cstring>
+
+#include "inputbuffer_impl.h"
+#include "inputmemory_impl.h"
+#include "inputstreamer.h"
+#include "slice.h"
+#include "status.h"
+#include "testutil.h"
+#include "threadedunboxer.h"
+#include "unboxer.h"
+
+using namespace unboxer;
+using namespace unboxer::testutil;
+using BufferUnboxer         = unboxer::Unboxer<InputBufferImpl, NullCache>;
+using ThreadedBufferUnboxer = unboxer::ThreadedUnboxer<InputBufferImpl, NullCache>;
+
+class MemBufferTest : public QObject {
+    Q_OBJECT
+
+    static QByteArray movie()
+    {
+        auto trak = makeBox("trak", makeBox("tkhd", QByteArray(84, 't')));
+        return makeBox("ftyp", "isom") + makeBox("moov", makeBox("mvhd", QByteArray(100, 'v')) + trak)
+            + makeBox("mdat", QByteArray(100000, 'x')) + makeBox("free", "tail");
+    }
+
+    // "open type", "close type" and payload of every blob
+    struct Log {
+        QStringList events;
+        QByteArray  data;
+        bool        closed = false;
+        Status      status = Status::Ok;
+
+        void setup(Box::Ptr box)
+        {
+            events << "open " + box->type;
+            box->onSubBoxOpen = [this](Box::Ptr box) { setup(box); };
+            box->onDataRead   = [this](const QByteArray &chunk) {
+                data += chunk;
+                return Status::Ok;
+            };
+            box->onClose = [this, type = box->type]() {
+                events << "close " + type;
+                return Status::Ok;
+            };
+        }
+    };
+
+    template <class SourceArg> static Log parse(SourceArg &&source, std::size_t readSize = 1000)
+    {
+        Log           log;
+        BufferUnboxer unboxer(std::forward<SourceArg>(source));
+        unboxer.setStreamOpenedCallback([&](Box::Ptr root) { root->onSubBoxOpen = [&](Box::Ptr box) { log.setup(box); }; });
+        unboxer.setStreamClosedCallback([&](Status reason) {
+            log.closed = true;
+            log.status = reason;
+        });
+        unboxer.open();
+        while (!log.closed) {
+            unboxer.read(readSize);
+        }
+        return log;
+    }
+
+    static Log expected()
+    {
+        Log                                 log;
+        Unboxer<InputMemoryImpl, NullCache> unboxer(movie().toBase64().toStdString());
+        unboxer.setStreamOpenedCallback([&](Box::Ptr root) { root->onSubBoxOpen = [&](Box::Ptr box) { log.setup(box); }; });
+        unboxer.setStreamClosedCallback([&](Status reason) {
+            log.closed = true;
+            log.status = reason;
+        });
+        unboxer.open();
+        while (!log.closed) {
+            unboxer.read(1000);
+        }
+        return log;
+    }
+
+private slots:
+
+    void byteArrayTest()
+    {
+        auto log = parse(movie());
+        QCOMPARE(log.status, Status::Eof);
+        QCOMPARE(log.events, expected().events);
+        QCOMPARE(log.data, expected().data);
+    }
+
+    void wholeArrayIsSharedTest()
+    {
+        auto                    data = movie();
+        std::vector<QByteArray> chunks;
+        BufferUnboxer           unboxer(data);
+        unboxer.setStreamOpenedCallback([&](Box::Ptr root) {
+            root->onSubBoxOpen = [&](Box::Ptr box) {
+                box->onDataRead = [&](const QByteArray &chunk) {
+                    chunks.push_back(chunk);
+                    return Status::Ok;
+                };
+            };
+        });
+        unboxer.open();
+        unboxer.read(data.size()); // all at once
+        QVERIFY(!chunks.empty());
+        // slices of the very same memory
+        QVERIFY(chunks.front().constData() >= data.constData());
+        QVERIFY(chunks.front().constData() < data.constData() + data.size());
+    }
+
+    void externalMemoryTest()
+    {
+        auto               data  = std::make_shared<QByteArray>(movie());
+        std::weak_ptr<int> alive = std::shared_ptr<int>(data, nullptr); // aliasing, to see when the owner is released
+        {
+            MemoryBuffer buffer(data->constData(), data->size(), data);
+            auto         raw = data.get();
+            data.reset();
+            QVERIFY(!alive.expired()); // held by the buffer
+            auto log = parse(buffer);
+            QCOMPARE(log.status, Status::Eof);
+            QCOMPARE(log.events, expected().events);
+            QCOMPARE(log.data.size(), expected().data.size());
+            QVERIFY(raw->size() > 0);
+        }
+        QVERIFY(alive.expired());
+    }
+
+    void scatteredTest()
+    {
+        // parts split in the middle of headers and payloads
+        auto              data = movie();
+        QList<QByteArray> parts;
+        for (int offset = 0, size = 1; offset < data.size(); offset += size, size = size * 3 + 1) {
+            parts << data.mid(offset, size);
+        }
+        QVERIFY(parts.size() > 5);
+        for (std::size_t readSize : { 1, 7, 1000, 1 << 20 }) {
+            auto log = parse(parts, readSize);
+            QCOMPARE(log.status, Status::Eof);
+            QCOMPARE(log.events, expected().events);
+            QCOMPARE(log.data, expected().data);
+        }
+    }
+
+    void skipAcrossPartsTest()
+    {
+        auto         data   = movie();
+        auto         mdat   = data.indexOf("mdat") - 4;
+        MemoryBuffer buffer = QList<QByteArray>() << data.left(mdat + 100) << data.mid(mdat + 100, 50000)
+                                                  << data.mid(mdat + 50100);
+        QByteArray    tail;
+        bool          closed = false;
+        BufferUnboxer unboxer(buffer);
+        unboxer.setSelection({ "free" }, [&](Box::Ptr box) {
+            box->onDataRead = [&](const QByteArray &chunk) {
+                tail += chunk;
+                return Status::Ok;
+            };
+        });
+        unboxer.setStreamClosedCallback([&](Status) { closed = true; });
+        unboxer.open();
+        while (!closed) {
+            unboxer.read(1000);
+        }
+        QCOMPARE(tail, QByteArray("tail"));
+        QVERIFY(unboxer.stream().bytesRead() < std::uint64_t(data.size()) / 2);
+    }
+
+    void emptyTest()
+    {
+        auto log = parse(MemoryBuffer());
+        QCOMPARE(log.status, Status::Eof);
+        QVERIFY(log.events.isEmpty());
+    }
+
+    void threadedTest()
+    {
+        QList<QByteArray> parts;
+        parts << movie().left(1000) << movie().mid(1000);
+
+        Log                   log;
+        ThreadedBufferUnboxer threaded(MemoryBuffer(parts), ContainerRegistry::isoBmff(), 1000);
+        threaded.setStreamOpenedCallback([&](Box::Ptr root) { root->onSubBoxOpen = [&](Box::Ptr box) { log.setup(box); }; });
+        threaded.setStreamClosedCallback([&](Status reason) {
+            log.closed = true;
+            log.status = reason;
+        });
+        threaded.open();
+        QTRY_VERIFY_WITH_TIMEOUT(log.closed, 10000);
+        QCOMPARE(log.status, Status::Eof);
+        QCOMPARE(log.events, expected().events);
+        QCOMPARE(log.data, expected().data);
+    }
+
+    void slicerReusedAddressTest()
+    {
+        // the source freed the buffer of the previous feed and the next one got the same memory
+        QByteArray   memory("first feed");
+        auto         raw = QByteArray::fromRawData(memory.constData(), memory.size());
+        BufferSlicer slicer;
+        auto         first = slicer.slice(raw, 1, QByteArray::fromRawData(raw.constData(), 5));
+        std::memcpy(memory.data(), "later data", 10);
+        auto second = slicer.slice(raw, 2, QByteArray::fromRawData(raw.constData(), 5));
+        QCOMPARE(first.data(), QByteArray("first"));
+        QCOMPARE(second.data(), QByteArray("later"));
+        // slices of one feed share the copy
+        auto third = slicer.slice(raw, 2, QByteArray::fromRawData(raw.constData() + 6, 4));
+        QCOMPARE(third.data(), QByteArray("data"));
+        QCOMPARE(third.data().constData(), second.data().constData() + 6);
+    }
+};
+
+QTEST_MAIN(MemBufferTest)
+
+#include "mem_buffer.moc"
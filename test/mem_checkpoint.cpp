@@ -0,0 +1,249 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <QTest>
+#include <QtEndian>
+
+#include <algorithm>
+#include <memory>
+
+#include "boxreader.h"
+#include "inputbuffer_impl.h"
+#include "status.h"
+#include "testutil.h"
+#include "unboxer.h"
+
+using namespace unboxer;
+using namespace unboxer::testutil;
+using BufferUnboxer = unboxer::Unboxer<InputBufferImpl, NullCache>;
+
+class MemCheckpointTest : public QObject {
+    Q_OBJECT
+
+    // 12 bytes of ftyp, 52 bytes of meta with largesize and a FullBox preamble, then 384 bytes per fragment
+    static QByteArray stream()
+    {
+        auto meta = makeLargeBox("meta",
+                                 QByteArray(4, 'v') + makeBox("hdlr", QByteArray(12, 'h')) + makeBox("free", "pad!"));
+        auto data = makeBox("ftyp", "isom") + meta;
+        for (int i = 0; i < 3; i++) {
+            auto traf = makeBox("traf", makeBox("tfhd", QByteArray(8, 't')) + makeBox("trun", QByteArray(20, 'r')));
+            data += makeBox("moof", makeBox("mfhd", QByteArray(8, 'f')) + traf) + makeBox("mdat", QByteArray(300, 'x'));
+        }
+        return data;
+    }
+
+    struct Run {
+        QStringList               events;    // "open type", "close type" and "close type size" of blobs
+        std::vector<int>          callbacks; // of open, data and close. the number of events at the time
+        std::optional<Checkpoint> checkpoint;
+        int                       eventsAtCheckpoint = 0;
+        std::uint64_t             bytesRead          = 0;
+        Status                    status             = Status::Ok;
+    };
+
+    // takes a checkpoint at the given callback (open, data or close) and stops reading soon after, like a killed job
+    static Run parse(const QByteArray &data, int checkpointAt = -1, const std::optional<Checkpoint> &resumeFrom = {})
+    {
+        Run           run;
+        bool          closed = false;
+        BufferUnboxer unboxer(data);
+        auto          callback = [&]() {
+            run.callbacks.push_back(run.events.size());
+            if (int(run.callbacks.size()) == checkpointAt) {
+                run.checkpoint         = unboxer.checkpoint();
+                run.eventsAtCheckpoint = run.events.size();
+            }
+        };
+        std::function<void(Box::Ptr)> setup = [&](Box::Ptr box) {
+            run.events << "open " + box->type;
+            callback();
+            auto fed          = std::make_shared<int>(0);
+            box->onSubBoxOpen = setup;
+            if (!box->isContainer) {
+                box->onDataRead = [&, fed](const QByteArray &data) {
+                    *fed += data.size();
+                    callback();
+                    return Status::Ok;
+                };
+            }
+            box->onClose = [&, box = box.get(), fed]() {
+                run.events << (box->isContainer ? "close " + box->type
+                                                : QString("close %1 %2").arg(QString(box->type)).arg(*fed));
+                callback();
+                return Status::Ok;
+            };
+        };
+        if (resumeFrom) {
+            unboxer.resumeFrom(*resumeFrom);
+        }
+        unboxer.setStreamOpenedCallback([&](Box::Ptr root) { root->onSubBoxOpen = setup; });
+        unboxer.setStreamClosedCallback([&](Status reason) {
+            closed     = true;
+            run.status = reason;
+        });
+        unboxer.open();
+        while (!closed && !run.checkpoint) {
+            unboxer.read(7);
+        }
+        run.bytesRead = unboxer.stream().bytesRead();
+        return run;
+    }
+
+    // number of the callback called for the event or the n-th one after it
+    static int callbackAfter(const Run &run, int event, int n = 0)
+    {
+        auto it = std::find(run.callbacks.begin(), run.callbacks.end(), event + 1);
+        return int(it - run.callbacks.begin()) + 1 + n;
+    }
+
+private slots:
+
+    void resumeAnywhereTest()
+    {
+        auto data = stream();
+        auto full = parse(data);
+        QCOMPARE(full.status, Status::Eof);
+
+        for (int at = 1; at <= int(full.callbacks.size()); at++) {
+            auto interrupted = parse(data, at);
+            QVERIFY(interrupted.checkpoint);
+            auto checkpoint = Checkpoint::fromByteArray(interrupted.checkpoint->toByteArray());
+            QVERIFY(checkpoint);
+            QCOMPARE(checkpoint->offset, interrupted.checkpoint->offset);
+
+            auto resumed = parse(data, -1, checkpoint);
+            QCOMPARE(resumed.status, Status::Eof);
+            QCOMPARE(resumed.bytesRead, std::uint64_t(data.size()) - checkpoint->offset); // skipped, not read
+            // the open containers come first, then everything goes on as if there was no interruption
+            QStringList reopened;
+            for (auto const &container : checkpoint->containers) {
+                reopened << "open " + container.type;
+            }
+            QCOMPARE(resumed.events.mid(0, reopened.size()), reopened);
+            auto rest = resumed.events.mid(reopened.size());
+            auto from = full.events.size() - rest.size();
+            QVERIFY(from <= interrupted.eventsAtCheckpoint); // nothing after the checkpoint is lost
+            QCOMPARE(rest, full.events.mid(from));
+        }
+    }
+
+    void boundaryTest()
+    {
+        auto data = stream();
+        auto full = parse(data);
+        // in the middle of the second trun: moof and traf are open and the trun is read again
+        auto trun       = full.events.indexOf("open trun", full.events.indexOf("open trun") + 1);
+        auto checkpoint = *parse(data, callbackAfter(full, trun, 1)).checkpoint;
+        QCOMPARE(checkpoint.offset, std::uint64_t(64 + 384 + 8 + 16 + 8 + 16));
+        QCOMPARE(checkpoint.containers.size(), std::size_t(2));
+        QCOMPARE(checkpoint.containers[0].type, QByteArray("moof"));
+        QCOMPARE(checkpoint.containers[0].offset, std::uint64_t(64 + 384));
+        QCOMPARE(checkpoint.containers[1].type, QByteArray("traf"));
+        QCOMPARE(checkpoint.containers[1].childrenSize, std::uint64_t(44));
+
+        // in the middle of hdlr: meta's preamble isn't delivered again, its largesize header is restored
+        auto hdlr = parse(data, callbackAfter(full, full.events.indexOf("open hdlr"), 1)).checkpoint;
+        QVERIFY(hdlr);
+        QCOMPARE(hdlr->offset, std::uint64_t(12 + 16 + 4));
+        QCOMPARE(hdlr->containers.size(), std::size_t(1));
+        QCOMPARE(hdlr->containers[0].header(), data.mid(12, 16));
+        QCOMPARE(hdlr->containers[0].childrenOffset, std::uint64_t(12 + 16 + 4));
+
+        // while moof is being closed it's still there, to be opened and closed again
+        auto moof = parse(data, callbackAfter(full, full.events.indexOf("close moof"))).checkpoint;
+        QVERIFY(moof);
+        QCOMPARE(moof->offset, std::uint64_t(64 + 76));
+        QCOMPARE(moof->containers.size(), std::size_t(1));
+        auto resumed = parse(data, -1, moof);
+        QCOMPARE(resumed.events.mid(0, 3), QStringList() << "open moof" << "close moof" << "open mdat");
+    }
+
+    void serializationTest()
+    {
+        Checkpoint::Container uuid { QByteArray(16, 'u'), 1000, 0, 40, 40, 960 };
+        auto                  header = uuid.header();
+        QCOMPARE(header.size(), 40);
+        QCOMPARE(qFromBigEndian<quint32>(header.constData()), quint32(1));
+        QCOMPARE(header.mid(4, 4), QByteArray("uuid"));
+        QCOMPARE(qFromBigEndian<quint64>(header.constData() + 8), quint64(1000));
+        QCOMPARE(header.mid(24), QByteArray(16, 'u'));
+
+        Checkpoint checkpoint;
+        checkpoint.offset     = 500;
+        checkpoint.boxCount   = 3;
+        checkpoint.containers = { uuid, { "moof", 500, 100, 8, 108, 492 } };
+        auto data             = checkpoint.toByteArray();
+        auto restored         = Checkpoint::fromByteArray(data);
+        QVERIFY(restored);
+        QCOMPARE(restored->boxCount, std::uint64_t(3));
+        QCOMPARE(restored->containers.size(), std::size_t(2));
+        QCOMPARE(restored->containers[1].childrenOffset, std::uint64_t(108));
+
+        QVERIFY(!Checkpoint::fromByteArray(data.chopped(1)));
+        QVERIFY(!Checkpoint::fromByteArray(data + QByteArray("x")));
+        QVERIFY(!Checkpoint::fromByteArray("UBCP"));
+        // moof ends before the offset, so it couldn't be open there
+        checkpoint.offset = 600;
+        QVERIFY(!Checkpoint::fromByteArray(checkpoint.toByteArray()));
+    }
+
+    void readThroughTest()
+    {
+        // without a way to skip everything is fed, but nothing before the checkpoint is parsed
+        auto data       = stream();
+        auto full       = parse(data);
+        auto checkpoint = *parse(data, int(full.callbacks.size()) / 2).checkpoint;
+        auto resumed    = parse(data, -1, checkpoint);
+
+        QStringList opened;
+        BoxReader   reader(
+            [&](const QByteArray &type, std::uint64_t, std::uint64_t) -> BoxDecision {
+                opened << "open " + type;
+                if (type == "meta") {
+                    return { BoxAction::Recurse, 4 };
+                }
+                return type == "moof" || type == "traf" ? BoxAction::Recurse : BoxAction::Blob;
+            },
+            []() {},
+            [](const QByteArray &) { return Status::Ok; });
+        reader.resume(checkpoint);
+        for (int offset = 0; offset < data.size(); offset += 7) {
+            QCOMPARE(reader.feed(data.mid(offset, 7)), Status::Ok);
+        }
+        QCOMPARE(reader.close(Status::Eof), Status::Eof);
+        QCOMPARE(opened, resumed.events.filter("open "));
+
+        // the data ends before the checkpoint
+        BoxReader truncated([](const QByteArray &, std::uint64_t, std::uint64_t) { return BoxAction::Skip; },
+                            []() {},
+                            [](const QByteArray &) { return Status::Ok; });
+        truncated.resume(checkpoint);
+        QCOMPARE(truncated.feed(data.left(int(checkpoint.offset) - 1)), Status::Ok);
+        QCOMPARE(truncated.close(Status::Eof), Status::Corrupted);
+    }
+};
+
+QTEST_MAIN(MemCheckpointTest)
+#include "mem_checkpoint.moc"
@@ -0,0 +1,209 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <QTest>
+#include <QTimer>
+
+#include <coroutine>
+
+#include "coro.h"
+#include "inputmemory_impl.h"
+#include "inputstreamer.h"
+#include "status.h"
+#include "testutil.h"
+#include "unboxer.h"
+
+using namespace unboxer;
+using namespace unboxer::testutil;
+
+// memory source which delivers everything from the event loop, like network sources do
+class DelayedMemorySource {
+    std::function<void()>                   openedCallback;
+    std::function<void()>                   dataReadyCallback;
+    std::function<void(const QByteArray &)> dataReadCallback;
+    std::function<void(Status)>             closedCallback;
+
+    QByteArray data;
+    int        offset = 0;
+    QObject    context;
+
+public:
+    template <typename OpenedCB, typename DataReadyCB, typename DataReadCB, typename ClosedCB>
+    DelayedMemorySource(const std::string &base64data,
+                        OpenedCB         &&openedCallback,
+                        DataReadyCB      &&dataReadyCallback,
+                        DataReadCB       &&dataReadCallback,
+                        ClosedCB         &&closedCallback) :
+        openedCallback(std::move(openedCallback)),
+        dataReadyCallback(std::move(dataReadyCallback)), dataReadCallback(std::move(dataReadCallback)),
+        closedCallback(std::move(closedCallback)), data(QByteArray::fromBase64(base64data.c_str()))
+    {
+    }
+    void open() { QTimer::singleShot(0, &context, [this]() { openedCallback(); }); }
+    void read(std::size_t size)
+    {
+        QTimer::singleShot(0, &context, [this, size]() {
+            auto chunk = data.mid(offset, int(size));
+            offset += chunk.size();
+            dataReadCallback(chunk);
+            if (offset < data.size()) {
+                dataReadyCallback();
+            } else {
+                closedCallback(Status::Eof);
+            }
+        });
+    }
+    void reset() { data.clear(); }
+};
+
+// fire and forget coroutine
+struct Task {
+    struct promise_type {
+        Task                get_return_object() { return {}; }
+        std::suspend_never  initial_suspend() noexcept { return {}; }
+        std::suspend_never  final_suspend() noexcept { return {}; }
+        void                return_void() { }
+        void                unhandled_exception() { std::terminate(); }
+    };
+};
+
+class MemCoroTest : public QObject {
+    Q_OBJECT
+
+    static QByteArray mdatPayload() { return QByteArray(50000, 'm'); }
+
+    static QByteArray movie()
+    {
+        auto meta = makeBox("meta", QByteArray::fromHex("00000000") + makeBox("hdlr", "HDLR"));
+        auto trak = makeBox("trak", makeBox("tkhd", "TKHD"));
+        auto moov = makeBox("moov", makeBox("mvhd", "MVHD") + trak + makeBox("udta", meta));
+        return makeBox("ftyp", "isom") + moov + makeBox("mdat", mdatPayload()) + makeBox("free", "end");
+    }
+
+    // events of a plain callback based parse
+    static QStringList expectedEvents()
+    {
+        QStringList                   events;
+        bool                          closed = false;
+        std::function<void(Box::Ptr)> setup  = [&](Box::Ptr box) {
+            events << QString("open %1 %2").arg(QString(box->type)).arg(box->fileOffset);
+            box->onSubBoxOpen = setup;
+            box->onDataRead   = [&, box](const QByteArray &data) {
+                events << QString("data %1 %2").arg(QString(box->type)).arg(data.size());
+                return Status::Ok;
+            };
+            box->onClose = [&, box]() {
+                events << QString("close %1").arg(QString(box->type));
+                return Status::Ok;
+            };
+        };
+        Unboxer<InputMemoryImpl, NullCache> unboxer(movie().toBase64().toStdString());
+        unboxer.setStreamOpenedCallback([&](Box::Ptr root) { root->onSubBoxOpen = setup; });
+        unboxer.setStreamClosedCallback([&](Status) { closed = true; });
+        unboxer.open();
+        while (!closed) {
+            unboxer.read(1000);
+        }
+        return events;
+    }
+
+    template <class Source> static Task collectEvents(BoxEventStream<Source, NullCache> &stream, QStringList &events,
+                                                      bool &done)
+    {
+        while (auto event = co_await stream.next()) {
+            auto type = event->box ? QString(event->box->type) : QString();
+            switch (event->type) {
+            case BoxEvent::BoxOpened:
+                events << QString("open %1 %2").arg(type).arg(event->box->fileOffset);
+                break;
+            case BoxEvent::Data:
+                events << QString("data %1 %2").arg(type).arg(event->data.size());
+                break;
+            case BoxEvent::BoxClosed:
+                events << QString("close %1").arg(type);
+                break;
+            default:
+                break;
+            }
+        }
+        done = true;
+    }
+
+private slots:
+
+    void eventsTest()
+    {
+        QStringList                                events;
+        bool                                       done = false;
+        BoxEventStream<InputMemoryImpl, NullCache> stream(movie().toBase64().toStdString(),
+                                                          ContainerRegistry::isoBmff(), 1000);
+        collectEvents(stream, events, done);
+        QVERIFY(done); // memory source never makes it wait
+        QCOMPARE(stream.status(), Status::Eof);
+        QCOMPARE(events, expectedEvents());
+    }
+
+    void boxDataTest()
+    {
+        QStringList                                types;
+        QByteArray                                 mdat;
+        QList<Slice>                               kept;
+        BoxEventStream<InputMemoryImpl, NullCache> stream(movie().toBase64().toStdString(),
+                                                          ContainerRegistry::isoBmff(), 333);
+        [&]() -> Task {
+            while (auto box = co_await stream.nextBox()) {
+                types << box->type;
+                if (box->type == "mdat") {
+                    while (auto data = co_await stream.readData(box)) {
+                        kept << *data;
+                    }
+                }
+            }
+        }();
+        QVERIFY(stream.isClosed());
+        for (auto const &slice : kept) {
+            mdat += slice.data(); // slices stay valid after the parse
+        }
+        QCOMPARE(mdat, mdatPayload());
+        QCOMPARE(types,
+                 QStringList({ "ftyp", "moov", "mvhd", "trak", "tkhd", "udta", "meta", "hdlr", "mdat", "free" }));
+    }
+
+    void suspendTest()
+    {
+        QStringList                                    events;
+        bool                                           done = false;
+        BoxEventStream<DelayedMemorySource, NullCache> stream(movie().toBase64().toStdString(),
+                                                              ContainerRegistry::isoBmff(), 1000);
+        collectEvents(stream, events, done);
+        QVERIFY(!done);
+        QTRY_VERIFY_WITH_TIMEOUT(done, 10000);
+        QCOMPARE(stream.status(), Status::Eof);
+        QCOMPARE(events, expectedEvents());
+    }
+};
+
+QTEST_MAIN(MemCoroTest)
+
+#include "mem_coro.moc"
@@ -0,0 +1,146 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <QTest>
+
+#include "inputmemory_impl.h"
+#include "inputstreamer.h"
+#include "status.h"
+#include "testutil.h"
+#include "unboxer.h"
+
+using namespace unboxer;
+using namespace unboxer::testutil;
+using MemUnboxer = unboxer::Unboxer<InputMemoryImpl, NullCache>;
+
+class MemFanoutTest : public QObject {
+    Q_OBJECT
+
+    static QByteArray moov()
+    {
+        auto meta = makeBox("meta", QByteArray::fromHex("00000000") + makeBox("hdlr", "HDLR"));
+        auto trak = makeBox("trak", makeBox("tkhd", "TKHD"));
+        return makeBox("moov", makeBox("mvhd", "MVHD") + trak + makeBox("udta", meta));
+    }
+
+    static QByteArray movie() { return makeBox("ftyp", "isom") + moov() + makeBox("mdat", QByteArray(100000, 'x')); }
+
+    static Status run(MemUnboxer &unboxer, std::size_t chunkSize = 4096)
+    {
+        bool   closed = false;
+        Status status = Status::Ok;
+        unboxer.setStreamClosedCallback([&](Status reason) mutable {
+            closed = true;
+            status = reason;
+        });
+        unboxer.open();
+        while (!closed) {
+            unboxer.read(chunkSize);
+        }
+        return status;
+    }
+
+private slots:
+
+    void sharedDataTest()
+    {
+        QStringList                   typesA, typesB;
+        QList<const char *>           slicesA;
+        int                           sharedSlices = 0;
+        std::function<void(Box::Ptr)> setupA       = [&](Box::Ptr box) {
+            typesA << box->type;
+            box->onSubBoxOpen = setupA;
+            box->onDataRead   = [&](const QByteArray &data) {
+                slicesA << data.constData();
+                return Status::Ok;
+            };
+        };
+        std::function<void(Box::Ptr)> setupB = [&](Box::Ptr box) {
+            typesB << box->type;
+            box->onSubBoxOpen = setupB;
+            box->onDataRead   = [&](const QByteArray &data) {
+                sharedSlices += slicesA.last() == data.constData(); // A is called first with the same slice
+                return Status::Ok;
+            };
+        };
+
+        MemUnboxer unboxer(movie().toBase64().toStdString());
+        unboxer.setStreamOpenedCallback([&](Box::Ptr root) { root->onSubBoxOpen = setupA; });
+        unboxer.subscribe([&](Box::Ptr root) { root->onSubBoxOpen = setupB; });
+        QCOMPARE(run(unboxer, 1000), Status::Eof);
+        QCOMPARE(typesA, typesB);
+        QCOMPARE(typesA.size(), 9);
+        QCOMPARE(sharedSlices, slicesA.size());
+    }
+
+    void blobOfContainerTest()
+    {
+        // A walks moov tree while B wants the whole moov as a blob
+        QStringList typesA;
+        QByteArray  moovB;
+        bool        moovClosedB = false;
+
+        std::function<void(Box::Ptr)> setupA = [&](Box::Ptr box) {
+            typesA << box->type;
+            box->onSubBoxOpen = setupA;
+        };
+
+        MemUnboxer unboxer(movie().toBase64().toStdString());
+        unboxer.setStreamOpenedCallback([&](Box::Ptr root) { root->onSubBoxOpen = setupA; });
+        unboxer.subscribe([&](Box::Ptr root) {
+            root->onSubBoxOpen = [&](Box::Ptr box) {
+                if (box->type == "moov") {
+                    box->isContainer = false;
+                    box->onDataRead  = [&](const QByteArray &data) {
+                        moovB += data;
+                        return Status::Ok;
+                    };
+                    box->onClose = [&]() {
+                        moovClosedB = true;
+                        return Status::Ok;
+                    };
+                }
+            };
+        });
+        QCOMPARE(run(unboxer, 7), Status::Eof);
+        QVERIFY(typesA.contains("hdlr"));
+        QVERIFY(moovClosedB);
+        QCOMPARE(moovB, moov().mid(8));
+    }
+
+    void skipTest()
+    {
+        // nobody wants mdat payload, so it isn't even read
+        auto       data = movie();
+        MemUnboxer unboxer(data.toBase64().toStdString());
+        unboxer.setStreamOpenedCallback([&](Box::Ptr root) { root->onSubBoxOpen = [](Box::Ptr) {}; });
+        unboxer.subscribe([&](Box::Ptr root) { root->onSubBoxOpen = [](Box::Ptr) {}; });
+        QCOMPARE(run(unboxer), Status::Eof);
+        QVERIFY(unboxer.stream().bytesRead() < std::uint64_t(data.size()) / 2);
+    }
+};
+
+QTEST_MAIN(MemFanoutTest)
+
+#include "mem_fanout.moc"
@@ -0,0 +1,159 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <QCryptographicHash>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include "blobextractor.h"
+#include "boxhasher.h"
+#include "inputbuffer_impl.h"
+#include "status.h"
+#include "testutil.h"
+#include "unboxer.h"
+
+using namespace unboxer;
+using namespace unboxer::testutil;
+using BufferUnboxer = unboxer::Unboxer<InputBufferImpl, NullCache>;
+
+class MemHashTest : public QObject {
+    Q_OBJECT
+
+    static QByteArray payload()
+    {
+        QByteArray data(100000, '\0');
+        for (int i = 0; i < data.size(); i++) {
+            data[i] = char(i * 131 + (i >> 7));
+        }
+        return data;
+    }
+
+    static QByteArray movie()
+    {
+        return makeBox("ftyp", "isom") + makeBox("moov", makeBox("mvhd", QByteArray(100, 'v')))
+            + makeBox("mdat", payload());
+    }
+
+    static std::uint64_t xxh64(const QByteArray &data)
+    {
+        Xxh64 hash;
+        hash.update(data.constData(), std::size_t(data.size()));
+        return hash.digest();
+    }
+
+    // digests of every box by type, as seen in onClose
+    static QHash<QByteArray, BoxDigest> parse(int algorithms, std::size_t readSize)
+    {
+        testutil::Parse<InputBufferImpl> run(movie());
+        run.unboxer.setHashing(algorithms);
+        run.readSize = readSize;
+        run.start();
+        run.drain();
+        return run.digests;
+    }
+
+private slots:
+
+    void xxh64Test()
+    {
+        // reference values of XXH64 with seed 0
+        QCOMPARE(xxh64(""), std::uint64_t(0xef46db3751d8e999ULL));
+        QCOMPARE(xxh64("a"), std::uint64_t(0xd24ec4f1a98c6e5bULL));
+        QCOMPARE(xxh64("abc"), std::uint64_t(0x44bc2cf5ad770999ULL));
+        QCOMPARE(xxh64("Nobody inspects the spammish repetition"), std::uint64_t(0xfbcea83c8a378bf1ULL));
+
+        // the same digest however the data is split
+        auto data = payload().left(1000);
+        for (int chunk : { 1, 3, 8, 31, 32, 33, 100 }) {
+            Xxh64 hash;
+            for (int offset = 0; offset < data.size(); offset += chunk) {
+                auto part = data.mid(offset, chunk);
+                hash.update(part.constData(), std::size_t(part.size()));
+            }
+            QCOMPARE(hash.digest(), xxh64(data));
+        }
+    }
+
+    void unboxerTest()
+    {
+        auto sha256 = QCryptographicHash::hash(payload(), QCryptographicHash::Sha256);
+        for (std::size_t readSize : { 7, 1000, 1 << 20 }) {
+            auto digests = parse(Xxh64Hash | Sha256Hash, readSize);
+            QCOMPARE(digests["mdat"].xxh64, std::optional<std::uint64_t>(xxh64(payload())));
+            QCOMPARE(digests["mdat"].sha256, sha256);
+            QCOMPARE(digests["ftyp"].xxh64, std::optional<std::uint64_t>(xxh64("isom")));
+            QVERIFY(digests["moov"].isEmpty()); // containers aren't hashed
+        }
+    }
+
+    void singleAlgorithmTest()
+    {
+        auto digests = parse(Xxh64Hash, 1000);
+        QVERIFY(digests["mdat"].xxh64.has_value());
+        QVERIFY(digests["mdat"].sha256.isEmpty());
+        QVERIFY(parse(NoHash, 1000)["mdat"].isEmpty());
+    }
+
+    void extractorTest()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        BlobExtractor extractor("%1.%2");
+        extractor.setOutputDirectory(QDir(dir.path()));
+        extractor.setHashing(Sha256Hash);
+        QByteArray digest, content;
+        extractor.setOnBoxClosedCallback([&](Box::Ptr box, const QString &filename) {
+            digest = box->digest.sha256;
+            QFile file(filename);
+            QVERIFY(file.open(QIODevice::ReadOnly));
+            content = file.readAll();
+        });
+
+        bool          closed = false;
+        BufferUnboxer unboxer(movie());
+        unboxer.setStreamOpenedCallback([&](Box::Ptr root) {
+            root->onSubBoxOpen = [&](Box::Ptr box) {
+                box->onDataRead = [&, weakBox = std::weak_ptr<Box>(box)](const QByteArray &data) {
+                    extractor.addBoxData(weakBox.lock(), data);
+                    return Status::Ok;
+                };
+                box->onClose = [&, weakBox = std::weak_ptr<Box>(box)]() {
+                    extractor.closeBox(weakBox.lock());
+                    return Status::Ok;
+                };
+                extractor.add(box);
+            };
+        });
+        unboxer.setStreamClosedCallback([&](Status) { closed = true; });
+        unboxer.open();
+        while (!closed) {
+            unboxer.read(1000);
+        }
+        QCOMPARE(content, payload());
+        QCOMPARE(digest, QCryptographicHash::hash(content, QCryptographicHash::Sha256));
+    }
+};
+
+QTEST_MAIN(MemHashTest)
+#include "mem_hash.moc"
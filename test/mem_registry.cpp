@@ -0,0 +1,209 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <QTest>
+
+#include "inputmemory_impl.h"
+#include "inputstreamer.h"
+#include "status.h"
+#include "testutil.h"
+#include "unboxer.h"
+
+using namespace unboxer;
+using namespace unboxer::testutil;
+using MemUnboxer = unboxer::Unboxer<InputMemoryImpl, NullCache>;
+
+class MemRegistryTest : public QObject {
+    Q_OBJECT
+
+    struct Result {
+        Status                         status = Status::Ok;
+        QStringList                    boxes; // "type/depth" in order of opening
+        QHash<QByteArray, QByteArray> data;  // delivered to boxes of the type
+    };
+
+    static QByteArray movie()
+    {
+        auto avc1 = makeBox("avc1", QByteArray(78, 'v') + makeBox("avcC", "AVCC"));
+        auto stsd = makeBox("stsd", QByteArray::fromHex("0000000000000001") + avc1);
+        auto stbl = makeBox("stbl", stsd + makeBox("stts", QByteArray(8, '\0')));
+        auto mdia = makeBox("mdia", makeBox("mdhd", "MDHD") + makeBox("minf", stbl));
+        auto trak = makeBox("trak", makeBox("tkhd", "TKHD") + makeBox("edts") + mdia); // edts is empty
+        auto meta = makeBox("meta", QByteArray::fromHex("00000000") + makeBox("hdlr", "HDLR") + makeBox("ilst"));
+        return makeBox("ftyp", "isom") + makeBox("moov", makeBox("mvhd", "MVHD") + trak + makeBox("udta", meta));
+    }
+
+    void setupBox(Result &result, Box::Ptr box, int depth)
+    {
+        result.boxes.append(QString("%1/%2").arg(QString::fromLatin1(box->type)).arg(depth));
+        box->onSubBoxOpen = [this, &result, depth](Box::Ptr subBox) { setupBox(result, subBox, depth + 1); };
+        box->onDataRead   = [&result, type = box->type](const QByteArray &data) {
+            result.data[type] += data;
+            return Status::Ok;
+        };
+    }
+
+    Result parse(MemUnboxer &unboxer)
+    {
+        Result result;
+        bool   closed = false;
+        unboxer.setStreamOpenedCallback([&](Box::Ptr root) {
+            root->onSubBoxOpen = [&](Box::Ptr box) { setupBox(result, box, 0); };
+        });
+        unboxer.setStreamClosedCallback([&](Status reason) mutable {
+            closed        = true;
+            result.status = reason;
+        });
+        unboxer.open();
+        while (!closed) {
+            unboxer.read(7); // odd chunks split preambles too
+        }
+        return result;
+    }
+
+private slots:
+
+    void defaultRegistryTest()
+    {
+        MemUnboxer unboxer(movie().toBase64().toStdString());
+        auto       result = parse(unboxer);
+        QCOMPARE(result.status, Status::Eof);
+        QCOMPARE(result.boxes,
+                 QStringList() << "ftyp/0"
+                               << "moov/0"
+                               << "mvhd/1"
+                               << "trak/1"
+                               << "tkhd/2"
+                               << "edts/2"
+                               << "mdia/2"
+                               << "mdhd/3"
+                               << "minf/3"
+                               << "stbl/4"
+                               << "stsd/5"
+                               << "avc1/6"
+                               << "avcC/7"
+                               << "stts/5"
+                               << "udta/1"
+                               << "meta/2"
+                               << "hdlr/3"
+                               << "ilst/3");
+        // preambles are delivered as data of the containers
+        QCOMPARE(result.data.value("stsd"), QByteArray::fromHex("0000000000000001"));
+        QCOMPARE(result.data.value("avc1"), QByteArray(78, 'v'));
+        QCOMPARE(result.data.value("meta"), QByteArray::fromHex("00000000"));
+        QCOMPARE(result.data.value("avcC"), QByteArray("AVCC"));
+        QVERIFY(!result.data.contains("moov"));
+    }
+
+    void overrideTest()
+    {
+        MemUnboxer unboxer(movie().toBase64().toStdString());
+        unboxer.containers().remove("meta");
+        unboxer.containers().remove("trak");
+        auto result = parse(unboxer);
+        QCOMPARE(result.status, Status::Eof);
+        QVERIFY(!result.boxes.contains("hdlr/3"));
+        QVERIFY(!result.boxes.contains("tkhd/2"));
+        QCOMPARE(result.data.value("meta").size(), 4 + 12 + 8);
+    }
+
+    void explicitListTest()
+    {
+        MemUnboxer unboxer(movie().toBase64().toStdString(), { "moof", "traf" });
+        auto       result = parse(unboxer);
+        QCOMPARE(result.status, Status::Eof);
+        QCOMPARE(result.boxes, QStringList() << "ftyp/0"
+                                             << "moov/0");
+    }
+
+    void uuidContainerTest()
+    {
+        // extended types are containers as well when listed as a whole
+        QByteArray extended("0123456789abcdef");
+        auto       data = makeBox("uuid", extended + makeBox("free", "FREE") + makeBox("skip"));
+        MemUnboxer unboxer(data.toBase64().toStdString(), { extended, "moov" });
+        auto       result = parse(unboxer);
+        QCOMPARE(result.status, Status::Eof);
+        QCOMPARE(result.boxes, QStringList() << "0123456789abcdef/0"
+                                             << "free/1"
+                                             << "skip/1");
+        QCOMPARE(result.data.value("free"), QByteArray("FREE"));
+        QVERIFY(!result.data.contains(extended));
+
+        ContainerRegistry registry({ extended });
+        QCOMPARE(registry.preambleSize(extended), std::optional<std::uint32_t>(0));
+        QVERIFY(!registry.contains(extended.left(4)));
+        registry.remove(extended);
+        QVERIFY(!registry.contains(extended));
+    }
+
+    void quickTimeTest()
+    {
+        // udta ends with a zero terminator and meta has no FullBox header
+        auto meta = makeBox("meta", makeBox("hdlr", "HDLR") + makeBox("ilst"));
+        auto udta = makeBox("udta", meta + QByteArray(4, '\0'));
+        auto data = makeBox("ftyp", "qt  ") + makeBox("moov", makeBox("mvhd", "MVHD") + udta + makeBox("trak"))
+            + makeBox("mdat", "MDAT");
+        MemUnboxer unboxer(data.toBase64().toStdString());
+        auto       result = parse(unboxer);
+        QCOMPARE(result.status, Status::Eof);
+        QCOMPARE(result.boxes,
+                 QStringList() << "ftyp/0"
+                               << "moov/0"
+                               << "mvhd/1"
+                               << "udta/1"
+                               << "meta/2"
+                               << "hdlr/3"
+                               << "ilst/3"
+                               << "trak/1"
+                               << "mdat/0");
+        QVERIFY(!result.data.contains("meta"));
+        QCOMPARE(result.data.value("udta"), QByteArray(4, '\0')); // the terminator
+        QCOMPARE(result.data.value("mdat"), QByteArray("MDAT"));
+
+        // anything else too short for a header doesn't fit into the container
+        auto broken = makeBox("moov", makeBox("udta", makeBox("free") + "abcd") + makeBox("trak"));
+        MemUnboxer brokenUnboxer(broken.toBase64().toStdString());
+        QCOMPARE(parse(brokenUnboxer).status, Status::Corrupted);
+        // a size 0 box ends with its container, not the file
+        auto sizeZero = makeBox("moov", makeBox("udta", makeBox("free") + QByteArray::fromHex("00000000") + "skipSKIP"))
+            + makeBox("mdat", "MDAT");
+        MemUnboxer sizeZeroUnboxer(sizeZero.toBase64().toStdString());
+        auto       sizeZeroResult = parse(sizeZeroUnboxer);
+        QCOMPARE(sizeZeroResult.status, Status::Eof);
+        QCOMPARE(sizeZeroResult.data.value("skip"), QByteArray("SKIP"));
+        QCOMPARE(sizeZeroResult.data.value("mdat"), QByteArray("MDAT"));
+    }
+
+    void shortPreambleTest()
+    {
+        auto       data = makeBox("moov", makeBox("stsd", QByteArray(4, '\0')));
+        MemUnboxer unboxer(data.toBase64().toStdString());
+        QCOMPARE(parse(unboxer).status, Status::Corrupted);
+    }
+};
+
+QTEST_MAIN(MemRegistryTest)
+
+#include "mem_registry.moc"
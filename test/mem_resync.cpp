@@ -0,0 +1,181 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <QTest>
+#include <QtEndian>
+
+#include "inputbuffer_impl.h"
+#include "status.h"
+#include "syncscanner.h"
+#include "testutil.h"
+#include "unboxer.h"
+
+using namespace unboxer;
+using namespace unboxer::testutil;
+
+class MemResyncTest : public QObject {
+    Q_OBJECT
+
+    // 12 bytes of ftyp, then every fragment takes 384 bytes
+    static QByteArray fragment()
+    {
+        auto traf = makeBox("traf", makeBox("tfhd", QByteArray(8, 't')) + makeBox("trun", QByteArray(20, 'r')));
+        return makeBox("moof", makeBox("mfhd", QByteArray(8, 'f')) + traf) + makeBox("mdat", QByteArray(300, 'x'));
+    }
+
+    static QByteArray garbage()
+    {
+        QByteArray data(100, '\0');
+        for (int i = 0; i < data.size(); i++) {
+            data[i] = char((i * 37) ^ 0x9c);
+        }
+        return data;
+    }
+
+    struct Result {
+        QStringList                                          events;
+        std::vector<std::pair<std::uint64_t, std::uint64_t>> damaged; // offset and size
+        Status                                               status = Status::Ok;
+    };
+
+    static Result parse(const QByteArray &data, bool resync = true, std::size_t readSize = 1000)
+    {
+        Result                           result;
+        testutil::Parse<InputBufferImpl> run(data);
+        if (resync) {
+            run.unboxer.setResyncCallback([&](std::uint64_t offset, std::uint64_t size) {
+                result.damaged.emplace_back(offset, size);
+                run.events << "damaged";
+            });
+        }
+        run.readSize = readSize;
+        run.start();
+        run.drain();
+        result.events = run.events;
+        result.status = run.status;
+        return result;
+    }
+
+private slots:
+
+    void intactTest()
+    {
+        auto result = parse(makeBox("ftyp", "isom") + fragment() + fragment());
+        QCOMPARE(result.status, Status::Eof);
+        QVERIFY(result.damaged.empty());
+        QCOMPARE(result.events.count("open moof"), 2);
+    }
+
+    void garbageBetweenFragmentsTest()
+    {
+        auto data = makeBox("ftyp", "isom") + fragment() + garbage() + fragment();
+        for (std::size_t readSize : { 1, 7, 1000 }) {
+            auto result = parse(data, true, readSize);
+            QCOMPARE(result.status, Status::Eof);
+            QCOMPARE(result.damaged.size(), std::size_t(1));
+            QCOMPARE(result.damaged[0].first, std::uint64_t(396));
+            QCOMPARE(result.damaged[0].second, std::uint64_t(100));
+            QCOMPARE(result.events.count("open moof"), 2);
+            QCOMPARE(result.events.count("open trun"), 2);
+            // nothing is open while skipping
+            QCOMPARE(result.events.indexOf("damaged"), result.events.indexOf("close mdat") + 1);
+        }
+    }
+
+    void corruptedChildTest()
+    {
+        auto broken = fragment();
+        qToBigEndian<quint32>(3, broken.data() + broken.indexOf("trun") - 4); // size less than a header
+        auto result = parse(makeBox("ftyp", "isom") + broken + fragment());
+        QCOMPARE(result.status, Status::Eof);
+        QCOMPARE(result.damaged.size(), std::size_t(1));
+        QCOMPARE(result.damaged[0].first, std::uint64_t(60)); // the trun header
+        // traf and moof are closed before the damage is reported and mdat is found right after it
+        auto damaged = result.events.indexOf("damaged");
+        QCOMPARE(result.events.mid(damaged - 2, 4),
+                 QStringList() << "close traf"
+                               << "close moof"
+                               << "damaged"
+                               << "open mdat");
+        QCOMPARE(result.events.count("open moof"), 2);
+    }
+
+    void childOverflowTest()
+    {
+        auto broken = fragment();
+        qToBigEndian<quint32>(100000, broken.data() + broken.indexOf("tfhd") - 4); // larger than traf
+        auto result = parse(makeBox("ftyp", "isom") + broken + fragment());
+        QCOMPARE(result.status, Status::Eof);
+        QCOMPARE(result.damaged.size(), std::size_t(1));
+        QCOMPARE(result.damaged[0].first, std::uint64_t(44));
+        QCOMPARE(result.events.count("open tfhd"), 1); // the broken one is never opened
+        QCOMPARE(result.events.count("open moof"), 2);
+    }
+
+    void trailingGarbageTest()
+    {
+        auto result = parse(makeBox("ftyp", "isom") + fragment() + garbage());
+        QCOMPARE(result.status, Status::Eof);
+        QCOMPARE(result.damaged.size(), std::size_t(1));
+        QCOMPARE(result.damaged[0].first, std::uint64_t(396));
+        QCOMPARE(result.damaged[0].second, std::uint64_t(100));
+    }
+
+    void withoutCallbackTest()
+    {
+        auto result = parse(makeBox("ftyp", "isom") + fragment() + garbage() + fragment(), false);
+        QCOMPARE(result.status, Status::Corrupted);
+        QCOMPARE(result.events.count("open moof"), 1);
+    }
+
+    void scannerTest()
+    {
+        // 40 bytes are scanned as blocks at 0 and 16 where SSE2 is available, positions 32 to 36 one by one
+        SyncScanner scanner;
+        auto        find = [&](const QByteArray &data) { return scanner.findType(data.constData(), data.size()); };
+        auto        with = [](int position, const char *type) {
+            return QByteArray(40, 'x').replace(position, 4, type);
+        };
+
+        for (int position = 0; position <= 36; position++) {
+            QCOMPARE(find(with(position, "moof")), std::size_t(position));
+        }
+        QCOMPARE(find(with(14, "mdat")), std::size_t(14)); // straddles the first block boundary
+        QCOMPARE(find(with(30, "sidx")), std::size_t(30)); // starts in the last block, ends in the scalar tail
+        QCOMPARE(find(with(36, "mfra")), std::size_t(36)); // the very last position, scalar tail only
+
+        // first bytes of types which don't match as a whole
+        auto nearMisses = with(2, "moox").replace(15, 4, "mdax").replace(33, 4, "ftyq");
+        QCOMPARE(find(nearMisses), SyncScanner::npos);
+        QCOMPARE(find(QByteArray(nearMisses).replace(20, 4, "styp")), std::size_t(20));
+        // cut by the end of data
+        QCOMPARE(find(QByteArray(40, 'x') + "moo"), SyncScanner::npos);
+        QCOMPARE(find(QByteArray(3, 'x') + "moof"), std::size_t(3));
+        QCOMPARE(find("moo"), SyncScanner::npos);
+    }
+};
+
+QTEST_MAIN(MemResyncTest)
+
+#include "mem_resync.moc"
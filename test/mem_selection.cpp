@@ -0,0 +1,155 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <QTest>
+
+#include "inputmemory_impl.h"
+#include "inputstreamer.h"
+#include "status.h"
+#include "testutil.h"
+#include "unboxer.h"
+
+using namespace unboxer;
+using namespace unboxer::testutil;
+using MemUnboxer = unboxer::Unboxer<InputMemoryImpl, NullCache>;
+
+class MemSelectionTest : public QObject {
+    Q_OBJECT
+
+    struct Result {
+        Status            status = Status::Ok;
+        QList<QByteArray> selected; // types in order
+        QByteArray        payload;  // of all selected boxes
+        std::uint64_t     bytesRead = 0;
+    };
+
+    static QByteArray progressive()
+    {
+        auto mdia = makeBox("mdia", makeBox("mdhd", "MDHD") + makeBox("hdlr", QByteArray(32, 'h')));
+        auto trak = makeBox("trak", makeBox("tkhd", QByteArray(84, 't')) + mdia);
+        return makeBox("ftyp", "isom") + makeBox("moov", makeBox("mvhd", QByteArray(100, 'v')) + trak)
+            + makeBox("mdat", QByteArray(100000, 'x'));
+    }
+
+    static QByteArray fragmented()
+    {
+        QByteArray data;
+        for (int i = 0; i < 2; i++) {
+            auto traf = makeBox("tfhd", "TFHD") + makeBox("trun", QByteArray::number(i));
+            data += makeBox("moof", makeBox("mfhd", "MFHD") + makeBox("traf", traf) + makeBox("traf", traf));
+            data += makeBox("mdat", QByteArray(50000, 'x')); // 'x' is not a valid box so it must not be parsed
+        }
+        return data;
+    }
+
+    Result parse(const QByteArray               &data,
+                 const std::vector<QByteArray> &patterns,
+                 std::vector<QByteArray>      &&containerTypes = { { "moof", "traf" } })
+    {
+        Result result;
+        bool   closed = false;
+        auto   base64 = data.toBase64();
+
+        MemUnboxer unboxer(base64.toStdString(), std::move(containerTypes));
+        bool       valid = unboxer.setSelection(patterns, [&](Box::Ptr box) {
+            result.selected.append(box->type);
+            box->onDataRead = [&](const QByteArray &data) {
+                result.payload += data;
+                return Status::Ok;
+            };
+        });
+        if (!valid) {
+            result.status = Status::Corrupted;
+            return result;
+        }
+        unboxer.setStreamClosedCallback([&](Status reason) mutable {
+            closed        = true;
+            result.status = reason;
+        });
+        unboxer.open();
+        while (!closed) {
+            unboxer.read(4096);
+        }
+        result.bytesRead = unboxer.stream().bytesRead();
+        return result;
+    }
+
+private slots:
+
+    void pathTest()
+    {
+        auto data   = progressive();
+        auto result = parse(data, { "moov/trak/mdia/mdhd" });
+        QCOMPARE(result.status, Status::Eof);
+        QCOMPARE(result.selected, QList<QByteArray>() << "mdhd");
+        QCOMPARE(result.payload, QByteArray("MDHD"));
+        // mdat was skipped by the source
+        QVERIFY(result.bytesRead < std::uint64_t(data.size()) / 2);
+    }
+
+    void wildcardTest()
+    {
+        auto expected = QList<QByteArray>() << "trun"
+                                            << "trun"
+                                            << "trun"
+                                            << "trun";
+
+        auto result = parse(fragmented(), { "moof/*/trun" });
+        QCOMPARE(result.status, Status::Eof);
+        QCOMPARE(result.selected, expected);
+        QCOMPARE(result.payload, QByteArray("0011"));
+
+        result = parse(fragmented(), { "**/trun" });
+        QCOMPARE(result.status, Status::Eof);
+        QCOMPARE(result.selected, expected);
+
+        result = parse(fragmented(), { "moof/traf/tfhd", "mdat" });
+        QCOMPARE(result.status, Status::Eof);
+        QCOMPARE(result.selected.count("tfhd"), 4);
+        QCOMPARE(result.selected.count("mdat"), 2);
+        QCOMPARE(result.payload.size(), 4 * 4 + 2 * 50000);
+    }
+
+    void wildcardContainersTest()
+    {
+        // wildcards don't descend into boxes unknown as containers
+        auto result = parse(progressive(), { "**/mdhd" });
+        QCOMPARE(result.status, Status::Eof);
+        QVERIFY(result.selected.isEmpty());
+
+        result = parse(progressive(), { "**/mdhd" }, { "moov", "trak", "mdia" });
+        QCOMPARE(result.status, Status::Eof);
+        QCOMPARE(result.selected, QList<QByteArray>() << "mdhd");
+    }
+
+    void invalidPatternTest()
+    {
+        QCOMPARE(parse(fragmented(), { "moof//trun" }).status, Status::Corrupted);
+        QCOMPARE(parse(fragmented(), { "moo" }).status, Status::Corrupted);
+    }
+};
+
+QTEST_MAIN(MemSelectionTest)
+
+#include "mem_selection.moc"
@@ -0,0 +1,93 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <QTest>
+
+#include "inputbuffer_impl.h"
+#include "stats.h"
+#include "status.h"
+#include "testutil.h"
+#include "unboxer.h"
+
+using namespace unboxer;
+using namespace unboxer::testutil;
+
+// built only with ENABLE_STATS, otherwise the counters stay zero
+class MemStatsTest : public QObject {
+    Q_OBJECT
+
+    // ftyp at 0, free at 12, mdat at 1020, 1128 bytes in total
+    static QByteArray movie()
+    {
+        return makeBox("ftyp", "isom") + makeBox("free", QByteArray(1000, 'f')) + makeBox("mdat", pattern(100));
+    }
+
+private slots:
+
+    void skippedBoxTest()
+    {
+        // 5 byte feeds are shorter than a header, so the reader has to keep them
+        testutil::Parse<InputBufferImpl> parse(movie());
+        parse.readSize = 5;
+        parse.start({ "ftyp", "mdat" });
+        parse.drain();
+        QCOMPARE(parse.status, Status::Eof);
+        QCOMPARE(parse.data["mdat"], pattern(100));
+
+        auto stats = parse.unboxer.stats();
+        // free's header ends right at the end of a feed, so its whole payload is skipped by the source
+        QCOMPARE(stats.bytesSkipped, std::uint64_t(1000));
+        QCOMPARE(stats.bytesRead, std::uint64_t(128));
+        QCOMPARE(stats.bytesFed, std::uint64_t(128));
+        QCOMPARE(stats.bytesDelivered, std::uint64_t(4 + 100));
+        // leftovers detached after the feeds at 0 (5 bytes), 10 (3 bytes) and 1020 (5 bytes),
+        // then appended to by the feeds at 5, 15 and 1025
+        QCOMPARE(stats.bufferCopies, std::uint64_t(6));
+        QCOMPARE(stats.peakBufferSize, std::size_t(10));
+
+        QCOMPARE(stats.boxesOpened, std::uint64_t(3));
+        QCOMPARE(stats.boxesByType.value("free"), std::uint64_t(1));
+        QCOMPARE(stats.maxDepth, std::size_t(1));
+    }
+
+    void noCopiesTest()
+    {
+        // every feed ends at a box boundary or inside a payload, nothing is kept
+        testutil::Parse<InputBufferImpl> parse(movie());
+        parse.readSize = 10;
+        parse.start({ "ftyp", "mdat" });
+        parse.drain();
+        QCOMPARE(parse.status, Status::Eof);
+
+        auto stats = parse.unboxer.stats();
+        QCOMPARE(stats.bytesSkipped, std::uint64_t(1000));
+        QCOMPARE(stats.bytesRead, std::uint64_t(128));
+        QCOMPARE(stats.bufferCopies, std::uint64_t(0));
+        QCOMPARE(stats.peakBufferSize, std::size_t(10));
+    }
+};
+
+QTEST_MAIN(MemStatsTest)
+
+#include "mem_stats.moc"
@@ -0,0 +1,205 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <QTest>
+#include <QThread>
+
+#include <thread>
+
+#include "inputmemory_impl.h"
+#include "inputstreamer.h"
+#include "spscqueue.h"
+#include "status.h"
+#include "testutil.h"
+#include "threadedunboxer.h"
+#include "unboxer.h"
+
+using namespace unboxer;
+using namespace unboxer::testutil;
+using MemUnboxer         = unboxer::Unboxer<InputMemoryImpl, NullCache>;
+using ThreadedMemUnboxer = unboxer::ThreadedUnboxer<InputMemoryImpl, NullCache>;
+
+class MemThreadedTest : public QObject {
+    Q_OBJECT
+
+    static QByteArray movie()
+    {
+        QByteArray payload(200000, '\0');
+        for (int i = 0; i < payload.size(); i++) {
+            payload[i] = char(i * 7);
+        }
+        auto meta = makeBox("meta", QByteArray::fromHex("00000000") + makeBox("hdlr", "HDLR"));
+        auto trak = makeBox("trak", makeBox("tkhd", "TKHD"));
+        auto moov = makeBox("moov", makeBox("mvhd", "MVHD") + trak + makeBox("udta", meta));
+        return makeBox("ftyp", "isom") + moov + makeBox("mdat", payload) + makeBox("free", "end");
+    }
+
+    // everything a consumer sees, one line per callback
+    struct Log {
+        QStringList events;
+        QByteArray  data;
+        bool        wrongThread = false;
+        bool        closed      = false;
+        Status      status      = Status::Ok;
+
+        std::function<void(Box::Ptr)> setup = [this](Box::Ptr box) {
+            wrongThread = wrongThread || QThread::currentThread() != qApp->thread();
+            events << QString("open %1 %2 %3").arg(QString(box->type)).arg(box->size).arg(box->fileOffset);
+            box->onSubBoxOpen = setup;
+            box->onDataRead   = [this](const QByteArray &chunk) {
+                data += chunk;
+                return Status::Ok;
+            };
+            box->onClose = [this, box]() {
+                events << QString("close %1").arg(QString(box->type));
+                return Status::Ok;
+            };
+        };
+        void onClosed(Status reason)
+        {
+            closed = true;
+            status = reason;
+        }
+    };
+
+private slots:
+
+    void eventsTest()
+    {
+        auto uri = movie().toBase64().toStdString();
+
+        Log        expected;
+        MemUnboxer unboxer(uri);
+        unboxer.setStreamOpenedCallback([&](Box::Ptr root) { root->onSubBoxOpen = expected.setup; });
+        unboxer.setStreamClosedCallback([&](Status reason) { expected.onClosed(reason); });
+        unboxer.open();
+        while (!expected.closed) {
+            unboxer.read(1000);
+        }
+
+        Log                actual;
+        ThreadedMemUnboxer threaded(uri, ContainerRegistry::isoBmff(), 1000);
+        threaded.setStreamOpenedCallback([&](Box::Ptr root) { root->onSubBoxOpen = actual.setup; });
+        threaded.setStreamClosedCallback([&](Status reason) { actual.onClosed(reason); });
+        threaded.open();
+        QTRY_VERIFY_WITH_TIMEOUT(actual.closed, 10000);
+
+        QCOMPARE(actual.status, Status::Eof);
+        QVERIFY(!actual.wrongThread);
+        QCOMPARE(actual.events, expected.events);
+        QCOMPARE(actual.data, expected.data);
+    }
+
+    void backpressureTest()
+    {
+        // tiny queue and a slow consumer. the worker has to wait without losing anything
+        Log                log;
+        int                chunks = 0;
+        ThreadedMemUnboxer threaded(movie().toBase64().toStdString(), ContainerRegistry::isoBmff(), 512, 4);
+        threaded.setStreamOpenedCallback([&](Box::Ptr root) {
+            root->onSubBoxOpen = [&](Box::Ptr box) {
+                log.setup(box);
+                if (box->type == "mdat") {
+                    box->onDataRead = [&](const QByteArray &chunk) {
+                        if (++chunks % 50 == 0) {
+                            QThread::msleep(1);
+                        }
+                        log.data += chunk;
+                        return Status::Ok;
+                    };
+                }
+            };
+        });
+        threaded.setStreamClosedCallback([&](Status reason) { log.onClosed(reason); });
+        threaded.open();
+        QTRY_VERIFY_WITH_TIMEOUT(log.closed, 10000);
+
+        QCOMPARE(log.status, Status::Eof);
+        QVERIFY(chunks > 100);
+        QVERIFY(log.data.contains(movie().mid(movie().indexOf("mdat") + 4, 200000)));
+        QVERIFY(log.events.contains("close free"));
+    }
+
+    void abortTest()
+    {
+        Log                log;
+        ThreadedMemUnboxer threaded(movie().toBase64().toStdString(), ContainerRegistry::isoBmff(), 1000);
+        threaded.setStreamOpenedCallback([&](Box::Ptr root) {
+            root->onSubBoxOpen = [&](Box::Ptr box) {
+                log.setup(box);
+                if (box->type == "mdat") {
+                    box->onDataRead = [](const QByteArray &) { return Status::Corrupted; };
+                }
+            };
+        });
+        threaded.setStreamClosedCallback([&](Status reason) { log.onClosed(reason); });
+        threaded.open();
+        QTRY_VERIFY_WITH_TIMEOUT(log.closed, 10000);
+
+        QCOMPARE(log.status, Status::Corrupted);
+        QVERIFY(!log.events.contains("close free"));
+    }
+
+    void destroyRunningTest()
+    {
+        // the consumer never gets a chance to drain the queue
+        auto threaded
+            = std::make_unique<ThreadedMemUnboxer>(movie().toBase64().toStdString(), ContainerRegistry::isoBmff(), 16, 2);
+        threaded->setStreamOpenedCallback([](Box::Ptr root) { root->onSubBoxOpen = [](Box::Ptr) {}; });
+        threaded->open();
+        QThread::msleep(10);
+        threaded.reset();
+    }
+
+    void queueOrderTest()
+    {
+        constexpr int  count = 100000;
+        SpscQueue<int> queue(64);
+        QCOMPARE(queue.capacity(), std::size_t(64));
+
+        std::thread producer([&]() {
+            for (int i = 0; i < count; i++) {
+                while (!queue.tryPush(int(i))) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+        int  expected = 0;
+        bool ordered  = true;
+        while (expected < count) {
+            int value;
+            if (queue.tryPop(value)) {
+                ordered = ordered && value == expected;
+                expected++;
+            }
+        }
+        producer.join();
+        QVERIFY(ordered);
+        QVERIFY(queue.isEmpty());
+    }
+};
+
+QTEST_MAIN(MemThreadedTest)
+
+#include "mem_threaded.moc"
@@ -0,0 +1,272 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <QElapsedTimer>
+#include <QTemporaryFile>
+#include <QTest>
+
+#include <algorithm>
+#include <thread>
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "inputfd_impl.h"
+#include "inputplainhttp_impl.h"
+#include "inputstreamer.h"
+#include "reactor.h"
+#include "status.h"
+#include "testutil.h"
+#include "unboxer.h"
+
+using namespace unboxer;
+using namespace unboxer::testutil;
+
+// one response per connection, in order of connections
+class HttpStandIn {
+public:
+    HttpStandIn(QList<QByteArray> responses) : responses(std::move(responses))
+    {
+        listener = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address {};
+        address.sin_family      = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        ::bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+        ::listen(listener, 1024);
+        socklen_t length = sizeof(address);
+        ::getsockname(listener, reinterpret_cast<sockaddr *>(&address), &length);
+        port   = ntohs(address.sin_port);
+        thread = std::thread([this]() { serve(); });
+    }
+    ~HttpStandIn()
+    {
+        thread.join();
+        ::close(listener);
+    }
+    std::string url(const char *path) const { return "http://127.0.0.1:" + std::to_string(port) + path; }
+
+private:
+    void serve()
+    {
+        for (auto const &response : responses) {
+            int        connection = ::accept(listener, nullptr, nullptr);
+            QByteArray request;
+            char       buffer[4096];
+            while (!request.contains("\r\n\r\n")) {
+                auto size = ::read(connection, buffer, sizeof(buffer));
+                if (size <= 0) {
+                    break;
+                }
+                request.append(buffer, int(size));
+            }
+            // small writes, so the client gets the response in pieces
+            for (int sent = 0; sent < response.size();) {
+                auto size = ::send(connection, response.constData() + sent, qMin(response.size() - sent, 7777), 0);
+                if (size <= 0) {
+                    break;
+                }
+                sent += int(size);
+            }
+            ::close(connection);
+        }
+    }
+
+    QList<QByteArray> responses;
+    int               listener = -1;
+    int               port     = 0;
+    std::thread       thread;
+};
+
+class ReactorUnboxerTest : public QObject {
+    Q_OBJECT
+
+    static QByteArray mdatPayload()
+    {
+        QByteArray payload(300000, '\0');
+        for (int i = 0; i < payload.size(); i++) {
+            payload[i] = char(i * 13);
+        }
+        return payload;
+    }
+
+    static QByteArray movie()
+    {
+        auto trak = makeBox("trak", makeBox("tkhd", "TKHD"));
+        return makeBox("ftyp", "isom") + makeBox("moov", makeBox("mvhd", "MVHD") + trak) + makeBox("mdat", mdatPayload());
+    }
+
+    static QStringList opened()
+    {
+        return { "open ftyp", "open moov", "open mvhd", "open trak", "open tkhd", "open mdat" };
+    }
+
+    static QByteArray withLength(const QByteArray &body)
+    {
+        return "HTTP/1.1 200 OK\r\nContent-Length: " + QByteArray::number(body.size()) + "\r\n\r\n" + body;
+    }
+
+    static QByteArray chunked(const QByteArray &body)
+    {
+        QByteArray response = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n";
+        for (int offset = 0, size = 1; offset < body.size(); offset += size, size = size * 3 + 1) {
+            auto chunk = body.mid(offset, size);
+            response += QByteArray::number(chunk.size(), 16) + "\r\n" + chunk + "\r\n";
+        }
+        return response + "0\r\n\r\n";
+    }
+
+    // parses the uri on the thread's reactor
+    template <class Source> struct Parse : testutil::Parse<Source> {
+        Parse(const std::string &uri) : testutil::Parse<Source>(uri)
+        {
+            this->readSize = 64 * 1024;
+            this->start();
+        }
+    };
+
+    template <class Parses> static bool runUntilClosed(const Parses &parses)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        while (timer.elapsed() < 20000) {
+            if (std::all_of(parses.begin(), parses.end(), [](auto const &parse) { return parse->closed; })) {
+                return true;
+            }
+            Reactor::threadLocal().runOnce(100);
+        }
+        return false;
+    }
+
+private slots:
+
+    void httpTest_data()
+    {
+        QTest::addColumn<QByteArray>("response");
+        QTest::addColumn<int>("status");
+        QTest::newRow("content-length") << withLength(movie()) << int(Status::Eof);
+        QTest::newRow("chunked") << chunked(movie()) << int(Status::Eof);
+        QTest::newRow("till close") << "HTTP/1.0 200 OK\r\n\r\n" + movie() << int(Status::Eof);
+        auto truncated = withLength(movie()).replace("Content-Length: ", "Content-Length: 1"); // 10 times longer
+        QTest::newRow("truncated") << truncated << int(Status::Corrupted);
+        QTest::newRow("not found") << QByteArray("HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n")
+                                   << int(Status::SourceNotExist);
+    }
+
+    void httpTest()
+    {
+        QFETCH(QByteArray, response);
+        QFETCH(int, status);
+
+        HttpStandIn server({ response });
+        std::vector<std::unique_ptr<Parse<InputPlainHttpImpl>>> parses;
+        parses.push_back(std::make_unique<Parse<InputPlainHttpImpl>>(server.url("/movie.mp4")));
+        QVERIFY(runUntilClosed(parses));
+        QCOMPARE(int(parses[0]->status), status);
+        if (status == Status::Eof) {
+            QCOMPARE(parses[0]->events.filter("open "), opened());
+            QCOMPARE(parses[0]->data["mdat"], mdatPayload());
+        }
+    }
+
+    void manyStreamsTest()
+    {
+        constexpr int count = 200;
+
+        QList<QByteArray> responses;
+        for (int i = 0; i < count; i++) {
+            responses << withLength(movie());
+        }
+        HttpStandIn server(responses);
+        std::vector<std::unique_ptr<Parse<InputPlainHttpImpl>>> parses;
+        for (int i = 0; i < count; i++) {
+            parses.push_back(std::make_unique<Parse<InputPlainHttpImpl>>(server.url("/movie.mp4")));
+        }
+        QVERIFY(runUntilClosed(parses));
+        for (auto const &parse : parses) {
+            QCOMPARE(parse->status, Status::Eof);
+            QCOMPARE(parse->data["mdat"].size(), mdatPayload().size());
+        }
+    }
+
+    void pipeTest()
+    {
+        int fds[2];
+        QCOMPARE(::pipe(fds), 0);
+        auto        data = movie();
+        std::thread writer([&]() {
+            for (int written = 0; written < data.size();) {
+                auto size = ::write(fds[1], data.constData() + written, qMin(data.size() - written, 10000));
+                written += int(qMax<ssize_t>(size, 0));
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+            ::close(fds[1]);
+        });
+        std::vector<std::unique_ptr<Parse<InputFdImpl>>> parses;
+        parses.push_back(std::make_unique<Parse<InputFdImpl>>("fd:" + std::to_string(fds[0])));
+        bool closed = runUntilClosed(parses);
+        writer.join();
+        auto flags = ::fcntl(fds[0], F_GETFL);
+        ::close(fds[0]);
+        QVERIFY(closed);
+        QVERIFY(!(flags & O_NONBLOCK)); // restored once the source closed its duplicate
+        QCOMPARE(parses[0]->status, Status::Eof);
+        QCOMPARE(parses[0]->data["mdat"], mdatPayload());
+    }
+
+    void inheritedFlagsTest()
+    {
+        // the caller's descriptor is non-blocking only while the source has it, even if it never ends
+        int fds[2];
+        QCOMPARE(::pipe(fds), 0);
+        auto parse = std::make_unique<Parse<InputFdImpl>>("fd:" + std::to_string(fds[0]));
+        QVERIFY(::fcntl(fds[0], F_GETFL) & O_NONBLOCK);
+        parse.reset();
+        QVERIFY(!(::fcntl(fds[0], F_GETFL) & O_NONBLOCK));
+        ::close(fds[0]);
+        ::close(fds[1]);
+    }
+
+    void fileTest()
+    {
+        QTemporaryFile file;
+        QVERIFY(file.open());
+        file.write(movie());
+        file.flush();
+
+        std::vector<std::unique_ptr<Parse<InputFdImpl>>> parses;
+        parses.push_back(std::make_unique<Parse<InputFdImpl>>(file.fileName().toStdString()));
+        parses.push_back(std::make_unique<Parse<InputFdImpl>>("/nonexistent/movie.mp4"));
+        QVERIFY(runUntilClosed(parses));
+        QCOMPARE(parses[0]->status, Status::Eof);
+        QCOMPARE(parses[0]->events.filter("open "), opened());
+        QCOMPARE(parses[0]->data["mdat"], mdatPayload());
+        QCOMPARE(parses[1]->status, Status::SourceNotExist);
+    }
+};
+
+QTEST_MAIN(ReactorUnboxerTest)
+
+#include "reactor_unboxer.moc"
@@ -0,0 +1,146 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "box.h"
+#include "inputstreamer.h"
+#include "status.h"
+#include "unboxer.h"
+
+#include <QByteArray>
+#include <QHash>
+#include <QStringList>
+#include <QtEndian>
+
+#include <cstring>
+#include <vector>
+
+namespace unboxer::testutil {
+
+inline QByteArray be32(quint32 value)
+{
+    QByteArray data(4, '\0');
+    qToBigEndian<quint32>(value, data.data());
+    return data;
+}
+
+inline QByteArray makeBox(const char *type, const QByteArray &payload = QByteArray())
+{
+    QByteArray header(8, '\0');
+    qToBigEndian<quint32>(quint32(8 + payload.size()), header.data());
+    std::memcpy(header.data() + 4, type, 4);
+    return header + payload;
+}
+
+// with size 1 and 64-bit largesize
+inline QByteArray makeLargeBox(const char *type, const QByteArray &payload)
+{
+    QByteArray header(16, '\0');
+    qToBigEndian<quint32>(1, header.data());
+    std::memcpy(header.data() + 4, type, 4);
+    qToBigEndian<quint64>(quint64(16 + payload.size()), header.data() + 8);
+    return header + payload;
+}
+
+// a payload where every misplaced byte shows up
+inline QByteArray pattern(int size, int seed = 0)
+{
+    QByteArray payload(size, '\0');
+    for (int i = 0; i < size; i++) {
+        payload[i] = char((i + seed) % 251);
+    }
+    return payload;
+}
+
+/**
+ * @brief Parses a stream with Unboxer and records what the boxes delivered.
+ *
+ * Adjust unboxer or input() after construction, then start(). Sources which never wait, like memory, are read to the
+ * end with drain(), others deliver readSize bytes whenever data is ready and the consumer isn't paused.
+ */
+template <class Source, class Cache = NullCache> struct Parse {
+    Unboxer<Source, Cache>        unboxer;
+    std::size_t                   readSize = 16 * 1024;
+    bool                          paused   = false; // consumer doesn't read
+    bool                          closed   = false;
+    Status                        status   = Status::Ok;
+    QStringList                   events;  // "open <type>" and "close <type>" in stream order
+    QHash<QByteArray, QByteArray> data;    // payloads by box type
+    QHash<QByteArray, BoxDigest>  digests; // by box type, as seen in onClose
+
+    template <class SourceArg> explicit Parse(SourceArg &&source) : unboxer(std::forward<SourceArg>(source)) { }
+
+    Source &input() { return unboxer.stream().input(); }
+
+    // all boxes, or only the selected ones
+    void start(const std::vector<QByteArray> &selection = {})
+    {
+        if (selection.empty()) {
+            unboxer.setStreamOpenedCallback([this](Box::Ptr root) {
+                root->onSubBoxOpen = [this](Box::Ptr box) { watch(box); };
+            });
+        } else {
+            unboxer.setSelection(selection, [this](Box::Ptr box) { watch(box); });
+        }
+        unboxer.setStreamClosedCallback([this](Status reason) {
+            closed = true;
+            status = reason;
+        });
+        unboxer.stream().setDataReadyCallback([this]() {
+            if (!paused) {
+                unboxer.read(readSize);
+            }
+        });
+        unboxer.open();
+        if (unboxer.stream().bytesAvailable()) {
+            unboxer.read(readSize);
+        }
+    }
+
+    void drain()
+    {
+        while (!closed) {
+            unboxer.read(readSize);
+        }
+    }
+
+private:
+    void watch(const Box::Ptr &box)
+    {
+        events << "open " + box->type;
+        box->onSubBoxOpen = [this](Box::Ptr subBox) { watch(subBox); };
+        box->onDataRead   = [this, type = box->type](const QByteArray &chunk) {
+            data[type] += chunk;
+            return Status::Ok;
+        };
+        box->onClose = [this, box = box.get()]() {
+            events << "close " + box->type;
+            digests[box->type] = box->digest;
+            return Status::Ok;
+        };
+    }
+};
+
+} // namespace unboxer::testutil
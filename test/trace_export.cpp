@@ -0,0 +1,179 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <QBuffer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTest>
+
+#include <algorithm>
+#include <thread>
+
+#include "inputbuffer_impl.h"
+#include "status.h"
+#include "testutil.h"
+#include "trace.h"
+#include "unboxer.h"
+
+using namespace unboxer;
+using namespace unboxer::testutil;
+
+class TraceExportTest : public QObject {
+    Q_OBJECT
+
+    struct Span {
+        QString      name;
+        std::int64_t begin; // ns
+        std::int64_t end;
+    };
+
+    static std::int64_t nanos(const QJsonValue &micros) { return qRound64(micros.toDouble() * 1000); }
+
+    // spans of a few nested levels and a counter on every level
+    static void record(int base)
+    {
+        trace::Span outer("test outer");
+        for (int i = 0; i < 3; i++) {
+            trace::Span inner("test inner");
+            trace::Span leaf("test leaf");
+            trace::counter("test items", base + i);
+        }
+    }
+
+    // traceEvents of the current export
+    static QJsonArray exported()
+    {
+        QBuffer device;
+        device.open(QIODevice::WriteOnly);
+        if (!trace::exportChromeJson(&device)) {
+            return {};
+        }
+        QJsonParseError error;
+        auto            document = QJsonDocument::fromJson(device.data(), &error);
+        if (error.error != QJsonParseError::NoError) {
+            return {};
+        }
+        return document.object().value("traceEvents").toArray();
+    }
+
+private slots:
+
+    void threadsTest()
+    {
+        trace::setEnabled(true);
+        std::thread worker([]() { record(100); });
+        record(0);
+        worker.join();
+        trace::setEnabled(false);
+
+        auto events = exported();
+        QVERIFY(events.size() > 0);
+
+        QHash<int, QList<Span>>         spans;    // by tid
+        QHash<int, QList<std::int64_t>> counters; // by tid
+        for (int i = 0; i < events.size(); i++) {
+            auto event = events.at(i).toObject();
+            QVERIFY(event.contains("name"));
+            QVERIFY(event.contains("ph"));
+            QVERIFY(event.contains("ts"));
+            QVERIFY(event.contains("tid"));
+            auto name = event.value("name").toString();
+            if (!name.startsWith("test ")) {
+                continue; // recorded by the library
+            }
+            auto tid = event.value("tid").toInt();
+            auto ts  = nanos(event.value("ts"));
+            QVERIFY(ts >= 0);
+            if (event.value("ph").toString() == "X") {
+                auto dur = nanos(event.value("dur"));
+                QVERIFY(dur >= 0);
+                spans[tid].append({ name, ts, ts + dur });
+            } else {
+                QCOMPARE(event.value("ph").toString(), QString("C"));
+                QCOMPARE(name, QString("test items"));
+                counters[tid].append(std::int64_t(event.value("args").toObject().value("value").toDouble()));
+            }
+        }
+
+        QCOMPARE(spans.size(), 2);
+        auto tids = spans.keys();
+        std::sort(tids.begin(), tids.end());
+        auto counterTids = counters.keys();
+        std::sort(counterTids.begin(), counterTids.end());
+        QCOMPARE(counterTids, tids);
+        // each thread has its own values in the order they were recorded
+        auto first = counters[tids[0]].first() == 0 ? tids[0] : tids[1];
+        QCOMPARE(counters[first], (QList<std::int64_t> { 0, 1, 2 }));
+        QCOMPARE(counters[first == tids[0] ? tids[1] : tids[0]], (QList<std::int64_t> { 100, 101, 102 }));
+
+        // begins and ends of every thread pair up as a stack, every span inside the one it was opened in
+        QHash<QString, QString> parentOf;
+        parentOf["test inner"] = "test outer";
+        parentOf["test leaf"]  = "test inner";
+        for (auto &threadSpans : spans) {
+            QCOMPARE(threadSpans.size(), 1 + 3 * 2);
+            std::sort(threadSpans.begin(), threadSpans.end(), [](const Span &a, const Span &b) {
+                return a.begin != b.begin ? a.begin < b.begin : a.end > b.end;
+            });
+            QList<Span> open;
+            for (auto const &span : threadSpans) {
+                while (!open.isEmpty() && open.last().end <= span.begin && open.last().name != parentOf[span.name]) {
+                    open.removeLast(); // ended before this one began
+                }
+                QCOMPARE(open.isEmpty() ? QString() : open.last().name, parentOf[span.name]);
+                if (!open.isEmpty()) {
+                    QVERIFY(span.begin >= open.last().begin);
+                    QVERIFY(span.end <= open.last().end);
+                }
+                open.append(span);
+            }
+        }
+    }
+
+    void libraryTest()
+    {
+        if (!trace::isAvailable()) {
+            QSKIP("the library is built without ENABLE_TRACING");
+        }
+        trace::setEnabled(true);
+        testutil::Parse<InputBufferImpl> parse(makeBox("ftyp", "isom") + makeBox("mdat", pattern(100)));
+        parse.start();
+        parse.drain();
+        trace::setEnabled(false);
+        QCOMPARE(parse.status, Status::Eof);
+
+        QSet<QString> names;
+        auto          events = exported();
+        for (int i = 0; i < events.size(); i++) {
+            names.insert(events.at(i).toObject().value("name").toString());
+        }
+        QVERIFY(names.contains("bytes read"));
+        QVERIFY(names.contains("reader buffer"));
+    }
+};
+
+QTEST_MAIN(TraceExportTest)
+
+#include "trace_export.moc"
@@ -0,0 +1,145 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "eventwriter.h"
+
+#include <QUuid>
+#include <QtEndian>
+
+#include <cstring>
+
+EventWriter::EventWriter(Format format, std::FILE *output, int bufferSize) :
+    format(format), output(output), bufferSize(bufferSize)
+{
+    buffer.reserve(bufferSize + 256); // a little extra to not grow on the last event before flush
+}
+
+EventWriter::~EventWriter() { flush(); }
+
+void EventWriter::boxOpened(const BoxEvent &event)
+{
+    switch (format) {
+    case Format::Text:
+        writeText(event);
+        break;
+    case Format::JsonLines:
+        writeJson(event);
+        break;
+    case Format::Binary:
+        writeBinary(event);
+        break;
+    }
+    flushIfFull();
+}
+
+void EventWriter::text(std::uint32_t depth, const QByteArray &text)
+{
+    if (format != Format::Text) {
+        return;
+    }
+    buffer.append(int(depth) * 2, ' ');
+    buffer += text;
+    buffer += '\n';
+    flushIfFull();
+}
+
+void EventWriter::flush()
+{
+    if (!buffer.isEmpty()) {
+        std::fwrite(buffer.constData(), 1, std::size_t(buffer.size()), output);
+        buffer.resize(0); // keeps capacity
+    }
+    std::fflush(output);
+}
+
+void EventWriter::flushIfFull()
+{
+    if (buffer.size() >= bufferSize) {
+        flush();
+    }
+}
+
+void EventWriter::writeText(const BoxEvent &event)
+{
+    buffer.append(int(event.depth + 1) * 2, ' '); // top-level boxes are inside the artificial root
+    if (event.type.size() > 4) {
+        buffer += QUuid::fromRfc4122(event.type).toByteArray();
+    } else {
+        buffer += event.type;
+    }
+    buffer += " of size ";
+    buffer += QByteArray::number(qulonglong(event.size));
+    buffer += " with fileOffset ";
+    buffer += QByteArray::number(qulonglong(event.fileOffset));
+    buffer += '\n';
+}
+
+void EventWriter::writeJson(const BoxEvent &event)
+{
+    buffer += "{\"id\":";
+    buffer += QByteArray::number(qulonglong(event.id));
+    buffer += ",\"parent\":";
+    buffer += QByteArray::number(qulonglong(event.parentId));
+    buffer += ",\"depth\":";
+    buffer += QByteArray::number(event.depth);
+    buffer += ",\"type\":\"";
+    if (event.type.size() > 4) {
+        buffer += QUuid::fromRfc4122(event.type).toByteArray(QUuid::WithoutBraces);
+    } else {
+        // fourcc is usually printable but nothing guarantees it
+        for (char c : event.type) {
+            if (c < 0x20 || c == '"' || c == '\\' || uchar(c) >= 0x7f) {
+                char escaped[7];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", uchar(c));
+                buffer.append(escaped, 6);
+            } else {
+                buffer += c;
+            }
+        }
+    }
+    buffer += "\",\"offset\":";
+    buffer += QByteArray::number(qulonglong(event.fileOffset));
+    buffer += ",\"size\":";
+    buffer += QByteArray::number(qulonglong(event.size));
+    buffer += "}\n";
+}
+
+void EventWriter::writeBinary(const BoxEvent &event)
+{
+    if (!headerWritten) {
+        char header[8] = { 'U', 'B', 'X', 'E', 'V', 0, 0, 0 };
+        qToLittleEndian<quint16>(BINARY_VERSION, header + 6);
+        buffer.append(header, sizeof(header));
+        headerWritten = true;
+    }
+    char record[BINARY_RECORD_SZ] = {};
+    qToLittleEndian<quint64>(event.id, record);
+    qToLittleEndian<quint64>(event.parentId, record + 8);
+    qToLittleEndian<quint64>(event.fileOffset, record + 16);
+    qToLittleEndian<quint64>(event.size, record + 24);
+    qToLittleEndian<quint32>(event.depth, record + 32);
+    qToLittleEndian<quint32>(event.type.size() > 4 ? 1 : 0, record + 36);
+    std::memcpy(record + 40, event.type.constData(), std::size_t(qMin(event.type.size(), 16)));
+    buffer.append(record, sizeof(record));
+}
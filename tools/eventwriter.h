@@ -0,0 +1,86 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <QByteArray>
+
+#include <cstdint>
+#include <cstdio>
+
+/*
+ Buffered writer of box events for mp4crawler.
+
+ Everything goes to one large buffer which is written out only when full or on flush(), so there is no per-line
+ syscall. Formats:
+   Text      - indented human-readable tree (the historical mp4crawler output)
+   JsonLines - one JSON object per box: {"id":2,"parent":1,"depth":1,"type":"traf","offset":8,"size":100}
+   Binary    - 8 bytes header "UBXEV" 0 <version u16 LE> followed by fixed 56 bytes little-endian records:
+               id u64, parent u64, offset u64, size u64, depth u32, flags u32, type 16 bytes
+               flags bit 0 - type is a uuid (all 16 bytes), otherwise fourcc in the first 4 bytes and zeros.
+               The header comes with the first record, so there is no output at all without boxes, e.g. in summary
+               mode.
+ Ids start from 1 in the stream order. parent 0 and depth 0 mean a top-level box, which Text indents by one level
+ below the artificial root. size 0 means the box extends till the end.
+*/
+class EventWriter {
+public:
+    enum class Format { Text, JsonLines, Binary };
+
+    struct BoxEvent {
+        std::uint64_t     id;
+        std::uint64_t     parentId;
+        std::uint32_t     depth;
+        std::uint64_t     fileOffset;
+        std::uint64_t     size;
+        const QByteArray &type;
+    };
+
+    static constexpr std::uint16_t BINARY_VERSION    = 1;
+    static constexpr int           BINARY_RECORD_SZ  = 56;
+    static constexpr int           DEFAULT_BUFFER_SZ = 1024 * 1024;
+
+    EventWriter(Format format, std::FILE *output = stdout, int bufferSize = DEFAULT_BUFFER_SZ);
+    ~EventWriter();
+
+    EventWriter(const EventWriter &)            = delete;
+    EventWriter &operator=(const EventWriter &) = delete;
+
+    void boxOpened(const BoxEvent &event);
+    // arbitrary text indented to the given depth. ignored by machine-readable formats
+    void text(std::uint32_t depth, const QByteArray &text);
+    void flush();
+
+private:
+    void writeText(const BoxEvent &event);
+    void writeJson(const BoxEvent &event);
+    void writeBinary(const BoxEvent &event);
+    void flushIfFull();
+
+    Format     format;
+    std::FILE *output;
+    int        bufferSize;
+    QByteArray buffer;
+    bool       headerWritten = false;
+};
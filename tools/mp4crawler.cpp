@@ -22,67 +22,184 @@ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
 SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include "httppool.h"
 #include "inputfile_impl.h"
 #include "inputhttp_impl.h"
+#include "inputhttprange_impl.h"
 #include "inputstreamer.h"
 #include "status.h"
+#include "trace.h"
 #include "unboxer.h"
 
 #include "blobextractor.h"
+#include "boxrewriter.h"
+#include "eventwriter.h"
 
 #include <QCommandLineParser>
 #include <QCoreApplication>
 #include <QDir>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QFileInfo>
+#include <QHash>
 #include <QImage>
 #include <QMimeDatabase>
+#include <QSaveFile>
 #include <QTimer>
 #include <QUrl>
 #include <QUuid>
 #include <QXmlStreamReader>
+#include <QtAlgorithms>
 #include <QtDebug>
 
+#include <algorithm>
+#include <iomanip>
 #include <iostream>
-#include <sstream>
+#include <limits>
+#include <numeric>
 
 #include <inttypes.h>
 
 using namespace unboxer;
 using FileUnboxer            = unboxer::Unboxer<InputFileImpl, NullCache>;
 using HttpUnboxer            = unboxer::Unboxer<InputHttpImpl, NullCache>;
-int            spaces        = 0;
+using HttpRangeUnboxer       = unboxer::Unboxer<InputHttpRangeImpl, NullCache>;
 BlobExtractor *blobExtractor = nullptr;
+EventWriter   *eventWriter   = nullptr;
+BoxRewriter   *rewriter      = nullptr; // --rewrite
+std::uint64_t  lastBoxId     = 0;
 bool           verboseOutput = false;
+bool           printStats    = false;
+QString        traceFile;
+QString        checkpointFile; // --checkpoint
+bool           summaryOnly   = false;
+bool           resyncDamaged = false;
+bool           dedupe        = false;
 QDir           extractDir;
+int            httpParallel  = 0; // --http-connections
+int            readAhead     = 0; // --read-ahead
+int            hashing       = NoHash;
 
-void setupBox(Box::Ptr box)
+std::vector<QByteArray> selection;     // box path patterns. everything if empty
+QList<QByteArray>       compressTypes; // extracted with ZlibCodec
+
+// aggregated view of a stream. gathered without printing a line per box
+struct Summary {
+    struct TypeStats {
+        std::uint64_t count = 0;
+        std::uint64_t bytes = 0;
+    };
+    QHash<QByteArray, TypeStats> types;
+    std::uint64_t                sizeHistogram[65] = {}; // by log2 of size. 0 - boxes extending till the end
+    std::vector<std::uint64_t>   depths;                 // boxes per nesting level
+    std::vector<std::uint64_t>   moofOffsets;
+    std::uint64_t                streamEnd = 0;
+} summary;
+
+void setupSummaryBox(Box::Ptr box, std::size_t depth)
+{
+    auto &typeStats = summary.types[box->type];
+    typeStats.count++;
+    typeStats.bytes += box->size;
+    summary.sizeHistogram[box->size ? 64 - qCountLeadingZeroBits(quint64(box->size)) : 0]++;
+    if (summary.depths.size() <= depth) {
+        summary.depths.resize(depth + 1);
+    }
+    summary.depths[depth]++;
+    if (depth == 0) {
+        if (box->type == "moof") {
+            summary.moofOffsets.push_back(box->fileOffset);
+        }
+        summary.streamEnd = box->size ? box->fileOffset + box->size : 0;
+    }
+    // no onDataRead, so payload isn't delivered anywhere
+    box->onSubBoxOpen = [depth](Box::Ptr subBox) { setupSummaryBox(subBox, depth + 1); };
+}
+
+void dumpSummary(std::uint64_t bytesRead)
+{
+    auto totalBoxes = std::accumulate(summary.depths.begin(), summary.depths.end(), std::uint64_t(0));
+    std::cout << "boxes: " << totalBoxes << '\n' << "max depth: " << summary.depths.size() << '\n';
+
+    std::cout << "\nper type:\n" << std::left << std::setw(34) << "  type" << std::right << std::setw(12) << "count"
+              << std::setw(18) << "bytes" << '\n';
+    auto types = summary.types.keys();
+    std::sort(types.begin(), types.end());
+    for (auto const &type : types) {
+        auto const &stats = summary.types[type];
+        std::cout << "  " << std::left << std::setw(32) << Box(false, type).stringType().toStdString() << std::right
+                  << std::setw(12) << stats.count << std::setw(18) << stats.bytes << '\n';
+    }
+
+    std::cout << "\nsize histogram:\n";
+    if (summary.sizeHistogram[0]) {
+        std::cout << "  " << std::left << std::setw(32) << "till the end" << std::right << std::setw(12)
+                  << summary.sizeHistogram[0] << '\n';
+    }
+    for (int i = 1; i < 65; i++) {
+        if (summary.sizeHistogram[i]) {
+            auto from  = std::uint64_t(1) << (i - 1);
+            auto range = std::to_string(from) + " - " + (i < 64 ? std::to_string((from << 1) - 1) : std::string("max"));
+            std::cout << "  " << std::left << std::setw(32) << range << std::right << std::setw(12)
+                      << summary.sizeHistogram[i] << '\n';
+        }
+    }
+
+    std::cout << "\ndepth distribution:\n";
+    for (std::size_t depth = 0; depth < summary.depths.size(); depth++) {
+        std::cout << "  " << std::left << std::setw(32) << depth << std::right << std::setw(12) << summary.depths[depth]
+                  << '\n';
+    }
+
+    // a fragment spans from its moof to the next one or the end of the stream
+    auto const &moofs = summary.moofOffsets;
+    std::cout << "\nfragments: " << moofs.size() << '\n';
+    if (!moofs.empty()) {
+        auto end = summary.streamEnd ? summary.streamEnd : bytesRead;
+        std::uint64_t minSize = std::numeric_limits<std::uint64_t>::max(), maxSize = 0;
+        for (std::size_t i = 0; i < moofs.size(); i++) {
+            auto size = (i + 1 < moofs.size() ? moofs[i + 1] : end) - moofs[i];
+            minSize   = std::min(minSize, size);
+            maxSize   = std::max(maxSize, size);
+        }
+        std::cout << "fragment size min: " << minSize << '\n'
+                  << "fragment size avg: " << (end - moofs.front()) / moofs.size() << '\n'
+                  << "fragment size max: " << maxSize << '\n';
+    }
+    std::cout.flush();
+}
+
+void dumpTrace()
 {
-    std::stringstream ss;
-    auto              type = box->stringType();
-    if (type.isEmpty()) {
-        type = QString("artificial root");
-    }
-    ss << QString(spaces, ' ').toStdString() << type.toStdString() << " of size " << box->size << " with fileOffset "
-       << box->fileOffset;
-    std::cout << ss.str() << std::endl;
-    box->onSubBoxOpen = setupBox;
+    QFile file(traceFile);
+    if (!file.open(QIODevice::WriteOnly) || !trace::exportChromeJson(&file)) {
+        qWarning() << "Failed to write trace to" << traceFile;
+    }
+}
+
+void setupBox(Box::Ptr box, std::uint64_t parentId, std::uint32_t depth)
+{
+    auto id = ++lastBoxId;
+    eventWriter->boxOpened({ id, parentId, depth, box->fileOffset, box->size, box->type });
+    box->onSubBoxOpen = [id, depth](Box::Ptr subBox) { setupBox(subBox, id, depth + 1); };
     box->onClose      = [weakBox = std::weak_ptr<Box>(box)]() {
-        spaces -= 2;
         blobExtractor->closeBox(weakBox.lock());
         return Status::Ok;
     };
-    box->onDataRead = [weakBox = std::weak_ptr<Box>(box)](const QByteArray &data) mutable {
+    box->onDataRead = [weakBox = std::weak_ptr<Box>(box), depth](const QByteArray &data) mutable {
         if (verboseOutput) {
-            std::stringstream ss;
-            ss << QString(spaces + 2, ' ').toStdString() << data.data();
-            std::cout << ss.str() << std::endl;
+            eventWriter->text(depth + 3, data.left(data.indexOf('\0'))); // up to NUL as it always was
         }
         blobExtractor->addBoxData(weakBox.lock(), data);
         return Status::Ok;
     };
     blobExtractor->add(box);
-    spaces += 2;
+}
+
+void setupRootBox(Box::Ptr rootBox)
+{
+    eventWriter->text(0, "artificial root of size 0 with fileOffset 0");
+    rootBox->onSubBoxOpen = [](Box::Ptr box) { setupBox(box, 0, 0); };
 }
 
 void extractImages([[maybe_unused]] Box::Ptr box, const QString &filename)
@@ -118,24 +235,152 @@ void extractImages([[maybe_unused]] Box::Ptr box, const QString &filename)
     }
 }
 
+void reportBlob(Box::Ptr box, const QString &filename)
+{
+    if (!box->digest.isEmpty()) {
+        QStringList digests;
+        if (box->digest.xxh64) {
+            digests << QString("xxh64 %1").arg(*box->digest.xxh64, 16, 16, QChar('0'));
+        }
+        if (!box->digest.sha256.isEmpty()) {
+            digests << "sha256 " + QString::fromLatin1(box->digest.sha256.toHex());
+        }
+        qInfo().noquote() << filename << digests.join(' ');
+    }
+    extractImages(box, filename);
+}
+
+void dumpStats(const ParseStats &stats)
+{
+    if (!UnboxerImpl::statsEnabled()) {
+        qWarning("statistics are not available. rebuild with -DENABLE_STATS=ON");
+        return;
+    }
+    auto ms = [](std::chrono::nanoseconds ns) { return std::chrono::duration<double, std::milli>(ns).count(); };
+    std::cout << "bytes read: " << stats.bytesRead << '\n'
+              << "bytes fed: " << stats.bytesFed << '\n'
+              << "bytes delivered: " << stats.bytesDelivered << '\n'
+              << "bytes skipped: " << stats.bytesSkipped << '\n'
+              << "bytes damaged: " << stats.bytesDamaged << '\n'
+              << "boxes opened: " << stats.boxesOpened << '\n'
+              << "max depth: " << stats.maxDepth << '\n'
+              << "buffer copies: " << stats.bufferCopies << '\n'
+              << "peak buffer size: " << stats.peakBufferSize << '\n'
+              << "parser time ms: " << ms(stats.parserTime) << '\n'
+              << "callback time ms: " << ms(stats.callbackTime) << '\n';
+    auto types = stats.boxesByType.keys();
+    std::sort(types.begin(), types.end());
+    for (auto const &type : types) {
+        std::cout << "boxes " << Box(false, type).stringType().toStdString() << ": " << stats.boxesByType.value(type)
+                  << '\n';
+    }
+    std::cout.flush();
+}
+
+// keeps where the parse is, so it continues from there when restarted
+template <class SpecificUnboxer> void saveCheckpoint(const SpecificUnboxer &unboxer)
+{
+    constexpr qint64     CHECKPOINT_INTERVAL = 1000; // ms
+    static QElapsedTimer sinceSaved;
+    if (sinceSaved.isValid() && sinceSaved.elapsed() < CHECKPOINT_INTERVAL) {
+        return;
+    }
+    auto checkpoint = unboxer.checkpoint();
+    if (!checkpoint) {
+        return; // closed or in damaged data
+    }
+    QSaveFile file(checkpointFile);
+    if (!file.open(QIODevice::WriteOnly) || file.write(checkpoint->toByteArray()) < 0 || !file.commit()) {
+        qWarning() << "Failed to write" << checkpointFile;
+    }
+    sinceSaved.start();
+}
+
 template <class SpecificUnboxer>
-std::unique_ptr<SpecificUnboxer> makeUnboxer(const QString &uri, std::size_t readSize, const QString registryTemplate)
+std::unique_ptr<SpecificUnboxer>
+makeUnboxer(const QString &uri, std::size_t readSize, const QString registryTemplate, const ParseBudget &budget)
 {
     blobExtractor = new BlobExtractor(registryTemplate);
     blobExtractor->setParent(qApp);
-    blobExtractor->setOnBoxClosedCallback(extractImages);
+    blobExtractor->setOnBoxClosedCallback(reportBlob);
     blobExtractor->setOutputDirectory(extractDir);
+    blobExtractor->setContentAddressed(dedupe);
+    for (auto const &type : compressTypes) {
+        blobExtractor->setCompression(type, std::make_shared<ZlibCodec>());
+    }
 
     std::unique_ptr<SpecificUnboxer> unboxer;
     unboxer = std::make_unique<SpecificUnboxer>(uri.toStdString());
+    unboxer->setBudget(budget);
+    unboxer->setHashing(hashing);
+    QFile checkpoint(checkpointFile);
+    if (!checkpointFile.isEmpty() && checkpoint.open(QIODevice::ReadOnly)) {
+        if (auto saved = Checkpoint::fromByteArray(checkpoint.readAll())) {
+            qDebug() << "resuming at" << saved->offset;
+            unboxer->resumeFrom(*saved);
+        } else {
+            qWarning() << "Ignoring damaged" << checkpointFile;
+        }
+    }
+    if (resyncDamaged) {
+        unboxer->setResyncCallback([](std::uint64_t offset, std::uint64_t size) {
+            qWarning() << "skipped" << size << "damaged bytes at" << offset;
+        });
+    }
+    if constexpr (std::is_same_v<SpecificUnboxer, HttpRangeUnboxer>) {
+        unboxer->stream().input().setMaxConnections(httpParallel);
+    }
+    if constexpr (std::is_same_v<SpecificUnboxer, FileUnboxer>) {
+        unboxer->stream().input().setReadAhead(readAhead);
+        if (rewriter) {
+            rewriter->setSourceFile(uri);
+        }
+    }
+    if (!selection.empty()) {
+        unboxer->setSelection(selection, [](Box::Ptr box) {
+            if (!box->onClose) { // not yet set up as a sub-box of another selected box
+                setupBox(box, 0, 0);
+            }
+        });
+    }
     unboxer->setStreamOpenedCallback([unboxer = unboxer.get(), readSize](Box::Ptr rootBox) mutable {
         qDebug("stream opened");
-        setupBox(rootBox);
+        if (rewriter) {
+            rewriter->attach(rootBox);
+        } else if (summaryOnly) {
+            rootBox->onSubBoxOpen = [](Box::Ptr box) { setupSummaryBox(box, 0); };
+        } else if (selection.empty()) {
+            setupRootBox(rootBox);
+        }
         if (unboxer->stream().bytesAvailable()) {
             unboxer->read(readSize);
         }
     });
-    unboxer->setStreamClosedCallback([](Status status) mutable {
+    unboxer->setStreamClosedCallback([unboxer = unboxer.get(), registryTemplate](Status status) mutable {
+        eventWriter->flush();
+        blobExtractor->waitForDone();
+        if (rewriter && status == Status::Eof && rewriter->status() != Status::Ok) {
+            qWarning("failed to write the rewritten copy");
+            status = rewriter->status();
+        }
+        if (!checkpointFile.isEmpty() && status == Status::Eof) {
+            QFile::remove(checkpointFile); // nothing to resume
+        }
+        if (dedupe) {
+            auto manifest = extractDir.filePath(registryTemplate.arg("manifest", "json"));
+            if (!blobExtractor->saveManifest(manifest)) {
+                qWarning() << "Failed to write" << manifest;
+            }
+        }
+        if (summaryOnly) {
+            dumpSummary(unboxer->stream().bytesRead());
+        }
+        if (printStats) {
+            dumpStats(unboxer->stats());
+        }
+        if (!traceFile.isEmpty()) {
+            dumpTrace();
+        }
         // let app start before exit
         QTimer::singleShot(0, QCoreApplication::instance(), [status]() {
             int ret = int(status);
@@ -145,7 +390,12 @@ std::unique_ptr<SpecificUnboxer> makeUnboxer(const QString &uri, std::size_t rea
             QCoreApplication::exit(ret);
         });
     });
-    unboxer->stream().setDataReadyCallback([unboxer = unboxer.get(), readSize]() mutable { unboxer->read(readSize); });
+    unboxer->stream().setDataReadyCallback([unboxer = unboxer.get(), readSize]() mutable {
+        unboxer->read(readSize);
+        if (!checkpointFile.isEmpty()) {
+            saveCheckpoint(*unboxer);
+        }
+    });
     unboxer->open();
 
     return unboxer;
@@ -171,12 +421,125 @@ int main(int argc, char *argv[])
                                                       << "outputdir",
                                         "A directory to extract contents to (current dir by default)",
                                         "outputdir");
+    QCommandLineOption statsOption("stats", "Print parse statistics at the end");
+    QCommandLineOption formatOption("format", "Box events output format: text, jsonl or binary", "format", "text");
+    QCommandLineOption selectOption("select",
+                                    "Process only boxes matching the path pattern like moov/trak/mdia/mdhd, "
+                                    "moof/*/trun or **/emsg. May be repeated",
+                                    "pattern");
+    QCommandLineOption resyncOption("resync", "Skip damaged data and continue at the next top level box");
+    QCommandLineOption hashOption("hash", "Print xxh64 or sha256 of extracted boxes. May be repeated", "algorithm");
+    QCommandLineOption dedupeOption("dedupe",
+                                    "Store extracted payloads once in objects/ by their sha256 and write a manifest "
+                                    "instead of a file per box");
+    QCommandLineOption compressOption("compress",
+                                      "Compress extracted boxes of the type with zlib unless they are incompressible. "
+                                      "May be repeated",
+                                      "type");
+    QCommandLineOption rewriteOption("rewrite", "Write a copy of the input without the --drop boxes to a file", "file");
+    QCommandLineOption dropOption("drop", "Box type to leave out of the --rewrite copy. May be repeated", "type");
+    QCommandLineOption checkpointOption("checkpoint",
+                                        "Save parser state to a file every second and resume from it if it exists",
+                                        "file");
+    QCommandLineOption summaryOption("summary", "Print only a summary of the stream instead of every box");
+    QCommandLineOption traceOption("trace", "Write parse timeline in Chrome trace format to a file", "file");
+    QCommandLineOption maxDepthOption("max-depth", "Stop parsing if boxes are nested deeper than this", "depth");
+    QCommandLineOption maxBoxesOption("max-boxes", "Stop parsing after this number of boxes", "count");
+    QCommandLineOption maxHeaderRateOption("max-headers-per-mb", "Stop parsing if boxes are denser than this", "count");
+    QCommandLineOption maxBufferedOption("max-buffered", "Stop parsing if more bytes than this are buffered", "bytes");
+    QCommandLineOption maxCpuTimeOption("max-cpu-time", "Stop parsing after this cpu time in milliseconds", "ms");
+    QCommandLineOption httpBufferOption("http-buffer", "Bytes to receive over HTTP ahead of the parser", "bytes");
+    QCommandLineOption readAheadOption("read-ahead", "Read this number of 1 MiB chunks of a file ahead in background",
+                                       "chunks");
+    QCommandLineOption httpConnectionsOption("http-connections",
+                                             "Download over up to this number of connections with Range requests",
+                                             "count");
     parser.addOption(uriOption);
     parser.addOption(verboseOption);
     parser.addOption(extractDirOption);
+    parser.addOption(statsOption);
+    parser.addOption(formatOption);
+    parser.addOption(selectOption);
+    parser.addOption(summaryOption);
+    parser.addOption(resyncOption);
+    parser.addOption(hashOption);
+    parser.addOption(dedupeOption);
+    parser.addOption(compressOption);
+    parser.addOption(rewriteOption);
+    parser.addOption(checkpointOption);
+    parser.addOption(dropOption);
+    parser.addOption(traceOption);
+    parser.addOption(maxDepthOption);
+    parser.addOption(maxBoxesOption);
+    parser.addOption(maxHeaderRateOption);
+    parser.addOption(maxBufferedOption);
+    parser.addOption(maxCpuTimeOption);
+    parser.addOption(httpBufferOption);
+    parser.addOption(httpConnectionsOption);
+    parser.addOption(readAheadOption);
     parser.process(app);
     QString uri   = parser.value(uriOption);
     verboseOutput = parser.isSet(verboseOption);
+    printStats    = parser.isSet(statsOption);
+    summaryOnly   = parser.isSet(summaryOption);
+    resyncDamaged = parser.isSet(resyncOption);
+    dedupe        = parser.isSet(dedupeOption);
+    for (auto const &type : parser.values(compressOption)) {
+        compressTypes << type.toLatin1();
+    }
+    for (auto const &pattern : parser.values(selectOption)) {
+        selection.push_back(pattern.toLatin1());
+    }
+    for (auto const &algorithm : parser.values(hashOption)) {
+        if (algorithm == "xxh64") {
+            hashing |= Xxh64Hash;
+        } else if (algorithm == "sha256") {
+            hashing |= Sha256Hash;
+        } else {
+            qWarning() << "unknown hash algorithm" << algorithm;
+            return 1;
+        }
+    }
+    checkpointFile = parser.value(checkpointOption);
+    if (!BoxSelector().setPatterns(selection)) {
+        qWarning() << "malformed box selection" << parser.values(selectOption);
+        return 1;
+    }
+
+    auto format = EventWriter::Format::Text;
+    if (parser.value(formatOption) == "jsonl") {
+        format = EventWriter::Format::JsonLines;
+    } else if (parser.value(formatOption) == "binary") {
+        format = EventWriter::Format::Binary;
+    } else if (parser.value(formatOption) != "text") {
+        qWarning() << "unknown output format" << parser.value(formatOption);
+        return 1;
+    }
+    EventWriter writer(format);
+    eventWriter = &writer;
+
+    QFile                        rewriteFile(parser.value(rewriteOption));
+    std::unique_ptr<BoxRewriter> boxRewriter;
+    if (parser.isSet(rewriteOption)) {
+        if (!rewriteFile.open(QIODevice::WriteOnly)) {
+            qWarning() << "failed to open" << rewriteFile.fileName();
+            return 1;
+        }
+        QList<QByteArray> dropTypes;
+        for (auto const &type : parser.values(dropOption)) {
+            dropTypes << type.toLatin1();
+        }
+        boxRewriter = std::make_unique<BoxRewriter>(&rewriteFile, BoxRewriter::dropping(dropTypes));
+        rewriter    = boxRewriter.get();
+    }
+
+    traceFile = parser.value(traceOption);
+    if (!traceFile.isEmpty()) {
+        if (!trace::isAvailable()) {
+            qWarning("unboxer library was built without ENABLE_TRACING. the trace will be empty");
+        }
+        trace::setEnabled(true);
+    }
     if (parser.isSet(extractDirOption)) {
         extractDir = QDir(parser.value(extractDirOption));
         if (!extractDir.exists()) {
@@ -186,6 +549,13 @@ int main(int argc, char *argv[])
     }
     qDebug() << "output dir: " << extractDir.absolutePath();
 
+    ParseBudget budget;
+    budget.maxDepth         = parser.value(maxDepthOption).toULongLong();
+    budget.maxBoxes         = parser.value(maxBoxesOption).toULongLong();
+    budget.maxHeadersPerMB  = parser.value(maxHeaderRateOption).toULongLong();
+    budget.maxBufferedBytes = parser.value(maxBufferedOption).toULongLong();
+    budget.maxCpuTime       = std::chrono::milliseconds(parser.value(maxCpuTimeOption).toLongLong());
+
     auto    url = QUrl::fromUserInput(uri, "", QUrl::AssumeLocalFile);
     QString registryTemplate;
     if (url.scheme().isEmpty() || url.scheme() == "file") {
@@ -194,7 +564,8 @@ int main(int argc, char *argv[])
         if (fi.isFile() && fi.isReadable()) {
             registryTemplate = fi.fileName() + ".%1.%2";
             qDebug() << "opening local file: " << uri;
-            auto unboxer = makeUnboxer<FileUnboxer>(uri, 16384, registryTemplate);
+            readAhead = parser.value(readAheadOption).toInt();
+            auto unboxer = makeUnboxer<FileUnboxer>(uri, 16384, registryTemplate, budget);
             return app.exec();
         } else {
             qWarning() << "file " << uri << " is not readable";
@@ -206,7 +577,15 @@ int main(int argc, char *argv[])
             registryTemplate = QFileInfo(url.path()).fileName() + ".%1.%2";
         }
         qDebug() << "opening http file: " << uri;
-        auto unboxer = makeUnboxer<HttpUnboxer>(uri, 2048, registryTemplate);
+        if (parser.isSet(httpBufferOption)) {
+            HttpPool::forThread().setReadBufferSize(parser.value(httpBufferOption).toLongLong());
+        }
+        httpParallel = parser.value(httpConnectionsOption).toInt();
+        if (httpParallel > 1) {
+            auto unboxer = makeUnboxer<HttpRangeUnboxer>(uri, 2048, registryTemplate, budget);
+            return app.exec();
+        }
+        auto unboxer = makeUnboxer<HttpUnboxer>(uri, 2048, registryTemplate, budget);
         return app.exec();
     }
 }
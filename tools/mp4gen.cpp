@@ -0,0 +1,560 @@
+/*
+Copyright (c) 2021, Sergei Ilinykh <rion4ik@gmail.com>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QFile>
+#include <QtDebug>
+#include <QtEndian>
+
+#include <limits>
+#include <random>
+#include <vector>
+
+// Synthetic ISO BMFF generator. The output is structurally valid (sizes, trun data offsets, chunk offsets)
+// but carries pseudo-random payload. Everything is derived from the seed so the same command line always
+// produces the same bytes.
+
+struct Options {
+    bool          progressive  = false;
+    int           fragments    = 10;
+    int           tracks       = 1;
+    int           trunSamples  = 30;
+    int           nesting      = 0;
+    int           uuidBoxes    = 0;
+    bool          largeSize    = false;
+    bool          sizeZeroMdat = false;
+    std::uint64_t mdatSize     = 0; // per fragment (or the whole mdat in progressive mode). 0 - random
+    std::uint64_t seed         = 1;
+};
+
+class BoxBuilder {
+public:
+    explicit BoxBuilder(bool largeSize) : largeSize(largeSize) { }
+
+    void begin(const char *type)
+    {
+        stack.push_back(data.size());
+        if (largeSize) {
+            put32(1);
+            data.append(type, 4);
+            put64(0);
+        } else {
+            put32(0);
+            data.append(type, 4);
+        }
+    }
+
+    void beginFull(const char *type, std::uint8_t version, std::uint32_t flags)
+    {
+        begin(type);
+        put8(version);
+        put8(std::uint8_t(flags >> 16));
+        put16(std::uint16_t(flags));
+    }
+
+    void beginUuid(const QByteArray &userType)
+    {
+        begin("uuid");
+        data.append(userType);
+    }
+
+    void end()
+    {
+        auto start = stack.back();
+        stack.pop_back();
+        std::uint64_t size = data.size() - start;
+        if (largeSize) {
+            qToBigEndian<quint64>(size, data.data() + start + 8);
+        } else {
+            qToBigEndian<quint32>(quint32(size), data.data() + start);
+        }
+    }
+
+    int  pos() const { return data.size(); }
+    void put8(std::uint8_t v) { data.append(char(v)); }
+    void put16(std::uint16_t v) { putBE(v); }
+    void put32(std::uint32_t v) { putBE(v); }
+    void put64(std::uint64_t v) { putBE(v); }
+    void patch32(int pos, std::uint32_t v) { qToBigEndian<quint32>(v, data.data() + pos); }
+    void patch64(int pos, std::uint64_t v) { qToBigEndian<quint64>(v, data.data() + pos); }
+
+    QByteArray data;
+
+private:
+    template <typename T> void putBE(T v)
+    {
+        char buf[sizeof(T)];
+        qToBigEndian<T>(v, buf);
+        data.append(buf, sizeof(T));
+    }
+
+    bool             largeSize;
+    std::vector<int> stack;
+};
+
+class Generator {
+public:
+    Generator(const Options &options, QFile &out) : o(options), out(out), rng(options.seed), payloadState(options.seed)
+    {
+    }
+
+    bool run()
+    {
+        writeFtyp();
+        if (o.progressive) {
+            writeProgressive();
+        } else {
+            writeFragmented();
+        }
+        return flush();
+    }
+
+private:
+    std::uint32_t random(std::uint32_t min, std::uint32_t max)
+    {
+        return std::uniform_int_distribution<std::uint32_t>(min, max)(rng);
+    }
+
+    QByteArray randomBytes(int size)
+    {
+        QByteArray ret(size, Qt::Uninitialized);
+        for (int i = 0; i < size; i++) {
+            ret[i] = char(rng());
+        }
+        return ret;
+    }
+
+    std::vector<std::uint32_t> sampleSizes(int count, std::uint64_t total)
+    {
+        std::vector<std::uint32_t> sizes(count);
+        if (!total) {
+            for (auto &s : sizes) {
+                s = random(200, 20000);
+            }
+            return sizes;
+        }
+        for (int i = 0; i < count; i++) {
+            sizes[i] = std::uint32_t(total / count + (std::uint64_t(i) < total % count ? 1 : 0));
+        }
+        return sizes;
+    }
+
+    void writeFtyp()
+    {
+        BoxBuilder b(o.largeSize);
+        b.begin("ftyp");
+        b.data.append(o.progressive ? "isom" : "iso6", 4);
+        b.put32(0);
+        b.data.append(o.progressive ? "isomiso2mp41" : "iso6dashcmfc");
+        b.end();
+        write(b.data);
+    }
+
+    void writeSampleTables(BoxBuilder &b, const std::vector<std::uint32_t> &sizes, std::uint64_t mdatPayloadOffset,
+                           std::vector<int> &chunkOffsetPositions)
+    {
+        b.beginFull("stsd", 0, 0);
+        b.put32(1);
+        b.begin("mp4v");
+        b.data.append(QByteArray(78, '\0')); // visual sample entry preamble
+        b.end();
+        b.end();
+
+        b.beginFull("stts", 0, 0);
+        b.put32(1);
+        b.put32(std::uint32_t(sizes.size()));
+        b.put32(1000);
+        b.end();
+
+        b.beginFull("stsc", 0, 0);
+        b.put32(1);
+        b.put32(1);
+        b.put32(std::uint32_t(sizes.size()));
+        b.put32(1);
+        b.end();
+
+        b.beginFull("stsz", 0, 0);
+        b.put32(0);
+        b.put32(std::uint32_t(sizes.size()));
+        for (auto s : sizes) {
+            b.put32(s);
+        }
+        b.end();
+
+        // single chunk per track. the offset is patched once moov size is known
+        b.beginFull("co64", 0, 0);
+        b.put32(sizes.empty() ? 0 : 1);
+        if (!sizes.empty()) {
+            chunkOffsetPositions.push_back(b.pos());
+            b.put64(mdatPayloadOffset);
+        }
+        b.end();
+    }
+
+    void writeTrak(BoxBuilder &b, int trackId, const std::vector<std::uint32_t> &sizes,
+                   std::vector<int> &chunkOffsetPositions)
+    {
+        b.begin("trak");
+        b.beginFull("tkhd", 0, 3);
+        b.put32(0);
+        b.put32(0);
+        b.put32(trackId);
+        b.data.append(QByteArray(68, '\0'));
+        b.end();
+        b.begin("mdia");
+        b.beginFull("mdhd", 0, 0);
+        b.put32(0);
+        b.put32(0);
+        b.put32(1000);
+        b.put32(std::uint32_t(sizes.size() * 1000));
+        b.put32(0x55c40000); // und
+        b.end();
+        b.beginFull("hdlr", 0, 0);
+        b.put32(0);
+        b.data.append("vide", 4);
+        b.data.append(QByteArray(12, '\0'));
+        b.data.append("synthetic\0", 10);
+        b.end();
+        b.begin("minf");
+        b.begin("dinf");
+        b.beginFull("dref", 0, 0);
+        b.put32(1);
+        b.beginFull("url ", 0, 1);
+        b.end();
+        b.end();
+        b.end();
+        b.begin("stbl");
+        writeSampleTables(b, sizes, 0, chunkOffsetPositions);
+        b.end();
+        b.end();
+        b.end();
+        b.end();
+    }
+
+    void writeNesting(BoxBuilder &b)
+    {
+        for (int i = 0; i < o.nesting; i++) {
+            b.begin("udta");
+        }
+        if (o.nesting) {
+            b.begin("free");
+            b.data.append(randomBytes(random(0, 32)));
+            b.end();
+        }
+        for (int i = 0; i < o.nesting; i++) {
+            b.end();
+        }
+    }
+
+    void writeUuids(BoxBuilder &b)
+    {
+        for (int i = 0; i < o.uuidBoxes; i++) {
+            b.beginUuid(randomBytes(16));
+            b.data.append(randomBytes(random(8, 64)));
+            b.end();
+        }
+    }
+
+    void writeProgressive()
+    {
+        std::vector<std::vector<std::uint32_t>> tracks;
+        std::uint64_t                           mdatPayload = 0;
+        for (int t = 0; t < o.tracks; t++) {
+            tracks.push_back(sampleSizes(o.fragments * o.trunSamples, o.mdatSize / o.tracks));
+            for (auto s : tracks.back()) {
+                mdatPayload += s;
+            }
+        }
+
+        BoxBuilder       b(o.largeSize);
+        std::vector<int> chunkOffsetPositions;
+        b.begin("moov");
+        b.beginFull("mvhd", 0, 0);
+        b.data.append(QByteArray(96, '\0'));
+        b.end();
+        for (int t = 0; t < o.tracks; t++) {
+            writeTrak(b, t + 1, tracks[t], chunkOffsetPositions);
+        }
+        writeNesting(b);
+        writeUuids(b);
+        b.end();
+
+        // tracks are stored one after another inside the single mdat
+        std::uint64_t offset = written + b.data.size() + mdatHeaderSize(mdatPayload);
+        for (int t = 0; t < o.tracks; t++) {
+            b.patch64(chunkOffsetPositions[t], offset);
+            for (auto s : tracks[t]) {
+                offset += s;
+            }
+        }
+        write(b.data);
+        writeMdat(mdatPayload, o.sizeZeroMdat);
+    }
+
+    void writeFragmented()
+    {
+        BoxBuilder       b(o.largeSize);
+        std::vector<int> unused;
+        b.begin("moov");
+        b.beginFull("mvhd", 0, 0);
+        b.data.append(QByteArray(96, '\0'));
+        b.end();
+        for (int t = 0; t < o.tracks; t++) {
+            writeTrak(b, t + 1, {}, unused);
+        }
+        b.begin("mvex");
+        for (int t = 0; t < o.tracks; t++) {
+            b.beginFull("trex", 0, 0);
+            b.put32(t + 1);
+            b.put32(1);
+            b.put32(1000);
+            b.put32(0);
+            b.put32(0);
+            b.end();
+        }
+        b.end();
+        b.end();
+        write(b.data);
+
+        for (int f = 0; f < o.fragments; f++) {
+            std::vector<std::vector<std::uint32_t>> tracks;
+            std::uint64_t                           mdatPayload = 0;
+            for (int t = 0; t < o.tracks; t++) {
+                tracks.push_back(sampleSizes(o.trunSamples, o.mdatSize / o.tracks));
+                for (auto s : tracks.back()) {
+                    mdatPayload += s;
+                }
+            }
+
+            BoxBuilder       moof(o.largeSize);
+            std::vector<int> dataOffsetPositions;
+            moof.begin("moof");
+            moof.beginFull("mfhd", 0, 0);
+            moof.put32(f + 1);
+            moof.end();
+            for (int t = 0; t < o.tracks; t++) {
+                moof.begin("traf");
+                moof.beginFull("tfhd", 0, 0x020000); // default-base-is-moof
+                moof.put32(t + 1);
+                moof.end();
+                moof.beginFull("tfdt", 1, 0);
+                moof.put64(std::uint64_t(f) * o.trunSamples * 1000);
+                moof.end();
+                moof.beginFull("trun", 0, 0x000301); // data offset, sample duration and size present
+                moof.put32(std::uint32_t(tracks[t].size()));
+                dataOffsetPositions.push_back(moof.pos());
+                moof.put32(0);
+                for (auto s : tracks[t]) {
+                    moof.put32(1000);
+                    moof.put32(s);
+                }
+                moof.end();
+                writeUuids(moof);
+                writeNesting(moof);
+                moof.end();
+            }
+            moof.end();
+
+            // data offsets are relative to the moof start
+            std::uint64_t offset = moof.data.size() + mdatHeaderSize(mdatPayload);
+            for (int t = 0; t < o.tracks; t++) {
+                if (offset > std::uint64_t(std::numeric_limits<std::int32_t>::max())) { // signed 32-bit field
+                    qWarning() << "trun data offset doesn't fit 32 bits. Use more fragments or a smaller mdat size";
+                    failed = true;
+                    return;
+                }
+                moof.patch32(dataOffsetPositions[t], std::uint32_t(offset));
+                for (auto s : tracks[t]) {
+                    offset += s;
+                }
+            }
+            write(moof.data);
+            writeMdat(mdatPayload, o.sizeZeroMdat && f + 1 == o.fragments);
+        }
+    }
+
+    int mdatHeaderSize(std::uint64_t payload) const
+    {
+        return (o.largeSize || payload + 8 > std::numeric_limits<std::uint32_t>::max()) ? 16 : 8;
+    }
+
+    void writeMdat(std::uint64_t payload, bool sizeZero)
+    {
+        BoxBuilder header(false);
+        if (sizeZero) {
+            header.put32(0);
+            header.data.append("mdat", 4);
+            if (mdatHeaderSize(payload) == 16) {
+                header.put64(0); // offsets were calculated for 16 bytes header. pad with payload
+            }
+        } else if (mdatHeaderSize(payload) == 16) {
+            header.put32(1);
+            header.data.append("mdat", 4);
+            header.put64(payload + 16);
+        } else {
+            header.put32(std::uint32_t(payload + 8));
+            header.data.append("mdat", 4);
+        }
+        write(header.data);
+
+        // payload is produced by a cheap xorshift generator in big blocks, otherwise multi-GB mdats take forever
+        QByteArray block(1024 * 1024, Qt::Uninitialized);
+        while (payload) {
+            auto size = int(qMin<std::uint64_t>(payload, block.size()));
+            auto data = reinterpret_cast<std::uint64_t *>(block.data());
+            for (int i = 0; i < (size + 7) / 8; i++) {
+                payloadState ^= payloadState << 13;
+                payloadState ^= payloadState >> 7;
+                payloadState ^= payloadState << 17;
+                data[i] = payloadState;
+            }
+            write(QByteArray::fromRawData(block.constData(), size));
+            payload -= size;
+        }
+    }
+
+    void write(const QByteArray &data)
+    {
+        if (failed) {
+            return;
+        }
+        buffer += data;
+        written += data.size();
+        if (buffer.size() >= 4 * 1024 * 1024) {
+            flush();
+        }
+    }
+
+    bool flush()
+    {
+        if (!failed && out.write(buffer) != buffer.size()) {
+            qWarning() << "Failed to write to " << out.fileName() << ": " << out.errorString();
+            failed = true;
+        }
+        buffer.clear();
+        return !failed;
+    }
+
+    const Options  &o;
+    QFile          &out;
+    std::mt19937_64 rng;
+    std::uint64_t   payloadState;
+    QByteArray      buffer;
+    std::uint64_t   written = 0;
+    bool            failed  = false;
+};
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("mp4gen");
+    QCoreApplication::setApplicationVersion("1.0");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Synthetic ISO BMFF generator");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    QCommandLineOption outputOption(QStringList() << "o"
+                                                  << "output",
+                                    "Output file (- for stdout)",
+                                    "output",
+                                    "synthetic.mp4");
+    QCommandLineOption seedOption("seed", "Random seed, non-zero", "seed", "1");
+    QCommandLineOption progressiveOption("progressive", "Generate progressive (moov + single mdat) file");
+    QCommandLineOption fragmentsOption("fragments", "Number of fragments (moof + mdat pairs)", "count", "10");
+    QCommandLineOption tracksOption("tracks", "Number of tracks", "count", "1");
+    QCommandLineOption trunOption("trun-samples", "Samples per trun (per fragment in progressive mode)", "count", "30");
+    QCommandLineOption nestingOption("nesting", "Depth of nested udta chain in every moof/moov", "depth", "0");
+    QCommandLineOption uuidOption("uuid-boxes", "Number of uuid boxes in every traf/moov", "count", "0");
+    QCommandLineOption largeSizeOption("large-size", "Use 64-bit largesize headers for all boxes");
+    QCommandLineOption sizeZeroOption("size-zero", "Write the last mdat with size 0 (till the end of file)");
+    QCommandLineOption mdatSizeOption("mdat-size",
+                                      "Payload size of every mdat (whole mdat in progressive mode). "
+                                      "Suffixes K, M, G are supported. Random by default",
+                                      "size");
+    for (auto const &option : { outputOption,
+                                seedOption,
+                                progressiveOption,
+                                fragmentsOption,
+                                tracksOption,
+                                trunOption,
+                                nestingOption,
+                                uuidOption,
+                                largeSizeOption,
+                                sizeZeroOption,
+                                mdatSizeOption }) {
+        parser.addOption(option);
+    }
+    parser.process(app);
+
+    Options o;
+    o.seed         = parser.value(seedOption).toULongLong();
+    o.progressive  = parser.isSet(progressiveOption);
+    o.fragments    = qMax(1, parser.value(fragmentsOption).toInt());
+    o.tracks       = qMax(1, parser.value(tracksOption).toInt());
+    o.trunSamples  = qMax(1, parser.value(trunOption).toInt());
+    o.nesting      = qMax(0, parser.value(nestingOption).toInt());
+    o.uuidBoxes    = qMax(0, parser.value(uuidOption).toInt());
+    o.largeSize    = parser.isSet(largeSizeOption);
+    o.sizeZeroMdat = parser.isSet(sizeZeroOption);
+    if (!o.seed) {
+        qWarning() << "seed has to be a non-zero number"; // xorshift would produce only zeros
+        return 1;
+    }
+    if (parser.isSet(mdatSizeOption)) {
+        auto          value      = parser.value(mdatSizeOption).toUpper();
+        std::uint64_t multiplier = 1;
+        if (value.endsWith("K")) {
+            multiplier = 1024;
+        } else if (value.endsWith("M")) {
+            multiplier = 1024 * 1024;
+        } else if (value.endsWith("G")) {
+            multiplier = 1024 * 1024 * 1024;
+        }
+        if (multiplier != 1) {
+            value.chop(1);
+        }
+        o.mdatSize = value.toULongLong() * multiplier;
+        if (o.mdatSize / o.tracks / o.trunSamples > std::numeric_limits<std::uint32_t>::max()) {
+            qWarning() << "mdat size is too big for given number of samples";
+            return 1;
+        }
+    }
+
+    QFile out;
+    auto  output = parser.value(outputOption);
+    bool  opened = false;
+    if (output == "-") {
+        opened = out.open(stdout, QIODevice::WriteOnly);
+    } else {
+        out.setFileName(output);
+        opened = out.open(QIODevice::WriteOnly);
+    }
+    if (!opened) {
+        qWarning() << "Failed to open " << output << " for writing";
+        return 1;
+    }
+    return Generator(o, out).run() ? 0 : 1;
+}